@@ -0,0 +1,228 @@
+// Benchmarks the GPU cost of antialiasing brush stamps. Strokes of several
+// radii are drawn into an offscreen full HD target, each frame timed with a
+// GL_TIME_ELAPSED query:
+//  - square: the aliased square point sprites strokes used to be drawn with
+//  - sdf: the antialiased stroke shader, which rounds stamps from their
+//    distance field and blends premultiplied coverage, in a single sample target
+//  - msaa4x: hard discs antialiased by a 4x multisampled target instead, with
+//    alpha to coverage, including resolving it into a single sample target
+//
+// The bytes of the render targets are reported alongside, as a measure of the
+// framebuffer bandwidth each approach needs.
+#include "../src/shader.h"
+#include "../src/shader_cache.h"
+#include "../src/stroke.h"
+#include "embedded_shaders.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// The size of the render target in pixels
+const int TARGET_WIDTH = 1920;
+const int TARGET_HEIGHT = 1080;
+
+// The number of strokes drawn per frame and the cursor samples of each
+const size_t NUM_STROKES = 200;
+const size_t SAMPLES_PER_STROKE = 200;
+
+// The number of frames timed per approach, after a few untimed frames
+const int NUM_FRAMES = 60;
+const int NUM_WARMUP_FRAMES = 5;
+
+// The hard disc drawn into the multisampled target. Its coverage is written to
+// alpha and turned into a sample mask by alpha to coverage, then replaced with
+// one before blending, so the target rather than the shader antialiases the edge.
+const char *MSAA_STROKE_FRAG = R"(out vec4 FragColor;
+
+uniform float pointSize;
+
+void main() {
+    float edgeDistance = (0.5 - length(gl_PointCoord - vec2(0.5))) * pointSize;
+    FragColor = vec4(1.0, 0.0, 0.0, clamp(edgeDistance + 0.5, 0.0, 1.0));
+}
+)";
+
+// Target is an offscreen frame buffer with a color renderbuffer
+struct Target {
+  unsigned int FBO, colorBuffer;
+  int samples;
+
+  Target(int samples) : samples(samples) {
+    glGenFramebuffers(1, &this->FBO);
+    glGenRenderbuffers(1, &this->colorBuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, this->colorBuffer);
+    if (samples > 1) {
+      glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, TARGET_WIDTH, TARGET_HEIGHT);
+    } else {
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_WIDTH, TARGET_HEIGHT);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      throw std::runtime_error("failed to create the benchmark render target");
+    }
+  }
+
+  ~Target() {
+    glDeleteFramebuffers(1, &this->FBO);
+    glDeleteRenderbuffers(1, &this->colorBuffer);
+  }
+
+  // bytes returns the size of the target's color samples
+  size_t bytes() const { return size_t(TARGET_WIDTH) * TARGET_HEIGHT * 4 * this->samples; }
+};
+
+// makeStrokes builds strokes of the given radius as smooth random walks over the target
+static std::vector<std::unique_ptr<Stroke> > makeStrokes(Shader &shader, float radius) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> x(0, TARGET_WIDTH);
+  std::uniform_real_distribution<float> y(0, TARGET_HEIGHT);
+  std::uniform_real_distribution<float> turn(-0.4f, 0.4f);
+
+  std::vector<std::unique_ptr<Stroke> > strokes;
+  for (size_t i = 0; i < NUM_STROKES; i++) {
+    std::unique_ptr<Stroke> stroke(new Stroke(0, shader, radius));
+
+    glm::vec2 position{x(rng), y(rng)};
+    float angle = turn(rng) * 8;
+    for (size_t j = 0; j < SAMPLES_PER_STROKE; j++) {
+      stroke->addSample(position);
+      angle += turn(rng);
+      position += glm::vec2{std::cos(angle), std::sin(angle)} * 6.0f;
+    }
+
+    stroke->rebuild();
+    stroke->seal();
+    strokes.push_back(std::move(stroke));
+  }
+
+  return strokes;
+}
+
+// run draws strokes of the given radius with a shader into a target, resolving
+// it into resolveTarget if one is given, and returns the median GPU
+// milliseconds per frame
+static double run(Shader &shader, float radius, Target &target, Target *resolveTarget) {
+  std::vector<std::unique_ptr<Stroke> > strokes = makeStrokes(shader, radius);
+
+  // Map canvas space onto the target's pixels, as the camera does at 100% zoom
+  glm::mat4 viewProjection(1.0f);
+  viewProjection[0][0] = 2.0f / TARGET_WIDTH;
+  viewProjection[1][1] = 2.0f / TARGET_HEIGHT;
+  viewProjection[3][0] = -1.0f;
+  viewProjection[3][1] = -1.0f;
+
+  unsigned int query;
+  glGenQueries(1, &query);
+
+  std::vector<double> frameMs;
+  for (int frame = 0; frame < NUM_WARMUP_FRAMES + NUM_FRAMES; frame++) {
+    glBeginQuery(GL_TIME_ELAPSED, query);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+    glViewport(0, 0, TARGET_WIDTH, TARGET_HEIGHT);
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    shader.use();
+    shader.setMat4("viewProjection", viewProjection);
+    shader.setFloat("pointSize", radius * 2);
+    shader.setFloat("hardness", 1.0f);
+    shader.setVec4("strokeColor", 1.0f, 0.0f, 0.0f, 1.0f);
+    for (std::unique_ptr<Stroke> &stroke : strokes) {
+      stroke->draw();
+    }
+
+    if (resolveTarget != nullptr) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, target.FBO);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveTarget->FBO);
+      glBlitFramebuffer(0, 0, TARGET_WIDTH, TARGET_HEIGHT, 0, 0, TARGET_WIDTH, TARGET_HEIGHT, GL_COLOR_BUFFER_BIT,
+                        GL_NEAREST);
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    if (frame >= NUM_WARMUP_FRAMES) {
+      frameMs.push_back(double(elapsed) / 1e6);
+    }
+  }
+
+  glDeleteQueries(1, &query);
+
+  std::sort(frameMs.begin(), frameMs.end());
+  return frameMs[frameMs.size() / 2];
+}
+
+int main() {
+  if (!glfwInit()) {
+    fprintf(stderr, "failed to initialise GLFW\n");
+    return 1;
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+  GLFWwindow *window = glfwCreateWindow(64, 64, "brush_aa_bench", nullptr, nullptr);
+  if (window == nullptr) {
+    fprintf(stderr, "failed to create a window\n");
+    glfwTerminate();
+    return 1;
+  }
+
+  glfwMakeContextCurrent(window);
+  if (!gladLoadGL(glfwGetProcAddress)) {
+    fprintf(stderr, "failed to load OpenGL\n");
+    glfwTerminate();
+    return 1;
+  }
+
+  {
+    ShaderCache shaders;
+    Shader &squareShader = shaders.get(ShaderProgram::Stroke, SHADER_INSTANCED);
+    Shader &sdfShader = shaders.get(ShaderProgram::Stroke, SHADER_INSTANCED | SHADER_ANTIALIASED);
+    Shader msaaShader(ShaderCache::expand(SHADER_STROKE_VERT, SHADER_INSTANCED).c_str(),
+                      ShaderCache::expand(MSAA_STROKE_FRAG, 0).c_str());
+
+    Target target(1);
+    Target msaaTarget(4);
+
+    printf("%d strokes of %d samples into a %dx%d target\n", int(NUM_STROKES), int(SAMPLES_PER_STROKE), TARGET_WIDTH,
+           TARGET_HEIGHT);
+
+    for (float radius : {2.0f, 8.0f, 32.0f}) {
+      double squareMs = run(squareShader, radius, target, nullptr);
+      double sdfMs = run(sdfShader, radius, target, nullptr);
+
+      glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+      glEnable(GL_SAMPLE_ALPHA_TO_ONE);
+      double msaaMs = run(msaaShader, radius, msaaTarget, &target);
+      glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+      glDisable(GL_SAMPLE_ALPHA_TO_ONE);
+
+      printf("radius %4.0f: square %7.3f ms  sdf %7.3f ms  msaa4x %7.3f ms  (%.2fx the cost of sdf)\n", radius, squareMs,
+             sdfMs, msaaMs, msaaMs / sdfMs);
+    }
+
+    printf("target bytes: single sample %.1f MiB, msaa4x %.1f MiB plus its resolve\n",
+           double(target.bytes()) / (1024 * 1024), double(msaaTarget.bytes()) / (1024 * 1024));
+
+    glDeleteProgram(msaaShader.ID);
+    shaders.clear();
+  }
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Benchmarks saving and loading a .drawww document holding a million samples.
+// Reports throughput in samples and bytes per second, along with the encoded
+// size per sample and the worst quantisation error of the round trip.
+#include "../src/document.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The number of samples in the benchmarked drawing
+const size_t NUM_SAMPLES = 1000000;
+
+// The number of samples per stroke
+const size_t SAMPLES_PER_STROKE = 200;
+
+const char *DOCUMENT_PATH = "document_bench.drawww";
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> position(0.0f, 4096.0f);
+  std::uniform_real_distribution<float> step(-12.0f, 12.0f);
+
+  // Build the drawing as random walks, similar to mouse strokes
+  std::vector<std::vector<glm::vec2> > drawing(NUM_SAMPLES / SAMPLES_PER_STROKE);
+  for (std::vector<glm::vec2> &stroke : drawing) {
+    glm::vec2 sample{position(rng), position(rng)};
+    for (size_t i = 0; i < SAMPLES_PER_STROKE; i++) {
+      stroke.push_back(sample);
+      sample += glm::vec2{step(rng), step(rng)};
+    }
+  }
+
+  std::vector<DocumentStroke> strokes;
+  Symmetry none{SymmetryMode::None, 1, glm::vec2{0.0f, 0.0f}};
+  for (size_t i = 0; i < drawing.size(); i++) {
+    strokes.push_back(DocumentStroke{uint32_t(i + 1), 10.0f, none, &drawing[i]});
+  }
+
+  auto saveStart = Clock::now();
+  saveDocument(DOCUMENT_PATH, strokes, std::vector<DocumentSpray>());
+  double saveMs = elapsedMs(saveStart);
+
+  // Load into storage which already exists, as the engine's strokes do
+  std::vector<std::vector<glm::vec2> > loaded(drawing.size());
+  size_t numLoadedSamples = 0;
+  size_t documentSize = 0;
+
+  auto loadStart = Clock::now();
+  {
+    DocumentReader reader(DOCUMENT_PATH);
+    documentSize = reader.size();
+
+    size_t stroke = 0;
+    uint32_t id;
+    float radius;
+    Symmetry symmetry;
+    for (size_t chunk = 0; chunk < reader.chunks().size(); chunk++) {
+      DocumentChunkReader chunkReader = reader.readChunk(chunk);
+      while (stroke < loaded.size() && chunkReader.next(id, radius, symmetry, loaded[stroke])) {
+        numLoadedSamples += loaded[stroke].size();
+        stroke++;
+      }
+    }
+  }
+  double loadMs = elapsedMs(loadStart);
+
+  float maxError = 0;
+  for (size_t i = 0; i < drawing.size(); i++) {
+    for (size_t j = 0; j < drawing[i].size(); j++) {
+      maxError = std::max(maxError, glm::length(drawing[i][j] - loaded[i][j]));
+    }
+  }
+
+  std::remove(DOCUMENT_PATH);
+
+  double megabytes = double(documentSize) / (1024.0 * 1024.0);
+  printf("samples: %zu loaded %zu, document %.2f MiB (%.2f bytes/sample), max error %.4f px\n", NUM_SAMPLES,
+         numLoadedSamples, megabytes, double(documentSize) / double(NUM_SAMPLES), maxError);
+  printf("save: %.1f ms (%.1f Msamples/s, %.1f MiB/s)\n", saveMs, double(NUM_SAMPLES) / (saveMs * 1000.0),
+         megabytes / (saveMs / 1000.0));
+  printf("load: %.1f ms (%.1f Msamples/s, %.1f MiB/s)\n", loadMs, double(NUM_SAMPLES) / (loadMs * 1000.0),
+         megabytes / (loadMs / 1000.0));
+
+  return 0;
+}
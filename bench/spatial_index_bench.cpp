@@ -0,0 +1,93 @@
+// Benchmarks the stroke spatial index with a drawing of 1M segments.
+// Reports the time taken to build the index and the latency of eraser-sized
+// queries, which should depend on local density rather than drawing size.
+#include "../src/spatial_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The number of segments in the benchmarked drawing
+const size_t NUM_SEGMENTS = 1000000;
+
+// The number of segments per stroke
+const size_t SEGMENTS_PER_STROKE = 200;
+
+// The size in pixels of the square canvas the strokes are drawn over
+const float CANVAS_SIZE = 16384.0f;
+
+// The radius of the stamps and of the queried eraser in pixels
+const float STAMP_RADIUS = 10.0f;
+const float ERASER_RADIUS = 16.0f;
+
+const int NUM_QUERIES = 100000;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> position(0.0f, CANVAS_SIZE);
+  std::uniform_real_distribution<float> step(-12.0f, 12.0f);
+
+  SpatialIndex index;
+
+  // Build the drawing as random walks, similar to mouse strokes
+  auto buildStart = Clock::now();
+  uint32_t strokeId = 1;
+  for (size_t inserted = 0; inserted < NUM_SEGMENTS; strokeId++) {
+    glm::vec2 sample{position(rng), position(rng)};
+
+    for (size_t segment = 0; segment < SEGMENTS_PER_STROKE && inserted < NUM_SEGMENTS; segment++) {
+      glm::vec2 next = sample + glm::vec2{step(rng), step(rng)};
+
+      Rect bounds = Rect::empty();
+      bounds.expand(sample);
+      bounds.expand(next);
+      index.insert(strokeId, uint32_t(segment), bounds.inflated(STAMP_RADIUS));
+
+      sample = next;
+      inserted++;
+    }
+  }
+  double buildMs = elapsedMs(buildStart);
+
+  // Query eraser-sized areas at random positions
+  std::vector<double> latencies;
+  latencies.reserve(NUM_QUERIES);
+
+  std::vector<SegmentRef> results;
+  size_t numResults = 0;
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    glm::vec2 center{position(rng), position(rng)};
+
+    auto queryStart = Clock::now();
+    results.clear();
+    index.query(Rect::around(center, ERASER_RADIUS), results);
+    latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - queryStart).count());
+
+    numResults += results.size();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) { return latencies[size_t(p * double(latencies.size() - 1))]; };
+
+  // Remove every stroke, as a stroke eraser sweeping the whole canvas would
+  auto removeStart = Clock::now();
+  for (uint32_t id = 1; id < strokeId; id++) {
+    index.remove(id);
+  }
+  double removeMs = elapsedMs(removeStart);
+
+  printf("segments: %zu (%u strokes)\n", NUM_SEGMENTS, strokeId - 1);
+  printf("build: %.1f ms (%.1f ns/segment)\n", buildMs, buildMs * 1e6 / double(NUM_SEGMENTS));
+  printf("query: p50 %.2f us, p99 %.2f us, max %.2f us (%.1f hits/query)\n", percentile(0.5),
+         percentile(0.99), latencies.back(), double(numResults) / NUM_QUERIES);
+  printf("remove all: %.1f ms\n", removeMs);
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Benchmarks preparing stroke geometry for upload. Compares interpolating every
+// stamp on the CPU against building the stamp segments the stroke shader
+// interpolates, reporting the CPU time and the bytes which would be uploaded.
+#include "../src/stamp_segments.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The number of cursor samples per stroke and the number of strokes
+const size_t SAMPLES_PER_STROKE = 500;
+const size_t NUM_STROKES = 2000;
+
+// The distance in canvas space between stamps, as drawn by strokes
+const float STAMP_GAP_SIZE = 10;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// interpolateStamps appends stamps spaced at most gap apart along the segment
+// from a to b, excluding a, the way strokes built their stamps on the CPU
+static int interpolateStamps(glm::vec2 a, glm::vec2 b, float gap, std::vector<glm::vec2> &stamps) {
+  auto dx = b.x - a.x;
+  auto dy = b.y - a.y;
+
+  auto distance = std::sqrt(dx * dx + dy * dy);
+  if (distance <= 0)
+    return 0;
+
+  int steps = std::ceil(distance / gap);
+  for (int i = 1; i <= steps; i++) {
+    double t = double(i) / double(steps);
+    stamps.push_back(glm::vec2{a.x + (dx * t), a.y + (dy * t)});
+  }
+
+  return steps;
+}
+
+// run reports the time taken and bytes produced building the geometry of the
+// strokes with the given cursor speed range, in pixels per sample
+void run(const char *name, float minSpeed, float maxSpeed) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> speed(minSpeed, maxSpeed);
+  std::uniform_real_distribution<float> turn(-0.4f, 0.4f);
+
+  // Generate the strokes as smooth random walks
+  std::vector<std::vector<glm::vec2> > strokes(NUM_STROKES);
+  for (std::vector<glm::vec2> &samples : strokes) {
+    glm::vec2 position{0, 0};
+    float angle = 0;
+    for (size_t i = 0; i < SAMPLES_PER_STROKE; i++) {
+      samples.push_back(position);
+      angle += turn(rng);
+      position += glm::vec2{std::cos(angle), std::sin(angle)} * speed(rng);
+    }
+  }
+
+  std::vector<glm::vec2> stamps;
+  size_t stampBytes = 0;
+  size_t numStamps = 0;
+  auto stampStart = Clock::now();
+  for (const std::vector<glm::vec2> &samples : strokes) {
+    stamps.clear();
+    stamps.push_back(samples[0]);
+    for (size_t i = 1; i < samples.size(); i++) {
+      interpolateStamps(samples[i - 1], samples[i], STAMP_GAP_SIZE, stamps);
+    }
+    numStamps += stamps.size();
+    stampBytes += stamps.size() * sizeof(glm::vec2);
+  }
+  double stampMs = elapsedMs(stampStart);
+
+  std::vector<StampSegment> segments;
+  size_t segmentBytes = 0;
+  size_t numSegments = 0;
+  auto segmentStart = Clock::now();
+  for (const std::vector<glm::vec2> &samples : strokes) {
+    segments.clear();
+    segments.push_back(StampSegment{samples[0], 0});
+    segments.push_back(StampSegment{samples[0], 1});
+    for (size_t i = 1; i < samples.size(); i++) {
+      appendStampSegments(samples[i - 1], samples[i], STAMP_GAP_SIZE, segments);
+    }
+    numSegments += segments.size();
+    segmentBytes += segments.size() * sizeof(StampSegment);
+  }
+  double segmentMs = elapsedMs(segmentStart);
+
+  printf("%s (%.0f-%.0f px per sample): %zu stamps\n", name, minSpeed, maxSpeed, numStamps);
+  printf("  CPU interpolation: %8.2f ms  %8.2f MiB uploaded\n", stampMs, stampBytes / (1024.0 * 1024.0));
+  // Samples closer together than the stamp gap upload more as segments than as stamps
+  bool uploadsLess = segmentBytes <= stampBytes;
+  double ratio = uploadsLess ? double(stampBytes) / double(segmentBytes) : double(segmentBytes) / double(stampBytes);
+  printf("  GPU interpolation: %8.2f ms  %8.2f MiB uploaded (%zu segments, %.2fx %s than CPU)\n", segmentMs,
+         segmentBytes / (1024.0 * 1024.0), numSegments, ratio, uploadsLess ? "less" : "more");
+}
+
+int main() {
+  run("slow", 2.0f, 12.0f);
+  run("moderate", 10.0f, 40.0f);
+  run("fast", 40.0f, 160.0f);
+
+  return 0;
+}
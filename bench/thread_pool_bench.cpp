@@ -0,0 +1,152 @@
+// Benchmarks the thread pool's scaling from one worker to one per hardware thread.
+// Each workload is timed at every worker count and reported with its speedup
+// over a single worker:
+//  - independent tasks submitted from the main thread, joined by a task which
+//    depends on all of them and reports back through the completion queue
+//  - tasks which each run a nested parallelFor, as fills do
+//  - encoding a large PNG export, which deflates bands with parallelFor
+#include "../src/png_encoder.h"
+#include "../src/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The number of independent tasks and the iterations of work each runs
+const size_t NUM_TASKS = 4096;
+const size_t TASK_ITERATIONS = 20000;
+
+// The number of tasks running a nested parallelFor, and the range each splits
+const size_t NUM_NESTED_TASKS = 64;
+const size_t NESTED_RANGE = 1 << 16;
+
+// The size of the encoded image in pixels
+const int IMAGE_SIZE = 4096;
+
+// The number of times each workload is run, keeping the fastest
+const int NUM_RUNS = 3;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// spin does a fixed amount of floating point work which can't be optimised away
+static double spin(size_t iterations, double seed) {
+  double value = seed;
+  for (size_t i = 0; i < iterations; i++) {
+    value = std::sqrt(value + double(i));
+  }
+  return value;
+}
+
+// waitFor drains the completion queue on the calling thread, as the render loop
+// would, until the given task has finished
+static void waitFor(ThreadPool &pool, const std::vector<Task> &tasks) {
+  bool done = false;
+  pool.submit([]() {}, tasks, [&done]() { done = true; });
+
+  while (!done) {
+    if (pool.drainCompletions() == 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+static double runIndependent(ThreadPool &pool) {
+  std::vector<double> results(NUM_TASKS);
+  std::vector<Task> tasks;
+  tasks.reserve(NUM_TASKS);
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < NUM_TASKS; i++) {
+    tasks.push_back(pool.submit([&results, i]() { results[i] = spin(TASK_ITERATIONS, double(i)); }));
+  }
+  waitFor(pool, tasks);
+
+  return elapsedMs(start);
+}
+
+static double runNested(ThreadPool &pool) {
+  std::vector<double> results(NUM_NESTED_TASKS * NESTED_RANGE);
+  std::vector<Task> tasks;
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < NUM_NESTED_TASKS; i++) {
+    tasks.push_back(pool.submit([&pool, &results, i]() {
+      pool.parallelFor(NESTED_RANGE, 1024, [&results, i](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; j++) {
+          results[(i * NESTED_RANGE) + j] = spin(16, double(j));
+        }
+      });
+    }));
+  }
+  waitFor(pool, tasks);
+
+  return elapsedMs(start);
+}
+
+static double runEncode(ThreadPool &pool, const std::vector<uint8_t> &pixels) {
+  std::vector<uint8_t> png;
+
+  auto start = Clock::now();
+  Task encode = pool.submit([&]() { png = encodePng(pixels.data(), IMAGE_SIZE, IMAGE_SIZE, pool); });
+  waitFor(pool, {encode});
+
+  return elapsedMs(start);
+}
+
+int main() {
+  // A drawing-like image: a white background with solid blobs and some noise
+  std::mt19937 rng(42);
+  std::vector<uint8_t> pixels(size_t(IMAGE_SIZE) * IMAGE_SIZE * 4, 0xFF);
+  for (int blob = 0; blob < 200; blob++) {
+    int cx = int(rng() % IMAGE_SIZE), cy = int(rng() % IMAGE_SIZE), radius = 20 + int(rng() % 200);
+    uint32_t color = rng();
+    for (int y = std::max(0, cy - radius); y < std::min(IMAGE_SIZE, cy + radius); y++) {
+      for (int x = std::max(0, cx - radius); x < std::min(IMAGE_SIZE, cx + radius); x++) {
+        uint8_t *pixel = &pixels[((size_t(y) * IMAGE_SIZE) + x) * 4];
+        pixel[0] = uint8_t(color);
+        pixel[1] = uint8_t(color >> 8);
+        pixel[2] = uint8_t((color >> 16) ^ (rng() & 3));
+      }
+    }
+  }
+
+  size_t maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> workerCounts;
+  for (size_t count = 1; count < maxWorkers; count *= 2) {
+    workerCounts.push_back(count);
+  }
+  workerCounts.push_back(maxWorkers);
+
+  printf("%8s %20s %20s %20s\n", "workers", "independent", "nested", "encode");
+
+  double baseline[3] = {0, 0, 0};
+  for (size_t numWorkers : workerCounts) {
+    ThreadPool pool(numWorkers);
+
+    double best[3] = {1e300, 1e300, 1e300};
+    for (int run = 0; run < NUM_RUNS; run++) {
+      best[0] = std::min(best[0], runIndependent(pool));
+      best[1] = std::min(best[1], runNested(pool));
+      best[2] = std::min(best[2], runEncode(pool, pixels));
+    }
+
+    if (numWorkers == workerCounts.front()) {
+      std::copy(best, best + 3, baseline);
+    }
+
+    printf("%8zu", numWorkers);
+    for (int workload = 0; workload < 3; workload++) {
+      printf(" %9.1f ms (%5.2fx)", best[workload], baseline[workload] / best[workload]);
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
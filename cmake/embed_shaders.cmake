@@ -0,0 +1,33 @@
+# Embeds the GLSL sources under SHADER_DIR into the header OUTPUT, as constexpr
+# strings compiled into the binary. Run with cmake -P at build time.
+#
+# Each file becomes a constant named after its path, e.g stroke/stroke.vert
+# becomes SHADER_STROKE_VERT. Sources have no #version line: ShaderCache
+# prepends the platform header and feature defines of each permutation.
+
+file(GLOB_RECURSE SHADER_FILES RELATIVE "${SHADER_DIR}" "${SHADER_DIR}/*.vert" "${SHADER_DIR}/*.frag")
+list(SORT SHADER_FILES)
+
+set(HEADER "// Generated by cmake/embed_shaders.cmake from src/shaders. Do not edit.\n")
+string(APPEND HEADER "#ifndef EMBEDDED_SHADERS_H\n#define EMBEDDED_SHADERS_H\n")
+
+foreach(file ${SHADER_FILES})
+    get_filename_component(stem "${file}" NAME_WE)
+    get_filename_component(ext "${file}" EXT)
+    string(SUBSTRING "${ext}" 1 -1 ext)
+    string(TOUPPER "SHADER_${stem}_${ext}" name)
+
+    file(READ "${SHADER_DIR}/${file}" source)
+    string(APPEND HEADER "\n// ${file}\n")
+    string(APPEND HEADER "inline constexpr char ${name}[] = R\"glsl(${source})glsl\";\n")
+endforeach()
+
+string(APPEND HEADER "\n#endif // EMBEDDED_SHADERS_H\n")
+
+# Only touch the header when the shaders changed, so unchanged sources aren't rebuilt
+if (EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" previous)
+endif()
+if (NOT "${previous}" STREQUAL "${HEADER}")
+    file(WRITE "${OUTPUT}" "${HEADER}")
+endif()
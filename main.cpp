@@ -2,13 +2,44 @@
 #include "src/engine.h"
 #include "src/utils.h"
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <vector>
 
-int main() {
+int main(int argc, char **argv) {
+  // An optional --canvas WIDTHxHEIGHT sets the size of the canvas, which may be
+  // far larger than the window, e.g. --canvas 32768x32768 for a poster
+  int canvasWidth = 0, canvasHeight = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--canvas") != 0)
+      continue;
+
+    if (i + 1 == argc) {
+      std::cerr << "Missing canvas size, expected --canvas WIDTHxHEIGHT" << std::endl;
+      return 1;
+    }
+
+    if (std::sscanf(argv[i + 1], "%dx%d", &canvasWidth, &canvasHeight) != 2 || canvasWidth <= 0 ||
+        canvasHeight <= 0) {
+      std::cerr << "Invalid canvas size " << argv[i + 1] << ", expected WIDTHxHEIGHT" << std::endl;
+      return 1;
+    }
+  }
+
+  // An optional --first-frame exits once the first frame has been presented,
+  // logging how long each phase of startup took
+  bool exitAfterFirstFrame = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--first-frame") == 0) {
+      exitAfterFirstFrame = true;
+    }
+  }
+
   // Setup the engine
-  Engine engine(800, 600, "Drawww");
+  Engine engine(800, 600, "Drawww", canvasWidth, canvasHeight);
+  engine.exitAfterFirstFrame = exitAfterFirstFrame;
 
   // Run the engine until the user closes the window
   engine.run();
@@ -0,0 +1,38 @@
+#include "camera.h"
+#include "../vendor/glm/glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+
+// Camera creates a camera showing canvas space one to one with the frame buffer
+Camera::Camera() : position(0.0f, 0.0f), zoom(1.0f) {}
+
+// viewProjection returns the matrix transforming canvas space positions to
+// clip space for a viewport of the given size
+glm::mat4 Camera::viewProjection(glm::vec2 viewportSize) const {
+  Rect visible = this->visibleRect(viewportSize);
+
+  // Canvas space grows downwards, so the top of the view is its minimum y
+  return glm::ortho(visible.min.x, visible.max.x, visible.max.y, visible.min.y, -1.0f, 1.0f);
+}
+
+// visibleRect returns the region of canvas space shown in a viewport of the given size
+Rect Camera::visibleRect(glm::vec2 viewportSize) const {
+  return Rect{this->position, this->position + (viewportSize / this->zoom)};
+}
+
+// screenToCanvas converts a frame buffer position to canvas space
+glm::vec2 Camera::screenToCanvas(glm::vec2 screenPosition) const {
+  return this->position + (screenPosition / this->zoom);
+}
+
+// pan moves the camera by a distance in frame buffer pixels, so the
+// canvas follows the cursor
+void Camera::pan(glm::vec2 screenDelta) { this->position -= screenDelta / this->zoom; }
+
+// zoomAt scales the zoom by a factor, keeping the canvas position under the
+// given frame buffer position fixed
+void Camera::zoomAt(glm::vec2 screenPosition, float factor) {
+  glm::vec2 anchor = this->screenToCanvas(screenPosition);
+
+  this->zoom = std::min(std::max(this->zoom * factor, CAMERA_MIN_ZOOM), CAMERA_MAX_ZOOM);
+  this->position = anchor - (screenPosition / this->zoom);
+}
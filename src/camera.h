@@ -0,0 +1,46 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+#include "rect.h"
+#include "../vendor/glm/glm/glm.hpp"
+
+// The range the camera can be zoomed within
+const float CAMERA_MIN_ZOOM = 0.01f;
+const float CAMERA_MAX_ZOOM = 20.0f;
+
+// The factor the zoom changes by per scroll step
+const float CAMERA_ZOOM_STEP = 1.1f;
+
+// Camera maps between canvas space, where strokes are stored, and frame
+// buffer pixels. Canvas space is unbounded and uses the same orientation as
+// the frame buffer, with y increasing downwards.
+class Camera {
+public:
+  // Camera creates a camera showing canvas space one to one with the frame buffer
+  Camera();
+
+  // The canvas space position shown at the top left of the viewport
+  glm::vec2 position;
+
+  // The number of frame buffer pixels per canvas space unit
+  float zoom;
+
+  // viewProjection returns the matrix transforming canvas space positions to
+  // clip space for a viewport of the given size
+  glm::mat4 viewProjection(glm::vec2 viewportSize) const;
+
+  // visibleRect returns the region of canvas space shown in a viewport of the given size
+  Rect visibleRect(glm::vec2 viewportSize) const;
+
+  // screenToCanvas converts a frame buffer position to canvas space
+  glm::vec2 screenToCanvas(glm::vec2 screenPosition) const;
+
+  // pan moves the camera by a distance in frame buffer pixels, so the
+  // canvas follows the cursor
+  void pan(glm::vec2 screenDelta);
+
+  // zoomAt scales the zoom by a factor, keeping the canvas position under the
+  // given frame buffer position fixed
+  void zoomAt(glm::vec2 screenPosition, float factor);
+};
+
+#endif // CAMERA_H
@@ -0,0 +1,856 @@
+#include "canvas.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef CANVAS_MAPPED_TILES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// The number of draws a resident tile may go unused before it is compressed
+const uint64_t CANVAS_TILE_IDLE_DRAWS = 120;
+
+// The most tiles compressed per draw, so scrolling a large canvas out of view
+// spreads the work across frames
+const size_t CANVAS_TILES_COMPRESSED_PER_DRAW = 4;
+
+// Tiles drawn smaller than this many pixels along each side are drawn in their
+// average color rather than uploaded
+const float CANVAS_TILE_MIN_TEXTURED_SIZE = 96.0f;
+
+// The number of pixels in a tile sized texture or tile file slot
+const size_t CANVAS_TILE_PIXELS = size_t(CANVAS_TILE_SIZE) * CANVAS_TILE_SIZE;
+
+// The longest run a single run-length code can describe
+const size_t CANVAS_MAX_RUN = 0x8000;
+
+// compressPixels run-length encodes pixels. Each code is a u16 whose high bit
+// marks a run of a single pixel repeated, followed by that pixel, or else
+// literal pixels, followed by the pixels. The low bits store the count minus one.
+static void compressPixels(const uint32_t *pixels, size_t count, std::vector<uint8_t> &out) {
+  out.clear();
+
+  auto putCode = [&out](uint16_t code) {
+    uint8_t bytes[2];
+    std::memcpy(bytes, &code, sizeof(code));
+    out.insert(out.end(), bytes, bytes + sizeof(code));
+  };
+
+  size_t i = 0;
+  while (i < count) {
+    size_t run = 1;
+    while (i + run < count && run < CANVAS_MAX_RUN && pixels[i + run] == pixels[i]) {
+      run++;
+    }
+
+    if (run >= 2) {
+      putCode(uint16_t(0x8000 | (run - 1)));
+      const uint8_t *pixel = reinterpret_cast<const uint8_t *>(pixels + i);
+      out.insert(out.end(), pixel, pixel + sizeof(uint32_t));
+
+      i += run;
+      continue;
+    }
+
+    // Gather literals until the next run begins
+    size_t start = i;
+    while (i < count && i - start < CANVAS_MAX_RUN && !(i + 1 < count && pixels[i + 1] == pixels[i])) {
+      i++;
+    }
+
+    putCode(uint16_t(i - start - 1));
+    const uint8_t *literals = reinterpret_cast<const uint8_t *>(pixels + start);
+    out.insert(out.end(), literals, literals + ((i - start) * sizeof(uint32_t)));
+  }
+
+  out.shrink_to_fit();
+}
+
+// decompressPixels decodes pixels run-length encoded by compressPixels
+static void decompressPixels(const std::vector<uint8_t> &data, uint32_t *pixels, size_t count) {
+  const uint8_t *in = data.data();
+  const uint8_t *end = data.data() + data.size();
+  size_t i = 0;
+
+  while (in + sizeof(uint16_t) <= end) {
+    uint16_t code;
+    std::memcpy(&code, in, sizeof(code));
+    in += sizeof(code);
+
+    size_t length = size_t(code & 0x7FFF) + 1;
+    size_t bytes = (code & 0x8000) ? sizeof(uint32_t) : length * sizeof(uint32_t);
+    if (i + length > count || in + bytes > end) {
+      throw std::runtime_error("canvas tile is corrupt");
+    }
+
+    if (code & 0x8000) {
+      uint32_t pixel;
+      std::memcpy(&pixel, in, sizeof(pixel));
+      std::fill(pixels + i, pixels + i + length, pixel);
+    } else {
+      std::memcpy(pixels + i, in, bytes);
+    }
+
+    in += bytes;
+    i += length;
+  }
+}
+
+// createTileTexture creates a tile sized texture, sampled one to one
+static unsigned int createTileTexture() {
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, CANVAS_TILE_SIZE, CANVAS_TILE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+  return texture;
+}
+
+// averagePixels returns the average color of pixels
+static uint32_t averagePixels(const uint32_t *pixels, size_t count) {
+  uint64_t sums[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < count; i++) {
+    for (int channel = 0; channel < 4; channel++) {
+      sums[channel] += (pixels[i] >> (channel * 8)) & 0xFF;
+    }
+  }
+
+  uint32_t average = 0;
+  for (int channel = 0; channel < 4; channel++) {
+    average |= uint32_t(sums[channel] / count) << (channel * 8);
+  }
+
+  return average;
+}
+
+// Canvas creates a blank canvas of the given size in pixels. Canvases larger
+// than CANVAS_MAPPED_MIN_BYTES keep their tiles in a file created at tilePath.
+Canvas::Canvas(int width, int height, Shader &shader, const std::string &tilePath)
+    : width(width), height(height), mapping(nullptr), mappingBytes(0), tileFile(-1), tilePath(tilePath),
+      prefetchRange{0, -1, 0, -1}, prefetchPending(false), stopping(false), numDraws(0), shader(shader),
+      readbackFBO(0), readbackTexture(0), readbackX(0), readbackY(0), readbackWidth(0), readbackHeight(0),
+      readbackTextureWidth(0), readbackTextureHeight(0), readbackTileTexture(0) {
+  // Split the canvas into tiles, which all start out empty
+  this->numTilesX = (width + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE;
+  this->numTilesY = (height + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE;
+
+  this->tiles.resize(size_t(this->numTilesX) * this->numTilesY);
+  for (int ty = 0; ty < this->numTilesY; ty++) {
+    for (int tx = 0; tx < this->numTilesX; tx++) {
+      Tile &tile = this->tiles[(size_t(ty) * this->numTilesX) + tx];
+      tile.x = tx * CANVAS_TILE_SIZE;
+      tile.y = ty * CANVAS_TILE_SIZE;
+      tile.width = std::min(CANVAS_TILE_SIZE, width - tile.x);
+      tile.height = std::min(CANVAS_TILE_SIZE, height - tile.y);
+      tile.state = TileState::Empty;
+      tile.color = CANVAS_BACKGROUND_COLOR;
+      tile.slot = -1;
+      tile.dirty = false;
+      tile.average = CANVAS_BACKGROUND_COLOR;
+      tile.averageStale = false;
+      tile.lastUsed = 0;
+    }
+  }
+
+#ifdef CANVAS_MAPPED_TILES
+  // Back large canvases with a sparse tile file, which only takes up disk
+  // space for the tiles which are drawn on
+  if (size_t(width) * height * sizeof(uint32_t) > CANVAS_MAPPED_MIN_BYTES) {
+    this->mappingBytes = this->tiles.size() * CANVAS_TILE_PIXELS * sizeof(uint32_t);
+
+    this->tileFile = open(tilePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (this->tileFile < 0 || ftruncate(this->tileFile, off_t(this->mappingBytes)) != 0) {
+      throw std::runtime_error("failed to create canvas tile file: " + tilePath);
+    }
+
+    void *mapping = mmap(nullptr, this->mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, this->tileFile, 0);
+    if (mapping == MAP_FAILED) {
+      close(this->tileFile);
+      unlink(tilePath.c_str());
+      throw std::runtime_error("failed to map canvas tile file: " + tilePath);
+    }
+
+    this->mapping = static_cast<uint32_t *>(mapping);
+    this->prefetcher = std::thread(&Canvas::prefetchLoop, this);
+  }
+#endif
+
+  // Setup a unit quad which is scaled over each tile. Positions are in canvas
+  // space (top row first) and texture coordinates follow OpenGL (bottom row first).
+  float vertexData[] = {
+      0, 0, 0, 1, //
+      1, 0, 1, 1, //
+      0, 1, 0, 0, //
+      1, 1, 1, 0, //
+  };
+
+  glGenVertexArrays(1, &(this->VAO));
+  glGenBuffers(1, &(this->VBO));
+
+  glBindVertexArray(this->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+// Cleanup
+Canvas::~Canvas() {
+  glDeleteVertexArrays(1, &(this->VAO));
+  glDeleteBuffers(1, &(this->VBO));
+
+  for (TextureSlot &slot : this->textureSlots) {
+    glDeleteTextures(1, &(slot.texture));
+  }
+
+  this->releaseReadbackTarget();
+  if (this->readbackTileTexture != 0) {
+    glDeleteTextures(1, &(this->readbackTileTexture));
+  }
+
+#ifdef CANVAS_MAPPED_TILES
+  if (this->mapping != nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(this->prefetchMutex);
+      this->stopping = true;
+    }
+    this->prefetchCondition.notify_one();
+    this->prefetcher.join();
+
+    // The tile file is scratch space for this session only
+    munmap(this->mapping, this->mappingBytes);
+    close(this->tileFile);
+    unlink(this->tilePath.c_str());
+  }
+#endif
+}
+
+// isVirtual indicates whether the canvas' tiles live in a memory mapped file
+bool Canvas::isVirtual() const {
+  return this->mapping != nullptr;
+}
+
+// draws the whole canvas to the screen
+void Canvas::draw() {
+  this->drawRegion(Rect{glm::vec2{0.0f, 0.0f}, glm::vec2{float(this->width), float(this->height)}}, 1.0f);
+}
+
+// drawRegion draws the tiles of the canvas which intersect a region of
+// canvas space at the given zoom, then compresses resident tiles which have
+// gone unused
+void Canvas::drawRegion(const Rect &visible, float zoom) {
+  this->numDraws++;
+
+  // Find the tiles in view. Canvas space grows downwards while tile rows grow upwards.
+  int minTileX = std::max(0, int(std::floor(visible.min.x / CANVAS_TILE_SIZE)));
+  int maxTileX = std::min(this->numTilesX - 1, int(std::floor(visible.max.x / CANVAS_TILE_SIZE)));
+  int minTileY = std::max(0, int(std::floor((this->height - visible.max.y) / CANVAS_TILE_SIZE)));
+  int maxTileY = std::min(this->numTilesY - 1, int(std::floor((this->height - visible.min.y) / CANVAS_TILE_SIZE)));
+
+  bool zoomedOut = CANVAS_TILE_SIZE * zoom < CANVAS_TILE_MIN_TEXTURED_SIZE;
+
+  this->shader.use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(this->VAO);
+
+  for (int ty = minTileY; ty <= maxTileY; ty++) {
+    for (int tx = minTileX; tx <= maxTileX; tx++) {
+      Tile &tile = this->tiles[(size_t(ty) * this->numTilesX) + tx];
+      tile.lastUsed = this->numDraws;
+
+      // Empty tiles match the cleared background
+      if (tile.state == TileState::Empty)
+        continue;
+
+      this->drawTile(tile, zoomedOut);
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  this->compressIdleTiles();
+}
+
+// drawTile draws a tile, uploading its pixels first if they have changed
+void Canvas::drawTile(Tile &tile, bool zoomedOut) {
+  this->shader.setVec4("tileRect", float(tile.x), float(this->height - (tile.y + tile.height)), float(tile.width),
+                       float(tile.height));
+
+  if (tile.state == TileState::Uniform) {
+    this->drawSolid(tile.color);
+    return;
+  }
+
+  // Tiles too small to make out are drawn in their average color. Compressed
+  // tiles always have an up to date average, so they needn't be decompressed.
+  if (zoomedOut) {
+    if (tile.averageStale) {
+      tile.average = averagePixels(this->tilePixels(tile), size_t(tile.width) * tile.height);
+      tile.averageStale = false;
+    }
+
+    this->drawSolid(tile.average);
+    return;
+  }
+
+  // A tile whose texture is still cached is drawn without touching its pixels
+  size_t index = size_t(&tile - this->tiles.data());
+  if (tile.slot < 0) {
+    tile.slot = this->acquireSlot(index);
+
+    // The cache is full of tiles in view, so this one is drawn as a solid color
+    if (tile.slot < 0) {
+      if (tile.averageStale) {
+        tile.average = averagePixels(this->tilePixels(tile), size_t(tile.width) * tile.height);
+        tile.averageStale = false;
+      }
+
+      this->drawSolid(tile.average);
+      return;
+    }
+
+    tile.dirty = true;
+  }
+
+  TextureSlot &slot = this->textureSlots[size_t(tile.slot)];
+  slot.lastUsed = this->numDraws;
+  glBindTexture(GL_TEXTURE_2D, slot.texture);
+
+  if (tile.dirty) {
+    this->makeResident(tile);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile.width, tile.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    this->tilePixels(tile));
+    tile.dirty = false;
+  }
+
+  // Edge tiles only fill part of their texture
+  this->shader.setInt("solid", 0);
+  this->shader.setVec2("uvScale", float(tile.width) / CANVAS_TILE_SIZE, float(tile.height) / CANVAS_TILE_SIZE);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// drawSolid draws a tile in a single color
+void Canvas::drawSolid(uint32_t color) {
+  this->shader.setInt("solid", 1);
+  this->shader.setVec4("solidColor", float(color & 0xFF) / 255.0f, float((color >> 8) & 0xFF) / 255.0f,
+                       float((color >> 16) & 0xFF) / 255.0f, float(color >> 24) / 255.0f);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// acquireSlot finds a texture for a tile, reusing the least recently drawn
+// tile's texture once the cache is full. It returns -1 if every texture has
+// been drawn by the current draw.
+int Canvas::acquireSlot(size_t tile) {
+  if (this->textureSlots.size() < CANVAS_TEXTURE_CACHE_SIZE) {
+    TextureSlot slot{createTileTexture(), tile, this->numDraws};
+    this->textureSlots.push_back(slot);
+    return int(this->textureSlots.size() - 1);
+  }
+
+  // Evict the least recently drawn tile. The cache is small, so a scan is
+  // cheaper than keeping the slots ordered on every draw.
+  int oldest = -1;
+  for (size_t i = 0; i < this->textureSlots.size(); i++) {
+    const TextureSlot &slot = this->textureSlots[i];
+    if (slot.lastUsed == this->numDraws)
+      continue;
+
+    if (oldest < 0 || slot.tile == SIZE_MAX || slot.lastUsed < this->textureSlots[size_t(oldest)].lastUsed) {
+      oldest = int(i);
+      if (slot.tile == SIZE_MAX)
+        break;
+    }
+  }
+
+  if (oldest < 0)
+    return -1;
+
+  TextureSlot &slot = this->textureSlots[size_t(oldest)];
+  if (slot.tile != SIZE_MAX) {
+    this->tiles[slot.tile].slot = -1;
+  }
+
+  slot.tile = tile;
+  slot.lastUsed = this->numDraws;
+
+  return oldest;
+}
+
+// releaseSlot returns a tile's texture to the cache
+void Canvas::releaseSlot(Tile &tile) {
+  if (tile.slot < 0)
+    return;
+
+  TextureSlot &slot = this->textureSlots[size_t(tile.slot)];
+  slot.tile = SIZE_MAX;
+  slot.lastUsed = 0;
+  tile.slot = -1;
+}
+
+// makeResident decompresses a tile's pixels, or gives it a slot in the tile
+// file, so they can be drawn or edited
+void Canvas::makeResident(Tile &tile) {
+  if (tile.state == TileState::Resident || tile.state == TileState::Mapped)
+    return;
+
+  if (this->mapping != nullptr) {
+    // Every tile has its own slot in the tile file. Tiles are only ever
+    // uniform or mapped, as the OS takes care of paging them out.
+    tile.state = TileState::Mapped;
+    uint32_t *pixels = this->mapping + (size_t(&tile - this->tiles.data()) * CANVAS_TILE_PIXELS);
+    std::fill(pixels, pixels + (size_t(tile.width) * tile.height), tile.color);
+
+    tile.dirty = true;
+    tile.lastUsed = this->numDraws;
+    return;
+  }
+
+  tile.pixels.resize(size_t(tile.width) * tile.height);
+
+  if (tile.state == TileState::Compressed) {
+    decompressPixels(tile.compressed, tile.pixels.data(), tile.pixels.size());
+    std::vector<uint8_t>().swap(tile.compressed);
+  } else {
+    std::fill(tile.pixels.begin(), tile.pixels.end(), tile.color);
+    tile.dirty = true;
+  }
+
+  tile.state = TileState::Resident;
+  tile.lastUsed = this->numDraws;
+
+  this->residentTiles.push_back(size_t(&tile - this->tiles.data()));
+}
+
+// tilePixels returns the pixels of a resident or mapped tile, stored row by row
+uint32_t *Canvas::tilePixels(Tile &tile) {
+  this->makeResident(tile);
+
+  if (tile.state == TileState::Mapped) {
+    return this->mapping + (size_t(&tile - this->tiles.data()) * CANVAS_TILE_PIXELS);
+  }
+
+  return tile.pixels.data();
+}
+
+// markReplaced marks a tile whose every pixel is about to be overwritten, so
+// its old pixels needn't be decompressed first
+void Canvas::markReplaced(Tile &tile) {
+  if (tile.state == TileState::Compressed) {
+    std::vector<uint8_t>().swap(tile.compressed);
+    tile.state = TileState::Uniform;
+  }
+
+  this->markEdited(tile);
+}
+
+// markEdited marks a tile whose pixels are about to change
+void Canvas::markEdited(Tile &tile) {
+  this->makeResident(tile);
+  tile.dirty = true;
+  tile.averageStale = true;
+  tile.lastUsed = this->numDraws;
+}
+
+// compress stores a resident tile's pixels in the smallest form which holds
+// them. A compressed tile keeps its cached texture, if it still has one.
+void Canvas::compress(Tile &tile) {
+  if (tile.state != TileState::Resident)
+    return;
+
+  uint32_t first = tile.pixels[0];
+  bool uniform = std::all_of(tile.pixels.begin(), tile.pixels.end(), [first](uint32_t pixel) { return pixel == first; });
+
+  if (uniform) {
+    tile.state = first == CANVAS_BACKGROUND_COLOR ? TileState::Empty : TileState::Uniform;
+    tile.color = first;
+    this->releaseSlot(tile);
+  } else {
+    compressPixels(tile.pixels.data(), tile.pixels.size(), tile.compressed);
+    tile.state = TileState::Compressed;
+  }
+
+  if (tile.averageStale) {
+    tile.average = averagePixels(tile.pixels.data(), tile.pixels.size());
+    tile.averageStale = false;
+  }
+
+  std::vector<uint32_t>().swap(tile.pixels);
+}
+
+// compressIdleTiles compresses resident tiles which have gone unused
+void Canvas::compressIdleTiles() {
+  size_t numCompressed = 0;
+
+  for (size_t i = 0; i < this->residentTiles.size() && numCompressed < CANVAS_TILES_COMPRESSED_PER_DRAW;) {
+    Tile &tile = this->tiles[this->residentTiles[i]];
+    if (this->numDraws - tile.lastUsed <= CANVAS_TILE_IDLE_DRAWS) {
+      i++;
+      continue;
+    }
+
+    this->compress(tile);
+    numCompressed++;
+
+    this->residentTiles[i] = this->residentTiles.back();
+    this->residentTiles.pop_back();
+  }
+}
+
+// prefetch asks for the tiles around a region of canvas space to be paged in
+// ahead of being drawn. Only virtual canvases page their tiles.
+void Canvas::prefetch(const Rect &region) {
+  if (this->mapping == nullptr)
+    return;
+
+  // Include the ring of tiles neighbouring the region
+  int range[4] = {
+      std::max(0, int(std::floor(region.min.x / CANVAS_TILE_SIZE)) - 1),
+      std::min(this->numTilesX - 1, int(std::floor(region.max.x / CANVAS_TILE_SIZE)) + 1),
+      std::max(0, int(std::floor((this->height - region.max.y) / CANVAS_TILE_SIZE)) - 1),
+      std::min(this->numTilesY - 1, int(std::floor((this->height - region.min.y) / CANVAS_TILE_SIZE)) + 1),
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(this->prefetchMutex);
+    if (std::equal(range, range + 4, this->prefetchRange))
+      return;
+
+    std::copy(range, range + 4, this->prefetchRange);
+    this->prefetchPending = true;
+  }
+
+  this->prefetchCondition.notify_one();
+}
+
+// prefetchLoop pages in the tiles around the view on the prefetch thread.
+// Only the most recent range is paged in, so a fast pan skips ranges it has
+// already moved past. Tile file slots are fixed, so the thread never needs to
+// look at the tiles themselves.
+void Canvas::prefetchLoop() {
+#ifdef CANVAS_MAPPED_TILES
+  std::vector<size_t> paged;
+  const size_t slotBytes = CANVAS_TILE_PIXELS * sizeof(uint32_t);
+
+  while (true) {
+    int range[4];
+    {
+      std::unique_lock<std::mutex> lock(this->prefetchMutex);
+      this->prefetchCondition.wait(lock, [this]() { return this->prefetchPending || this->stopping; });
+      if (this->stopping)
+        return;
+
+      std::copy(this->prefetchRange, this->prefetchRange + 4, range);
+      this->prefetchPending = false;
+    }
+
+    // Slots of tiles which were never drawn on are holes in the sparse file,
+    // so asking for them costs nothing
+    for (int ty = range[2]; ty <= range[3]; ty++) {
+      for (int tx = range[0]; tx <= range[1]; tx++) {
+        size_t index = (size_t(ty) * this->numTilesX) + tx;
+        madvise(reinterpret_cast<uint8_t *>(this->mapping) + (index * slotBytes), slotBytes, MADV_WILLNEED);
+      }
+    }
+  }
+#endif
+}
+
+// fillSpans writes a color over spans of pixels, such as those of a fill
+// result. The spans are offset by the position of the region they were found in.
+// The tiles the spans touch are made resident first, then the spans are written
+// in parallel; spans never overlap, so they can be written in any order.
+void Canvas::fillSpans(const std::vector<FillSpan> &spans, int offsetX, int offsetY, uint32_t color,
+                       ThreadPool &pool) {
+  for (const FillSpan &span : spans) {
+    int ty = (span.y + offsetY) / CANVAS_TILE_SIZE;
+    for (int tx = (span.x0 + offsetX) / CANVAS_TILE_SIZE; tx <= (span.x1 + offsetX - 1) / CANVAS_TILE_SIZE; tx++) {
+      this->markEdited(this->tiles[(size_t(ty) * this->numTilesX) + tx]);
+    }
+  }
+
+  pool.parallelFor(spans.size(), 1024, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const FillSpan &span = spans[i];
+      int y = span.y + offsetY;
+      int spanX0 = span.x0 + offsetX, spanX1 = span.x1 + offsetX;
+      int ty = y / CANVAS_TILE_SIZE;
+
+      for (int tx = spanX0 / CANVAS_TILE_SIZE; tx <= (spanX1 - 1) / CANVAS_TILE_SIZE; tx++) {
+        Tile &tile = this->tiles[(size_t(ty) * this->numTilesX) + tx];
+        int x0 = std::max(spanX0, tile.x) - tile.x;
+        int x1 = std::min(spanX1, tile.x + tile.width) - tile.x;
+
+        uint32_t *row = this->tilePixels(tile) + (size_t(y - tile.y) * tile.width);
+        std::fill(row + x0, row + x1, color);
+      }
+    }
+  });
+}
+
+// bindReadbackTarget binds an offscreen frame buffer covering a region of the
+// canvas' pixels, so the scene can be rendered into it and read back with
+// readback. The region is at most CANVAS_MAX_READBACK_SIZE along each side.
+void Canvas::bindReadbackTarget(int x, int y, int width, int height) {
+  if (width > CANVAS_MAX_READBACK_SIZE || height > CANVAS_MAX_READBACK_SIZE) {
+    throw std::runtime_error("canvas read back region is too large");
+  }
+
+  // The frame buffer is kept while read backs fit in it. Read backs use its
+  // bottom left corner, so a larger one only grows it.
+  int textureWidth = std::max(width, this->readbackTextureWidth);
+  int textureHeight = std::max(height, this->readbackTextureHeight);
+  if (this->readbackFBO != 0 &&
+      (textureWidth != this->readbackTextureWidth || textureHeight != this->readbackTextureHeight)) {
+    this->releaseReadbackTarget();
+  }
+
+  this->readbackX = x;
+  this->readbackY = y;
+  this->readbackWidth = width;
+  this->readbackHeight = height;
+
+  if (this->readbackFBO == 0) {
+    glGenTextures(1, &(this->readbackTexture));
+    glBindTexture(GL_TEXTURE_2D, this->readbackTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    this->readbackTextureWidth = textureWidth;
+    this->readbackTextureHeight = textureHeight;
+
+    glGenFramebuffers(1, &(this->readbackFBO));
+    glBindFramebuffer(GL_FRAMEBUFFER, this->readbackFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->readbackTexture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      this->releaseReadbackTarget();
+      throw std::runtime_error("canvas read back frame buffer is incomplete");
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, this->readbackFBO);
+  glViewport(0, 0, width, height);
+}
+
+// releaseReadbackTarget releases the offscreen frame buffer until it is next bound
+void Canvas::releaseReadbackTarget() {
+  if (this->readbackFBO == 0)
+    return;
+
+  glDeleteFramebuffers(1, &(this->readbackFBO));
+  glDeleteTextures(1, &(this->readbackTexture));
+  this->readbackFBO = 0;
+  this->readbackTexture = 0;
+  this->readbackTextureWidth = 0;
+  this->readbackTextureHeight = 0;
+}
+
+// drawReadbackRegion draws the tiles of the canvas which intersect the region
+// the offscreen frame buffer covers, one pixel per unit. Tiles are drawn from
+// their cached texture where it is up to date, and otherwise uploaded through
+// a single scratch texture, decompressing compressed tiles into a scratch
+// buffer. Reading back a region therefore neither evicts the textures of the
+// tiles in view nor leaves the tiles it touched resident.
+void Canvas::drawReadbackRegion() {
+  int minTileX = this->readbackX / CANVAS_TILE_SIZE;
+  int maxTileX = (this->readbackX + this->readbackWidth - 1) / CANVAS_TILE_SIZE;
+  int minTileY = this->readbackY / CANVAS_TILE_SIZE;
+  int maxTileY = (this->readbackY + this->readbackHeight - 1) / CANVAS_TILE_SIZE;
+
+  this->shader.use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(this->VAO);
+
+  for (int ty = minTileY; ty <= maxTileY; ty++) {
+    for (int tx = minTileX; tx <= maxTileX; tx++) {
+      Tile &tile = this->tiles[(size_t(ty) * this->numTilesX) + tx];
+
+      // Empty tiles match the cleared background
+      if (tile.state == TileState::Empty)
+        continue;
+
+      this->shader.setVec4("tileRect", float(tile.x), float(this->height - (tile.y + tile.height)), float(tile.width),
+                           float(tile.height));
+
+      if (tile.state == TileState::Uniform) {
+        this->drawSolid(tile.color);
+        continue;
+      }
+
+      if (tile.slot >= 0 && !tile.dirty) {
+        glBindTexture(GL_TEXTURE_2D, this->textureSlots[size_t(tile.slot)].texture);
+      } else {
+        const uint32_t *pixels;
+        if (tile.state == TileState::Compressed) {
+          this->readbackTilePixels.resize(size_t(tile.width) * tile.height);
+          decompressPixels(tile.compressed, this->readbackTilePixels.data(), this->readbackTilePixels.size());
+          pixels = this->readbackTilePixels.data();
+        } else {
+          pixels = this->tilePixels(tile);
+        }
+
+        if (this->readbackTileTexture == 0) {
+          this->readbackTileTexture = createTileTexture();
+        }
+
+        glBindTexture(GL_TEXTURE_2D, this->readbackTileTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile.width, tile.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+      }
+
+      // Edge tiles only fill part of their texture
+      this->shader.setInt("solid", 0);
+      this->shader.setVec2("uvScale", float(tile.width) / CANVAS_TILE_SIZE, float(tile.height) / CANVAS_TILE_SIZE);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// readback reads the pixels of the offscreen frame buffer
+std::vector<uint32_t> Canvas::readback() {
+  std::vector<uint32_t> result(size_t(this->readbackWidth) * this->readbackHeight);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, this->readbackFBO);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, this->readbackWidth, this->readbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, result.data());
+
+  return result;
+}
+
+// commitReadbackRegion copies a rectangle of the canvas' pixels from the
+// offscreen frame buffer into the canvas, making what was rendered there part
+// of the canvas. The rectangle must lie within the bound region.
+void Canvas::commitReadbackRegion(int x, int y, int width, int height) {
+  if (width <= 0 || height <= 0)
+    return;
+
+  std::vector<uint32_t> region(size_t(width) * height);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, this->readbackFBO);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(x - this->readbackX, y - this->readbackY, width, height, GL_RGBA, GL_UNSIGNED_BYTE, region.data());
+
+  // Copy the region into each tile it overlaps. Tiles it covers entirely are
+  // overwritten without decompressing them first.
+  for (int ty = y / CANVAS_TILE_SIZE; ty <= (y + height - 1) / CANVAS_TILE_SIZE; ty++) {
+    for (int tx = x / CANVAS_TILE_SIZE; tx <= (x + width - 1) / CANVAS_TILE_SIZE; tx++) {
+      Tile &tile = this->tiles[(size_t(ty) * this->numTilesX) + tx];
+
+      int x0 = std::max(x, tile.x), x1 = std::min(x + width, tile.x + tile.width);
+      int y0 = std::max(y, tile.y), y1 = std::min(y + height, tile.y + tile.height);
+
+      if (x1 - x0 == tile.width && y1 - y0 == tile.height) {
+        this->markReplaced(tile);
+      } else {
+        this->markEdited(tile);
+      }
+
+      uint32_t *pixels = this->tilePixels(tile);
+      for (int row = y0; row < y1; row++) {
+        std::memcpy(pixels + (size_t(row - tile.y) * tile.width) + (x0 - tile.x),
+                    region.data() + (size_t(row - y) * width) + (x0 - x), size_t(x1 - x0) * sizeof(uint32_t));
+      }
+    }
+  }
+}
+
+// clear resets every pixel to the background color
+void Canvas::clear() {
+  for (Tile &tile : this->tiles) {
+    this->releaseSlot(tile);
+
+    tile.state = TileState::Empty;
+    tile.color = CANVAS_BACKGROUND_COLOR;
+    tile.dirty = false;
+    tile.average = CANVAS_BACKGROUND_COLOR;
+    tile.averageStale = false;
+    std::vector<uint8_t>().swap(tile.compressed);
+    std::vector<uint32_t>().swap(tile.pixels);
+  }
+
+  this->residentTiles.clear();
+
+#if defined(CANVAS_MAPPED_TILES) && defined(MADV_REMOVE)
+  // Punch the tile file back into a hole where the platform can. Elsewhere the
+  // stale pixels stay on disk, but they're never read since every tile is empty.
+  if (this->mapping != nullptr) {
+    madvise(this->mapping, this->mappingBytes, MADV_REMOVE);
+  }
+#endif
+}
+
+// stats describes how the canvas' tiles are stored
+CanvasStats Canvas::stats() const {
+  CanvasStats stats{0, 0, 0, 0, 0, 0, 0, 0, this->textureSlots.size()};
+
+  for (const Tile &tile : this->tiles) {
+    switch (tile.state) {
+    case TileState::Empty:
+      stats.numEmpty++;
+      break;
+    case TileState::Uniform:
+      stats.numUniform++;
+      break;
+    case TileState::Compressed:
+      stats.numCompressed++;
+      stats.compressedBytes += tile.compressed.capacity();
+      break;
+    case TileState::Resident:
+      stats.numResident++;
+      stats.residentBytes += tile.pixels.capacity() * sizeof(uint32_t);
+      break;
+    case TileState::Mapped:
+      stats.numMapped++;
+      stats.mappedBytes += CANVAS_TILE_PIXELS * sizeof(uint32_t);
+      break;
+    }
+  }
+
+  return stats;
+}
+
+// gpuBytes returns the number of bytes the canvas' textures occupy on the GPU
+size_t Canvas::gpuBytes() const {
+  size_t bytes = this->textureSlots.size() * CANVAS_TILE_PIXELS * 4;
+
+  if (this->readbackFBO != 0) {
+    bytes += size_t(this->readbackTextureWidth) * this->readbackTextureHeight * 4;
+  }
+
+  if (this->readbackTileTexture != 0) {
+    bytes += CANVAS_TILE_PIXELS * 4;
+  }
+
+  return bytes;
+}
+
+// cpuBytes returns the number of bytes the canvas' tiles occupy on the heap.
+// Mapped tiles are paged by the OS and aren't counted.
+size_t Canvas::cpuBytes() const {
+  size_t bytes = (this->tiles.capacity() * sizeof(Tile)) + (this->textureSlots.capacity() * sizeof(TextureSlot));
+  for (const Tile &tile : this->tiles) {
+    bytes += tile.compressed.capacity() + (tile.pixels.capacity() * sizeof(uint32_t));
+  }
+
+  return bytes;
+}
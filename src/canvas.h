@@ -0,0 +1,273 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+#include "drawable.h"
+#include "flood_fill.h"
+#include "rect.h"
+#include "shader.h"
+#include "thread_pool.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+// Large canvases keep their tiles in a memory mapped file. The web build has
+// no file to map, so its tiles are always held in memory.
+#define CANVAS_MAPPED_TILES
+#endif
+
+// The color of a blank canvas, as packed RGBA8
+const uint32_t CANVAS_BACKGROUND_COLOR = 0xFFFFFFFF;
+
+// The width and height of a canvas tile in pixels
+const int CANVAS_TILE_SIZE = 256;
+
+// The most tile textures kept on the GPU at once
+const size_t CANVAS_TEXTURE_CACHE_SIZE = 512;
+
+// Canvases whose pixels would take more bytes than this are backed by a
+// memory mapped tile file, e.g. a 32768x32768 poster
+const size_t CANVAS_MAPPED_MIN_BYTES = size_t(256) * 1024 * 1024;
+
+// The largest region along each side which is rendered offscreen at once
+const int CANVAS_MAX_READBACK_SIZE = 4096;
+
+// CanvasStats describes how the canvas' tiles are stored
+struct CanvasStats {
+  size_t numEmpty;
+  size_t numUniform;
+  size_t numCompressed;
+  size_t numResident;
+  size_t numMapped;
+
+  // The bytes held by resident tiles on the heap
+  size_t residentBytes;
+
+  // The bytes held by compressed tiles
+  size_t compressedBytes;
+
+  // The bytes of the tile file in use by mapped tiles
+  size_t mappedBytes;
+
+  // The tile textures cached on the GPU
+  size_t numTextures;
+};
+
+// Canvas is the persistent raster layer drawn beneath the bottom layer's
+// strokes. It holds pixels which are not stroke geometry, such as bucket fills.
+// Pixels are packed RGBA8 and stored bottom row first, matching OpenGL.
+// One canvas pixel covers one canvas space unit, starting at the origin.
+//
+// Canvases are mostly background, so pixels are stored sparsely in tiles.
+// Empty tiles store nothing and tiles of a single color store only that color.
+// Other tiles are resident, with their pixels on the heap, only while they are
+// in view or being edited. Tiles which have been out of view for a while are
+// run-length compressed, and decompressed once they are next needed.
+//
+// Canvases too large for memory are virtual: the pixels of their tiles live in
+// a sparse memory mapped tile file instead, and the OS pages them in and out.
+// As the view moves, a background thread asks the OS to page in the tiles
+// around it before they are drawn.
+//
+// Either way, only the tiles being drawn have textures. Textures are kept in a
+// fixed size cache and the least recently drawn tile's texture is reused once
+// it is full. Tiles drawn smaller than a few pixels are drawn in their average
+// color instead, so zooming out over a huge canvas uploads nothing.
+class Canvas : public Drawable {
+public:
+  // Canvas creates a blank canvas of the given size in pixels. Canvases larger
+  // than CANVAS_MAPPED_MIN_BYTES keep their tiles in a file created at tilePath.
+  Canvas(int width, int height, Shader &shader, const std::string &tilePath);
+  ~Canvas();
+
+  Canvas(const Canvas &) = delete;
+  Canvas &operator=(const Canvas &) = delete;
+
+  // draws the whole canvas to the screen
+  virtual void draw();
+
+  // drawRegion draws the tiles of the canvas which intersect a region of
+  // canvas space at the given zoom, then compresses resident tiles which have
+  // gone unused
+  void drawRegion(const Rect &visible, float zoom);
+
+  // prefetch asks for the tiles around a region of canvas space to be paged in
+  // ahead of being drawn. Only virtual canvases page their tiles.
+  void prefetch(const Rect &region);
+
+  // isVirtual indicates whether the canvas' tiles live in a memory mapped file
+  bool isVirtual() const;
+
+  // fillSpans writes a color over spans of pixels, such as those of a fill
+  // result. The spans are offset by the position of the region they were found in.
+  void fillSpans(const std::vector<FillSpan> &spans, int offsetX, int offsetY, uint32_t color, ThreadPool &pool);
+
+  // bindReadbackTarget binds an offscreen frame buffer covering a region of the
+  // canvas' pixels, so the scene can be rendered into it and read back with
+  // readback. The region is at most CANVAS_MAX_READBACK_SIZE along each side.
+  void bindReadbackTarget(int x, int y, int width, int height);
+
+  // releaseReadbackTarget releases the offscreen frame buffer until it is next bound
+  void releaseReadbackTarget();
+
+  // drawReadbackRegion draws the tiles of the canvas which intersect the region
+  // the offscreen frame buffer covers, without taking textures from the cache
+  // or leaving the tiles it touched resident
+  void drawReadbackRegion();
+
+  // readback reads the pixels of the offscreen frame buffer
+  std::vector<uint32_t> readback();
+
+  // commitReadbackRegion copies a rectangle of the canvas' pixels from the
+  // offscreen frame buffer into the canvas, making what was rendered there part
+  // of the canvas. The rectangle must lie within the bound region.
+  void commitReadbackRegion(int x, int y, int width, int height);
+
+  // clear resets every pixel to the background color
+  void clear();
+
+  // stats describes how the canvas' tiles are stored
+  CanvasStats stats() const;
+
+  // gpuBytes returns the number of bytes the canvas' textures occupy on the GPU
+  size_t gpuBytes() const;
+
+  // cpuBytes returns the number of bytes the canvas' tiles occupy on the heap.
+  // Mapped tiles are paged by the OS and aren't counted.
+  size_t cpuBytes() const;
+
+  // The size of the canvas in pixels
+  int width, height;
+
+private:
+  // TileState describes how a tile's pixels are stored
+  enum class TileState {
+    // Every pixel is the background color
+    Empty,
+    // Every pixel is the tile's color
+    Uniform,
+    // The pixels are run-length compressed
+    Compressed,
+    // The pixels are held uncompressed on the heap
+    Resident,
+    // The pixels are held uncompressed in the tile file
+    Mapped,
+  };
+
+  // Tile is a square region of the canvas
+  struct Tile {
+    // The position of the tile's bottom left pixel and its size in pixels
+    int x, y;
+    int width, height;
+
+    TileState state;
+    uint32_t color;
+    std::vector<uint8_t> compressed;
+    std::vector<uint32_t> pixels;
+
+    // The tile's slot in the texture cache or -1, and whether its pixels have
+    // changed since they were uploaded
+    int slot;
+    bool dirty;
+
+    // The average color of the tile's pixels, drawn when it is zoomed far out
+    uint32_t average;
+    bool averageStale;
+
+    // The draw the tile was last used by
+    uint64_t lastUsed;
+  };
+
+  std::vector<Tile> tiles;
+  int numTilesX, numTilesY;
+
+  // The indices of the resident tiles
+  std::vector<size_t> residentTiles;
+
+  // TextureSlot is a tile sized texture in the texture cache
+  struct TextureSlot {
+    unsigned int texture;
+    // The index of the tile whose pixels it holds, or SIZE_MAX if it is free
+    size_t tile;
+    // The draw the slot was last used by
+    uint64_t lastUsed;
+  };
+
+  std::vector<TextureSlot> textureSlots;
+
+  // The tile file's mapping, with a tile sized slot per tile, or null when
+  // tiles are held in memory
+  uint32_t *mapping;
+  size_t mappingBytes;
+  int tileFile;
+  std::string tilePath;
+
+  // The prefetch thread and the range of tiles it was last asked to page in
+  std::thread prefetcher;
+  std::mutex prefetchMutex;
+  std::condition_variable prefetchCondition;
+  int prefetchRange[4];
+  bool prefetchPending;
+  bool stopping;
+
+  // The number of times the canvas has been drawn
+  uint64_t numDraws;
+
+  // Shader internals
+  Shader &shader;
+  unsigned int VBO, VAO;
+
+  // The offscreen frame buffer used to read back the scene, created once
+  // needed, and the region of the canvas it covers. Its texture only grows, so
+  // read backs of different sizes share it.
+  unsigned int readbackFBO, readbackTexture;
+  int readbackX, readbackY, readbackWidth, readbackHeight;
+  int readbackTextureWidth, readbackTextureHeight;
+
+  // The texture tiles without a cached texture are uploaded through while
+  // reading back, and the pixels of compressed tiles decompressed for it
+  unsigned int readbackTileTexture;
+  std::vector<uint32_t> readbackTilePixels;
+
+  // makeResident decompresses a tile's pixels, or gives it a slot in the tile
+  // file, so they can be drawn or edited
+  void makeResident(Tile &tile);
+
+  // tilePixels returns the pixels of a resident or mapped tile, stored row by row
+  uint32_t *tilePixels(Tile &tile);
+
+  // compress stores a resident tile's pixels in the smallest form which holds them
+  void compress(Tile &tile);
+
+  // drawTile draws a tile, uploading its pixels first if they have changed
+  void drawTile(Tile &tile, bool zoomedOut);
+
+  // drawSolid draws a tile in a single color
+  void drawSolid(uint32_t color);
+
+  // acquireSlot finds a texture for a tile, reusing the least recently drawn
+  // tile's texture once the cache is full. It returns -1 if every texture has
+  // been drawn by the current draw.
+  int acquireSlot(size_t tile);
+
+  // releaseSlot returns a tile's texture to the cache
+  void releaseSlot(Tile &tile);
+
+  // markReplaced marks a tile whose every pixel is about to be overwritten, so
+  // its old pixels needn't be decompressed first
+  void markReplaced(Tile &tile);
+
+  // markEdited marks a tile whose pixels are about to change
+  void markEdited(Tile &tile);
+
+  // prefetchLoop pages in the tiles around the view on the prefetch thread
+  void prefetchLoop();
+
+  // compressIdleTiles compresses resident tiles which have gone unused
+  void compressIdleTiles();
+};
+
+#endif // CANVAS_H
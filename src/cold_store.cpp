@@ -0,0 +1,99 @@
+#include "cold_store.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// ColdStore creates an empty store at path, replacing any previous one
+ColdStore::ColdStore(const std::string &path) : path(path), length(0) {
+  this->fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (this->fd < 0) {
+    throw std::runtime_error("failed to open cold store: " + path);
+  }
+}
+
+// Closes and removes the store's file
+ColdStore::~ColdStore() {
+  close(this->fd);
+  unlink(this->path.c_str());
+}
+
+// put stores a batch of strokes as a new block and returns the block's index
+uint32_t ColdStore::put(const std::vector<DocumentStroke> &strokes) {
+  std::vector<uint8_t> raw;
+  for (const DocumentStroke &stroke : strokes) {
+    encodeStroke(raw, stroke);
+  }
+
+  uLongf deflatedSize = compressBound(uLong(raw.size()));
+  std::vector<uint8_t> deflated(deflatedSize);
+  if (compress2(deflated.data(), &deflatedSize, raw.data(), uLong(raw.size()), Z_BEST_SPEED) != Z_OK) {
+    throw std::runtime_error("failed to compress cold store block");
+  }
+
+  size_t written = 0;
+  while (written < deflatedSize) {
+    ssize_t result = pwrite(this->fd, deflated.data() + written, deflatedSize - written, off_t(this->length + written));
+    if (result < 0) {
+      throw std::runtime_error("failed to write cold store: " + this->path);
+    }
+    written += size_t(result);
+  }
+
+  this->blocks.push_back(Block{this->length, uint32_t(deflatedSize), uint32_t(raw.size()), uint32_t(strokes.size())});
+  this->length += deflatedSize;
+
+  return uint32_t(this->blocks.size() - 1);
+}
+
+// get reads a block back, calling onStroke with each of its strokes in turn
+void ColdStore::get(uint32_t block,
+                    const std::function<void(uint32_t id, float radius, const Symmetry &symmetry,
+                                             std::vector<glm::vec2> &samples)> &onStroke) {
+  if (block >= this->blocks.size()) {
+    throw std::runtime_error("cold store block is out of range");
+  }
+  const Block &location = this->blocks[block];
+
+  std::vector<uint8_t> deflated(location.size);
+  size_t read = 0;
+  while (read < location.size) {
+    ssize_t result = pread(this->fd, deflated.data() + read, location.size - read, off_t(location.offset + read));
+    if (result <= 0) {
+      throw std::runtime_error("failed to read cold store: " + this->path);
+    }
+    read += size_t(result);
+  }
+
+  uLongf rawSize = location.rawSize;
+  std::vector<uint8_t> raw(rawSize);
+  if (uncompress(raw.data(), &rawSize, deflated.data(), uLong(deflated.size())) != Z_OK || rawSize != location.rawSize) {
+    throw std::runtime_error("cold store block is corrupt");
+  }
+
+  const uint8_t *data = raw.data();
+  const uint8_t *end = raw.data() + raw.size();
+
+  uint32_t id;
+  float radius;
+  Symmetry symmetry;
+  std::vector<glm::vec2> samples;
+  for (uint32_t i = 0; i < location.numStrokes; i++) {
+    decodeStroke(data, end, DOCUMENT_VERSION, id, radius, symmetry, samples);
+    onStroke(id, radius, symmetry, samples);
+  }
+}
+
+// clear discards every block
+void ColdStore::clear() {
+  if (ftruncate(this->fd, 0) != 0) {
+    throw std::runtime_error("failed to truncate cold store: " + this->path);
+  }
+
+  this->blocks.clear();
+  this->length = 0;
+}
+
+// size returns the number of bytes the store occupies on disk
+size_t ColdStore::size() const { return size_t(this->length); }
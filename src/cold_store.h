@@ -0,0 +1,53 @@
+#ifndef COLD_STORE_H
+#define COLD_STORE_H
+#include "document.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// ColdStore keeps the vector data of strokes which are no longer drawn as
+// geometry in a scratch file, so it doesn't occupy memory. Strokes are put in
+// batches, each stored as one block of the document stroke encoding deflated
+// with zlib. The file only lives for the session; the document and journal
+// remain the source of truth for the drawing.
+class ColdStore {
+public:
+  // ColdStore creates an empty store at path, replacing any previous one
+  explicit ColdStore(const std::string &path);
+  ~ColdStore();
+
+  ColdStore(const ColdStore &) = delete;
+  ColdStore &operator=(const ColdStore &) = delete;
+
+  // put stores a batch of strokes as a new block and returns the block's index
+  uint32_t put(const std::vector<DocumentStroke> &strokes);
+
+  // get reads a block back, calling onStroke with each of its strokes in turn
+  void get(uint32_t block,
+           const std::function<void(uint32_t id, float radius, const Symmetry &symmetry,
+                                    std::vector<glm::vec2> &samples)> &onStroke);
+
+  // clear discards every block
+  void clear();
+
+  // size returns the number of bytes the store occupies on disk
+  size_t size() const;
+
+private:
+  // Block is the location of a deflated block within the file
+  struct Block {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t rawSize;
+    uint32_t numStrokes;
+  };
+
+  std::string path;
+  int fd;
+  uint64_t length;
+  std::vector<Block> blocks;
+};
+
+#endif // COLD_STORE_H
@@ -0,0 +1,491 @@
+#include "document.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char DOCUMENT_MAGIC[6] = {'D', 'R', 'A', 'W', 'W', 'W'};
+const char DOCUMENT_INDEX_MAGIC[4] = {'D', 'I', 'D', 'X'};
+const size_t DOCUMENT_HEADER_SIZE = 8;
+const size_t DOCUMENT_SPRAYS_SIZE_SIZE = 4;
+const size_t DOCUMENT_INDEX_ENTRY_SIZE = 36;
+const size_t DOCUMENT_FOOTER_SIZE = 16;
+
+// Positions are stored in fixed point with this many steps per pixel
+const float DOCUMENT_QUANTIZATION = 16.0f;
+
+// A chunk is closed once it grows past this many bytes
+const size_t DOCUMENT_CHUNK_SIZE = 64 * 1024;
+
+/**
+  Encoding helpers
+*/
+
+static void putU16(std::vector<uint8_t> &out, uint16_t value) {
+  out.push_back(uint8_t(value));
+  out.push_back(uint8_t(value >> 8));
+}
+
+static void putU32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out.push_back(uint8_t(value >> (8 * i)));
+  }
+}
+
+static void putU64(std::vector<uint8_t> &out, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    out.push_back(uint8_t(value >> (8 * i)));
+  }
+}
+
+static void putF32(std::vector<uint8_t> &out, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putU32(out, bits);
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(uint8_t(value));
+}
+
+// zigzag maps signed integers to unsigned ones so small magnitudes of either
+// sign encode into few varint bytes
+static uint64_t zigzag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+
+static int64_t unzigzag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+
+static int64_t quantize(float value) { return int64_t(std::llround(double(value) * DOCUMENT_QUANTIZATION)); }
+
+/**
+  Decoding helpers
+*/
+
+static uint16_t getU16(const uint8_t *data) { return uint16_t(data[0] | (data[1] << 8)); }
+
+static uint32_t getU32(const uint8_t *data) {
+  return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+static uint64_t getU64(const uint8_t *data) { return uint64_t(getU32(data)) | (uint64_t(getU32(data + 4)) << 32); }
+
+static float getF32(const uint8_t *data) {
+  uint32_t bits = getU32(data);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static uint64_t getVarint(const uint8_t *&data, const uint8_t *end) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (data >= end) {
+      throw std::runtime_error("truncated document chunk");
+    }
+
+    uint8_t byte = *data++;
+    value |= uint64_t(byte & 0x7F) << shift;
+
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+
+  throw std::runtime_error("malformed varint in document chunk");
+}
+
+// encodeStroke appends a stroke in the document stroke encoding to out
+void encodeStroke(std::vector<uint8_t> &out, const DocumentStroke &stroke) {
+  const std::vector<glm::vec2> &samples = *stroke.samples;
+
+  putVarint(out, stroke.id);
+  putVarint(out, samples.size());
+  putVarint(out, uint64_t(std::max<int64_t>(quantize(stroke.radius), 0)));
+
+  putVarint(out, uint64_t(stroke.symmetry.mode));
+  if (stroke.symmetry.mode != SymmetryMode::None) {
+    putVarint(out, uint64_t(std::max(stroke.symmetry.ways, 1)));
+    putVarint(out, zigzag(quantize(stroke.symmetry.center.x)));
+    putVarint(out, zigzag(quantize(stroke.symmetry.center.y)));
+  }
+
+  int64_t lastX = 0, lastY = 0;
+  for (const glm::vec2 &sample : samples) {
+    int64_t x = quantize(sample.x);
+    int64_t y = quantize(sample.y);
+
+    putVarint(out, zigzag(x - lastX));
+    putVarint(out, zigzag(y - lastY));
+
+    lastX = x;
+    lastY = y;
+  }
+}
+
+// decodeStroke decodes a stroke in the stroke encoding of the given document
+// version starting at data, resizing samples in place, and advances data past
+// it. Strokes from versions which predate stroke IDs are given an ID of 0.
+void decodeStroke(const uint8_t *&data, const uint8_t *end, uint16_t version, uint32_t &id, float &radius,
+                  Symmetry &symmetry, std::vector<glm::vec2> &samples) {
+  id = version >= DOCUMENT_VERSION_STROKE_IDS ? uint32_t(getVarint(data, end)) : 0;
+  uint64_t numSamples = getVarint(data, end);
+
+  // Every sample takes at least two bytes
+  if (numSamples > uint64_t(end - data) / 2) {
+    throw std::runtime_error("document stroke is larger than its chunk");
+  }
+
+  radius = float(getVarint(data, end)) / DOCUMENT_QUANTIZATION;
+
+  symmetry = Symmetry{SymmetryMode::None, 1, glm::vec2{0.0f, 0.0f}};
+  if (version >= DOCUMENT_VERSION_SYMMETRY) {
+    uint64_t mode = getVarint(data, end);
+    if (mode >= uint64_t(SYMMETRY_MODE_COUNT)) {
+      throw std::runtime_error("unknown symmetry in document stroke");
+    }
+
+    symmetry.mode = SymmetryMode(mode);
+    if (symmetry.mode != SymmetryMode::None) {
+      symmetry.ways = int(std::min<uint64_t>(getVarint(data, end), uint64_t(SYMMETRY_MAX_COPIES)));
+      int64_t x = unzigzag(getVarint(data, end));
+      int64_t y = unzigzag(getVarint(data, end));
+      symmetry.center = glm::vec2{float(x) / DOCUMENT_QUANTIZATION, float(y) / DOCUMENT_QUANTIZATION};
+    }
+  }
+
+  samples.resize(size_t(numSamples));
+
+  int64_t x = 0, y = 0;
+  for (glm::vec2 &sample : samples) {
+    x += unzigzag(getVarint(data, end));
+    y += unzigzag(getVarint(data, end));
+
+    sample = glm::vec2{float(x) / DOCUMENT_QUANTIZATION, float(y) / DOCUMENT_QUANTIZATION};
+  }
+}
+
+// encodeSpray appends a spray in the document spray encoding to out
+void encodeSpray(std::vector<uint8_t> &out, const DocumentSpray &spray) {
+  const std::vector<SprayBurst> &bursts = *spray.bursts;
+
+  putVarint(out, spray.id);
+  putVarint(out, spray.color);
+  putVarint(out, bursts.size());
+
+  int64_t lastX = 0, lastY = 0;
+  int64_t lastSeed = 0;
+  for (const SprayBurst &burst : bursts) {
+    int64_t x = quantize(burst.center.x);
+    int64_t y = quantize(burst.center.y);
+
+    putVarint(out, zigzag(x - lastX));
+    putVarint(out, zigzag(y - lastY));
+    putVarint(out, uint64_t(std::max<int64_t>(quantize(burst.radius), 0)));
+    putVarint(out, uint64_t(std::max(burst.numParticles, 0.0f)));
+    putVarint(out, zigzag(int64_t(burst.seed) - lastSeed));
+
+    lastX = x;
+    lastY = y;
+    lastSeed = int64_t(burst.seed);
+  }
+}
+
+// decodeSpray decodes a spray in the document spray encoding starting at
+// data, resizing bursts in place, and advances data past it
+void decodeSpray(const uint8_t *&data, const uint8_t *end, uint32_t &id, uint32_t &color,
+                 std::vector<SprayBurst> &bursts) {
+  id = uint32_t(getVarint(data, end));
+  color = uint32_t(getVarint(data, end));
+  uint64_t numBursts = getVarint(data, end);
+
+  // Every burst takes at least five bytes
+  if (numBursts > uint64_t(end - data) / 5) {
+    throw std::runtime_error("document spray is larger than its section");
+  }
+
+  bursts.resize(size_t(numBursts));
+
+  int64_t x = 0, y = 0, seed = 0;
+  for (SprayBurst &burst : bursts) {
+    x += unzigzag(getVarint(data, end));
+    y += unzigzag(getVarint(data, end));
+    burst.center = glm::vec2{float(x) / DOCUMENT_QUANTIZATION, float(y) / DOCUMENT_QUANTIZATION};
+    burst.radius = float(getVarint(data, end)) / DOCUMENT_QUANTIZATION;
+    burst.numParticles = float(getVarint(data, end));
+
+    seed += unzigzag(getVarint(data, end));
+    burst.seed = uint32_t(seed);
+  }
+}
+
+// encodeDocument encodes strokes and sprays into the bytes of a document
+std::vector<uint8_t> encodeDocument(const std::vector<DocumentStroke> &strokes,
+                                    const std::vector<DocumentSpray> &sprays) {
+  std::vector<uint8_t> out;
+  out.insert(out.end(), DOCUMENT_MAGIC, DOCUMENT_MAGIC + sizeof(DOCUMENT_MAGIC));
+  putU16(out, DOCUMENT_VERSION);
+
+  // Write the sprays section, prefixed with its size
+  std::vector<uint8_t> spraySection;
+  uint32_t numSprays = 0;
+  for (const DocumentSpray &spray : sprays) {
+    if (!spray.bursts->empty()) {
+      numSprays += 1;
+    }
+  }
+
+  putVarint(spraySection, numSprays);
+  for (const DocumentSpray &spray : sprays) {
+    if (!spray.bursts->empty()) {
+      encodeSpray(spraySection, spray);
+    }
+  }
+
+  putU32(out, uint32_t(spraySection.size()));
+  out.insert(out.end(), spraySection.begin(), spraySection.end());
+
+  std::vector<DocumentChunk> index;
+  DocumentChunk chunk{out.size(), 0, 0, 0, Rect::empty()};
+
+  // closeChunk adds the current chunk to the index if it holds any strokes
+  auto closeChunk = [&out, &index, &chunk]() {
+    if (chunk.numStrokes == 0)
+      return;
+
+    chunk.size = uint32_t(out.size() - chunk.offset);
+    index.push_back(chunk);
+    chunk = DocumentChunk{out.size(), 0, 0, 0, Rect::empty()};
+  };
+
+  for (const DocumentStroke &stroke : strokes) {
+    const std::vector<glm::vec2> &samples = *stroke.samples;
+    if (samples.empty())
+      continue;
+
+    encodeStroke(out, stroke);
+
+    // Chunk bounds cover the copies the stroke's symmetry draws
+    Rect bounds = Rect::empty();
+    for (const glm::vec2 &sample : samples) {
+      bounds.expand(sample);
+    }
+    chunk.bounds.expand(stroke.symmetry.bounds(bounds));
+
+    chunk.numStrokes += 1;
+    chunk.numSamples += uint32_t(samples.size());
+
+    if (out.size() - chunk.offset >= DOCUMENT_CHUNK_SIZE) {
+      closeChunk();
+    }
+  }
+  closeChunk();
+
+  // Write the chunk index and footer
+  uint64_t indexOffset = out.size();
+  for (const DocumentChunk &entry : index) {
+    putU64(out, entry.offset);
+    putU32(out, entry.size);
+    putU32(out, entry.numStrokes);
+    putU32(out, entry.numSamples);
+    putF32(out, entry.bounds.min.x);
+    putF32(out, entry.bounds.min.y);
+    putF32(out, entry.bounds.max.x);
+    putF32(out, entry.bounds.max.y);
+  }
+
+  putU64(out, indexOffset);
+  putU32(out, uint32_t(index.size()));
+  out.insert(out.end(), DOCUMENT_INDEX_MAGIC, DOCUMENT_INDEX_MAGIC + sizeof(DOCUMENT_INDEX_MAGIC));
+
+  return out;
+}
+
+// saveDocument encodes strokes and sprays and writes them to a document file.
+// The document is written to a temporary file which then replaces the
+// destination, so a failed save never leaves a partially written document.
+void saveDocument(const char *path, const std::vector<DocumentStroke> &strokes,
+                  const std::vector<DocumentSpray> &sprays) {
+  std::vector<uint8_t> bytes = encodeDocument(strokes, sprays);
+
+  std::string tempPath = std::string(path) + ".tmp";
+  FILE *file = fopen(tempPath.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("failed to open document for writing: " + tempPath);
+  }
+
+  size_t written = fwrite(bytes.data(), 1, bytes.size(), file);
+  bool flushed = fflush(file) == 0 && fsync(fileno(file)) == 0;
+  fclose(file);
+
+  if (written != bytes.size() || !flushed) {
+    std::remove(tempPath.c_str());
+    throw std::runtime_error("failed to write document: " + tempPath);
+  }
+
+  if (std::rename(tempPath.c_str(), path) != 0) {
+    std::remove(tempPath.c_str());
+    throw std::runtime_error(std::string("failed to replace document: ") + path);
+  }
+}
+
+DocumentChunkReader::DocumentChunkReader(const uint8_t *data, const uint8_t *end, uint32_t numStrokes,
+                                         uint16_t version)
+    : data(data), end(end), remainingStrokes(numStrokes), version(version) {}
+
+// next decodes the next stroke of the chunk into id, radius, symmetry and
+// samples, resizing samples in place. It returns false once every stroke has
+// been read. Strokes from documents which predate stroke IDs are given an ID of 0.
+bool DocumentChunkReader::next(uint32_t &id, float &radius, Symmetry &symmetry, std::vector<glm::vec2> &samples) {
+  if (this->remainingStrokes == 0)
+    return false;
+  this->remainingStrokes -= 1;
+
+  decodeStroke(this->data, this->end, this->version, id, radius, symmetry, samples);
+  return true;
+}
+
+DocumentSprayReader::DocumentSprayReader(const uint8_t *data, const uint8_t *end, uint32_t numSprays)
+    : data(data), end(end), remainingSprays(numSprays) {}
+
+// next decodes the next spray into id, color and bursts, resizing bursts in
+// place. It returns false once every spray has been read.
+bool DocumentSprayReader::next(uint32_t &id, uint32_t &color, std::vector<SprayBurst> &bursts) {
+  if (this->remainingSprays == 0)
+    return false;
+  this->remainingSprays -= 1;
+
+  decodeSpray(this->data, this->end, id, color, bursts);
+  return true;
+}
+
+// DocumentReader maps and validates the document at the given path
+DocumentReader::DocumentReader(const char *path)
+    : data(nullptr), length(0), version(0), spraysStart(nullptr), spraysEnd(nullptr), numSprays(0) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("failed to open document: ") + path);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || size_t(info.st_size) < DOCUMENT_HEADER_SIZE + DOCUMENT_FOOTER_SIZE) {
+    close(fd);
+    throw std::runtime_error(std::string("document is too small: ") + path);
+  }
+
+  this->length = size_t(info.st_size);
+  void *mapped = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error(std::string("failed to map document: ") + path);
+  }
+  this->data = static_cast<const uint8_t *>(mapped);
+
+  // The chunks are read front to back
+  madvise(mapped, this->length, MADV_SEQUENTIAL);
+
+  try {
+    if (std::memcmp(this->data, DOCUMENT_MAGIC, sizeof(DOCUMENT_MAGIC)) != 0) {
+      throw std::runtime_error("not a drawww document");
+    }
+
+    this->version = getU16(this->data + sizeof(DOCUMENT_MAGIC));
+    if (this->version == 0 || this->version > DOCUMENT_VERSION) {
+      throw std::runtime_error("unsupported drawww document version");
+    }
+
+    const uint8_t *footer = this->data + this->length - DOCUMENT_FOOTER_SIZE;
+    if (std::memcmp(footer + 12, DOCUMENT_INDEX_MAGIC, sizeof(DOCUMENT_INDEX_MAGIC)) != 0) {
+      throw std::runtime_error("document chunk index is missing");
+    }
+
+    // Chunks start after the sprays section, if the document has one
+    size_t chunksOffset = DOCUMENT_HEADER_SIZE;
+    if (this->version >= DOCUMENT_VERSION_SPRAYS) {
+      if (this->length < DOCUMENT_HEADER_SIZE + DOCUMENT_SPRAYS_SIZE_SIZE + DOCUMENT_FOOTER_SIZE) {
+        throw std::runtime_error("document sprays are missing");
+      }
+
+      uint64_t spraysSize = getU32(this->data + DOCUMENT_HEADER_SIZE);
+      chunksOffset = DOCUMENT_HEADER_SIZE + DOCUMENT_SPRAYS_SIZE_SIZE;
+      if (spraysSize > this->length - DOCUMENT_FOOTER_SIZE - chunksOffset) {
+        throw std::runtime_error("document sprays are out of bounds");
+      }
+
+      this->spraysStart = this->data + chunksOffset;
+      this->spraysEnd = this->spraysStart + spraysSize;
+      this->numSprays = uint32_t(getVarint(this->spraysStart, this->spraysEnd));
+      chunksOffset += size_t(spraysSize);
+    }
+
+    uint64_t indexOffset = getU64(footer);
+    uint32_t numChunks = getU32(footer + 8);
+    if (indexOffset + (uint64_t(numChunks) * DOCUMENT_INDEX_ENTRY_SIZE) != this->length - DOCUMENT_FOOTER_SIZE) {
+      throw std::runtime_error("document chunk index is corrupt");
+    }
+
+    this->index.reserve(numChunks);
+    for (uint32_t i = 0; i < numChunks; i++) {
+      const uint8_t *entry = this->data + indexOffset + (size_t(i) * DOCUMENT_INDEX_ENTRY_SIZE);
+
+      DocumentChunk chunk;
+      chunk.offset = getU64(entry);
+      chunk.size = getU32(entry + 8);
+      chunk.numStrokes = getU32(entry + 12);
+      chunk.numSamples = getU32(entry + 16);
+      chunk.bounds = Rect{glm::vec2{getF32(entry + 20), getF32(entry + 24)},
+                          glm::vec2{getF32(entry + 28), getF32(entry + 32)}};
+
+      if (chunk.offset < chunksOffset || chunk.offset + chunk.size > indexOffset) {
+        throw std::runtime_error("document chunk is out of bounds");
+      }
+
+      this->index.push_back(chunk);
+    }
+  } catch (...) {
+    munmap(mapped, this->length);
+    throw;
+  }
+}
+
+// Unmaps the document
+DocumentReader::~DocumentReader() {
+  if (this->data != nullptr) {
+    munmap(const_cast<uint8_t *>(this->data), this->length);
+  }
+}
+
+// chunks returns the document's chunk index
+const std::vector<DocumentChunk> &DocumentReader::chunks() const { return this->index; }
+
+// readChunk returns a reader over the strokes of a chunk
+DocumentChunkReader DocumentReader::readChunk(size_t chunk) const {
+  const DocumentChunk &entry = this->index[chunk];
+  const uint8_t *start = this->data + entry.offset;
+
+  return DocumentChunkReader(start, start + entry.size, entry.numStrokes, this->version);
+}
+
+// readSprays returns a reader over the document's sprays
+DocumentSprayReader DocumentReader::readSprays() const {
+  return DocumentSprayReader(this->spraysStart, this->spraysEnd, this->numSprays);
+}
+
+// numSamples returns the total number of samples in the document
+size_t DocumentReader::numSamples() const {
+  size_t total = 0;
+  for (const DocumentChunk &chunk : this->index) {
+    total += chunk.numSamples;
+  }
+  return total;
+}
+
+// size returns the size of the document in bytes
+size_t DocumentReader::size() const { return this->length; }
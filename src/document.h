@@ -0,0 +1,175 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+#include "rect.h"
+#include "spray_burst.h"
+#include "symmetry.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The file extension of drawww documents
+const char *const DOCUMENT_EXTENSION = ".drawww";
+
+// The version documents are saved as, and strokes are encoded as
+const uint16_t DOCUMENT_VERSION = 4;
+
+// The first version which stores stroke IDs
+const uint16_t DOCUMENT_VERSION_STROKE_IDS = 2;
+
+// The first version which stores sprays
+const uint16_t DOCUMENT_VERSION_SPRAYS = 3;
+
+// The first version which stores the symmetry strokes are drawn with
+const uint16_t DOCUMENT_VERSION_SYMMETRY = 4;
+
+/**
+  A .drawww document stores the strokes and sprays of a drawing. All integers
+  are little-endian.
+
+    header : "DRAWWW" magic, u16 version
+    sprays : u32 size of the section, varint spray count, sprays
+    chunks : consecutive stroke chunks
+    index  : one entry per chunk - u64 offset, u32 size, u32 strokes,
+             u32 samples, f32 minX, minY, maxX, maxY
+    footer : u64 index offset, u32 chunk count, "DIDX" magic
+
+  Each stroke in a chunk is a varint stroke ID, a varint sample count, a
+  varint radius and its symmetry, followed by its samples quantised to 1/16th of a pixel. The first sample is stored as
+  absolute coordinates and the rest as deltas from the previous sample, all
+  zigzag varint encoded, so a typical mouse sample packs into 2-4 bytes.
+
+  A symmetry is a varint mode, followed for any mode but none by a varint
+  number of radial ways and the quantised center as zigzag varints. Only the
+  stroke itself is stored; its copies are drawn from the symmetry. Documents
+  before version 4 store no symmetry, and their strokes have none.
+
+  Each spray is a varint spray ID, a varint color and a varint burst count,
+  followed by its bursts: the center as zigzag varint deltas like samples, a
+  varint radius quantised the same way, a varint particle count and a zigzag
+  varint delta from the previous burst's seed. Documents before version 3
+  have no spray section.
+*/
+
+// DocumentStroke is a stroke being saved to a document
+struct DocumentStroke {
+  uint32_t id;
+  float radius;
+  Symmetry symmetry;
+  const std::vector<glm::vec2> *samples;
+};
+
+// encodeStroke appends a stroke in the document stroke encoding to out
+void encodeStroke(std::vector<uint8_t> &out, const DocumentStroke &stroke);
+
+// decodeStroke decodes a stroke in the stroke encoding of the given document
+// version starting at data, resizing samples in place, and advances data past
+// it. Strokes from versions which predate stroke IDs are given an ID of 0.
+void decodeStroke(const uint8_t *&data, const uint8_t *end, uint16_t version, uint32_t &id, float &radius,
+                  Symmetry &symmetry, std::vector<glm::vec2> &samples);
+
+// DocumentSpray is a spray being saved to a document
+struct DocumentSpray {
+  uint32_t id;
+  uint32_t color;
+  const std::vector<SprayBurst> *bursts;
+};
+
+// encodeSpray appends a spray in the document spray encoding to out
+void encodeSpray(std::vector<uint8_t> &out, const DocumentSpray &spray);
+
+// decodeSpray decodes a spray in the document spray encoding starting at
+// data, resizing bursts in place, and advances data past it
+void decodeSpray(const uint8_t *&data, const uint8_t *end, uint32_t &id, uint32_t &color,
+                 std::vector<SprayBurst> &bursts);
+
+// DocumentChunk is an entry of a document's chunk index
+struct DocumentChunk {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t numStrokes;
+  uint32_t numSamples;
+  Rect bounds;
+};
+
+// encodeDocument encodes strokes and sprays into the bytes of a document
+std::vector<uint8_t> encodeDocument(const std::vector<DocumentStroke> &strokes,
+                                    const std::vector<DocumentSpray> &sprays);
+
+// saveDocument encodes strokes and sprays and writes them to a document file
+void saveDocument(const char *path, const std::vector<DocumentStroke> &strokes,
+                  const std::vector<DocumentSpray> &sprays);
+
+// DocumentChunkReader decodes the strokes of a single chunk in order
+class DocumentChunkReader {
+public:
+  DocumentChunkReader(const uint8_t *data, const uint8_t *end, uint32_t numStrokes, uint16_t version);
+
+  // next decodes the next stroke of the chunk into id, radius, symmetry and
+  // samples, resizing samples in place. It returns false once every stroke has
+  // been read. Strokes from documents which predate stroke IDs are given an ID of 0.
+  bool next(uint32_t &id, float &radius, Symmetry &symmetry, std::vector<glm::vec2> &samples);
+
+private:
+  const uint8_t *data;
+  const uint8_t *end;
+  uint32_t remainingStrokes;
+  uint16_t version;
+};
+
+// DocumentSprayReader decodes the sprays of a document in order
+class DocumentSprayReader {
+public:
+  DocumentSprayReader(const uint8_t *data, const uint8_t *end, uint32_t numSprays);
+
+  // next decodes the next spray into id, color and bursts, resizing bursts in
+  // place. It returns false once every spray has been read.
+  bool next(uint32_t &id, uint32_t &color, std::vector<SprayBurst> &bursts);
+
+private:
+  const uint8_t *data;
+  const uint8_t *end;
+  uint32_t remainingSprays;
+};
+
+// DocumentReader memory maps a document file so its chunks can be decoded
+// directly from the page cache, without copying the file into the heap
+class DocumentReader {
+public:
+  // DocumentReader maps and validates the document at the given path
+  explicit DocumentReader(const char *path);
+
+  // Unmaps the document
+  ~DocumentReader();
+
+  DocumentReader(const DocumentReader &) = delete;
+  DocumentReader &operator=(const DocumentReader &) = delete;
+
+  // chunks returns the document's chunk index
+  const std::vector<DocumentChunk> &chunks() const;
+
+  // readChunk returns a reader over the strokes of a chunk
+  DocumentChunkReader readChunk(size_t chunk) const;
+
+  // readSprays returns a reader over the document's sprays
+  DocumentSprayReader readSprays() const;
+
+  // numSamples returns the total number of samples in the document
+  size_t numSamples() const;
+
+  // size returns the size of the document in bytes
+  size_t size() const;
+
+private:
+  const uint8_t *data;
+  size_t length;
+  uint16_t version;
+  std::vector<DocumentChunk> index;
+
+  // The sprays section, after its size and count
+  const uint8_t *spraysStart;
+  const uint8_t *spraysEnd;
+  uint32_t numSprays;
+};
+
+#endif // DOCUMENT_H
@@ -1,11 +1,14 @@
 #include "engine.h"
+#include "document.h"
 #include "drawable.h"
-#include "point.h"
 #include "ray.h"
 #include "utils.h"
 #include <__config>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -22,6 +25,56 @@
 const char *RENDER_CONTEXT_WEB = "web";
 const char *RENDER_CONTEXT_NATIVE = "native";
 
+// The most level of detail builds started per frame, so zooming out over a large
+// drawing spreads the work across frames
+const size_t LOD_BUILDS_PER_FRAME = 256;
+
+// The color, as packed RGBA8 with red in the low byte, the brush, fill, shape
+// and spray tools paint with unless told otherwise: opaque red
+const uint32_t DEFAULT_PAINT_COLOR = 0xFF0000FF;
+
+// The amount the opacity of a layer is changed by per key press
+const float LAYER_OPACITY_STEP = 0.1f;
+
+// The number of copies radial symmetry draws unless told otherwise
+const int SYMMETRY_DEFAULT_WAYS = 6;
+
+// The width in pixels and the color, as packed RGBA8, of the outline drawn
+// around a selection
+const float SELECTION_OUTLINE_WIDTH = 1.0f;
+const uint32_t SELECTION_OUTLINE_COLOR = 0xFF0080FF;
+
+// The shader permutations compiled at startup, so the first frames don't stall
+// on compiling them
+const std::vector<ShaderPermutation> SHADER_MANIFEST = {
+    {ShaderProgram::Stroke, SHADER_INSTANCED | SHADER_ANTIALIASED},
+    {ShaderProgram::Canvas, 0},
+    {ShaderProgram::Shape, 0},
+    {ShaderProgram::Spray, 0},
+    {ShaderProgram::Composite, 0},
+};
+
+// shapeKind returns the kind of shape a tool drags out. It returns false for
+// tools which don't draw shapes.
+static bool shapeKind(Tool tool, ShapeKind &kind) {
+    switch (tool) {
+    case Tool::Line:
+        kind = ShapeKind::Line;
+        return true;
+    case Tool::Rectangle:
+        kind = ShapeKind::Rectangle;
+        return true;
+    case Tool::Ellipse:
+        kind = ShapeKind::Ellipse;
+        return true;
+    case Tool::RoundedRectangle:
+        kind = ShapeKind::RoundedRectangle;
+        return true;
+    default:
+        return false;
+    }
+}
+
 // TODO: these could be defined in a separate file
 #ifdef __EMSCRIPTEN__
 /**
@@ -40,160 +93,1588 @@ void applyEmscriptenCanvasResize(GLFWwindow *window) {
     emscripten_get_element_css_size("#canvas-container", &canvasContainerWidth, &canvasContainerHeight);
     emscripten_set_canvas_element_size("canvas", int(canvasContainerWidth), int(canvasContainerHeight));
 
-    // 2. Set the GLFW window size based on the updated canvas pixel size
-    // This will cause the frame buffer size to be recalculated.
-    glfwSetWindowSize(window, int(canvasContainerWidth), int(canvasContainerHeight));
+    // 2. Set the GLFW window size based on the updated canvas pixel size
+    // This will cause the frame buffer size to be recalculated.
+    glfwSetWindowSize(window, int(canvasContainerWidth), int(canvasContainerHeight));
+
+    // 3. Finally update the viewport with the updated frame buffer size
+    int frameBufferWidth, frameBufferHeight;
+    glfwGetFramebufferSize(window, &frameBufferWidth, &frameBufferHeight);
+
+    glViewport(0, 0, frameBufferWidth, frameBufferHeight);
+}
+
+/**
+ * emscriptenResizeCallback handles the HTML window being resized
+ */
+bool emscriptenResizeCallback(int eventType, const EmscriptenUiEvent *uiEvent, void *userData) {
+    GLFWwindow *window = reinterpret_cast<GLFWwindow *>(userData);
+    if (!window) return false;
+
+    applyEmscriptenCanvasResize(window);
+
+    return true;
+}
+#endif
+
+// engineMouseButtonCallback is a callback handler called each time the mouse button is pressed or released.
+// We update the draw state accordingly based on the given button event.
+void engineMouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+
+    // The middle and right buttons, or the left button while holding space, pan the canvas
+    bool pans = button != GLFW_MOUSE_BUTTON_LEFT || glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    if (action == GLFW_PRESS && pans && !engine->isDrawing()) {
+        engine->setPanning(true);
+        return;
+    } else if (action == GLFW_RELEASE && engine->isPanning()) {
+        engine->setPanning(false);
+        return;
+    }
+
+    if (button != GLFW_MOUSE_BUTTON_LEFT)
+        return;
+
+    if (action == GLFW_PRESS) {
+        engine->setDrawing(true);
+        engine->addPointAtMousePosition();
+    } else if (action == GLFW_RELEASE) {
+        engine->setDrawing(false);
+    }
+}
+
+// engineCursorPositionCallback is a callback handler called each time the mouse button is moved within the window.
+// Each position within a draw session is handed to the active tool, which continues from the __last known position__.
+// A draw session is created when the user starts pressing down on the mouse, and it is cleared when the mouse is released.
+void engineCursorPositionCallback(GLFWwindow *window, double xpos, double ypos) {
+    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+
+    // Timestamp the event as soon as it's seen, for latency measurement
+    engine->inputTime = glfwGetTime();
+
+    if (engine->isPanning()) {
+        engine->panTo(getMousePositionFrameBuffer(window));
+        return;
+    }
+
+    if (!engine->isDrawing()) {
+        return;
+    };
+
+    glm::vec2 mousePosition = engine->getMousePositionCanvas();
+
+    if (!engine->hasLastPoint) {
+        engine->lastPoint = glm::vec2{mousePosition.x, mousePosition.y};
+        engine->hasLastPoint = true;
+
+        // Return early as there's nothing to do.
+        // We have only just started drawing
+        return;
+    }
+
+    engine->addPointAtPosition(mousePosition);
+
+    // Set this position as the last known position in the drawing session (i.e mouse press)
+    engine->lastPoint = glm::vec2{mousePosition.x, mousePosition.y};
+}
+
+// engineScrollCallback is a callback handler called each time the mouse wheel or trackpad is scrolled.
+// Scrolling zooms the canvas about the cursor.
+void engineScrollCallback(GLFWwindow *window, double xoffset, double yoffset) {
+    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+
+    engine->zoomAt(getMousePositionFrameBuffer(window), std::pow(CAMERA_ZOOM_STEP, float(yoffset)));
+}
+
+// engineKeyCallback is a callback handler called each time a key is pressed, repeated or released.
+// It handles shortcuts which should only fire once per key press.
+void engineKeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+
+    if (action != GLFW_PRESS)
+        return;
+
+    // Layer shortcuts act on the active layer
+    if ((mods & (GLFW_MOD_CONTROL | GLFW_MOD_SUPER)) == 0) {
+        size_t active = engine->activeLayerIndex();
+        const Layer &layer = engine->layerAt(active);
+
+        if (key == GLFW_KEY_N) {
+            engine->addLayer();
+        } else if (key == GLFW_KEY_LEFT_BRACKET && active > 0) {
+            engine->selectLayer(active - 1);
+        } else if (key == GLFW_KEY_RIGHT_BRACKET) {
+            engine->selectLayer(active + 1);
+        } else if (key == GLFW_KEY_H) {
+            engine->setLayerVisible(!layer.visible);
+        } else if (key == GLFW_KEY_MINUS) {
+            engine->setLayerOpacity(layer.opacity - LAYER_OPACITY_STEP);
+        } else if (key == GLFW_KEY_EQUAL) {
+            engine->setLayerOpacity(layer.opacity + LAYER_OPACITY_STEP);
+        } else if (key == GLFW_KEY_K) {
+            engine->setLayerBlendMode(BlendMode((int(layer.blendMode) + 1) % BLEND_MODE_COUNT));
+        } else if (key == GLFW_KEY_Y) {
+            engine->setSymmetryMode(SymmetryMode((int(engine->symmetry.mode) + 1) % SYMMETRY_MODE_COUNT));
+        } else if (key == GLFW_KEY_COMMA) {
+            engine->setSymmetryWays(engine->symmetry.ways - 1);
+        } else if (key == GLFW_KEY_PERIOD) {
+            engine->setSymmetryWays(engine->symmetry.ways + 1);
+        }
+        return;
+    }
+
+    // Document shortcuts report failures rather than closing the app
+    try {
+        if (key == GLFW_KEY_S) {
+            engine->compactJournal();
+        } else if (key == GLFW_KEY_O) {
+            engine->open(engine->documentPath.c_str());
+        } else if (key == GLFW_KEY_E) {
+            engine->exportPng("drawing.png");
+        } else if (key == GLFW_KEY_M) {
+            engine->exportMetrics("drawing.metrics.json");
+        }
+    } catch (const std::exception &error) {
+        std::cout << error.what() << std::endl;
+    }
+}
+
+// Initialises the engine
+Engine::Engine(int width, int height, const char *title, int canvasWidth, int canvasHeight)
+    : inputTime(0.0), debugMode(false), exitAfterFirstFrame(false),
+      brushRadius(10.0f), eraserRadius(16.0f), brushHardness(1.0f), brushColor(DEFAULT_PAINT_COLOR),
+      symmetry{SymmetryMode::None, SYMMETRY_DEFAULT_WAYS, glm::vec2{0.0f, 0.0f}},
+      fillColor(DEFAULT_PAINT_COLOR), shapeWidth(4.0f), shapeColor(DEFAULT_PAINT_COLOR),
+      sprayRadius(24.0f), sprayRate(600.0f), sprayColor(DEFAULT_PAINT_COLOR),
+      documentPath(std::string("drawing") + DOCUMENT_EXTENSION), shaderCachePath(defaultProgramCacheDirectory()),
+      geometryBudget(64 * 1024 * 1024), useColdStore(true),
+      minRenderScale(RENDER_SCALE_MIN), maxRenderScale(RENDER_SCALE_MAX),
+      predictionHorizonMs(PREDICTOR_HORIZON_MS), predictionSmoothingMs(PREDICTOR_SMOOTHING_MS),
+      _isPanning(false),
+      lastCheckpointTime(0.0), numFrames(0), measuredFps(0), measuredMsPerFrame(0.0),
+      tool(Tool::Brush),
+      nextStrokeId(1), activeStroke(nullptr), strokeBoundsIndex(512.0f), strokeShader(nullptr), shapeShader(nullptr),
+      activeSpray(nullptr), sprayShader(nullptr), lastSprayTime(0.0), sprayCarry(0.0f), nextSpraySeed(1),
+      movingSelection(false),
+      geometryBytes(0), geometryCompactionThreshold(0),
+      canvasShader(nullptr), compositeShader(nullptr), activeLayer(0),
+      layersViewportSize(0.0f, 0.0f), layersHardness(0.0f), layersBrushColor(0) {
+    this->setRenderContext();
+    this->createWindow(width, height, title);
+    this->initOpenGL();
+    this->registerCallbacks();
+
+    this->startup.finish(StartupPhase::LoadGL);
+
+    // Compile the shaders used from the first frame, or load them from the
+    // binaries cached by the last launch, then setup the shader shared by every stroke
+    this->shaders.openBinaryCache(this->shaderCachePath);
+    this->shaders.prewarm(SHADER_MANIFEST);
+    this->startup.finish(StartupPhase::CompileShaders);
+    this->strokeShader = &this->shaders.get(ShaderProgram::Stroke, SHADER_INSTANCED | SHADER_ANTIALIASED);
+    this->predictionStroke.reset(new Stroke(0, *this->strokeShader, this->brushRadius));
+    this->shapeShader = &this->shaders.get(ShaderProgram::Shape);
+    this->sprayShader = &this->shaders.get(ShaderProgram::Spray);
+
+    // Setup the canvas raster layer, at the size of the frame buffer unless told otherwise
+    this->canvasShader = &this->shaders.get(ShaderProgram::Canvas);
+
+    int frameBufferWidth, frameBufferHeight;
+    glfwGetFramebufferSize(this->window, &frameBufferWidth, &frameBufferHeight);
+    if (canvasWidth <= 0 || canvasHeight <= 0) {
+        canvasWidth = frameBufferWidth;
+        canvasHeight = frameBufferHeight;
+    }
+
+    this->canvas.reset(new Canvas(canvasWidth, canvasHeight, *this->canvasShader, this->documentPath + ".tiles"));
+    this->viewportSize = glm::vec2{float(frameBufferWidth), float(frameBufferHeight)};
+
+    // Setup the layers composited over the canvas, starting with a single layer
+    this->compositeShader = &this->shaders.get(ShaderProgram::Composite);
+    this->layers.reset(new LayerStack(*this->compositeShader));
+
+    this->exporter.reset(new Exporter(this->threadPool));
+    this->renderScaler.reset(new RenderScaler());
+    this->latency.reset(new LatencyTracker());
+
+    this->setDrawing(false);
+
+    // Restore the drawing from the last session
+    this->recover();
+    this->startup.finish(StartupPhase::Setup);
+}
+
+// Destructor to clean up heap-allocated objects
+Engine::~Engine() {
+    this->nodes.clear();
+    this->strokes.clear();
+}
+
+void Engine::setRenderContext() {
+#ifdef __EMSCRIPTEN__
+    this->context = RENDER_CONTEXT_WEB;
+#else
+    this->context = RENDER_CONTEXT_NATIVE;
+#endif
+}
+
+void Engine::setDrawing(bool isDrawing) {
+    this->_isDrawing = isDrawing;
+
+    if (!isDrawing) {
+        // Reset last point if we are not drawing
+        this->hasLastPoint = false;
+
+        // Finish the stroke, shape or spray drawn in this session
+        this->endStroke();
+        this->endShape();
+        this->endSpray();
+        this->releaseSelection();
+    }
+}
+
+bool Engine::isDrawing() {
+    return this->_isDrawing;
+}
+
+// setPanning sets whether mouse movements pan the canvas
+void Engine::setPanning(bool isPanning) {
+    this->_isPanning = isPanning;
+    this->lastPanPosition = getMousePositionFrameBuffer(this->window);
+}
+
+// isPanning indicates whether mouse movements pan the canvas
+bool Engine::isPanning() {
+    return this->_isPanning;
+}
+
+// panTo pans the canvas so it follows the mouse to the given frame buffer position
+void Engine::panTo(glm::vec2 position) {
+    this->camera.pan(position - this->lastPanPosition);
+    this->lastPanPosition = position;
+}
+
+// zoomAt zooms the canvas by a factor about the given frame buffer position
+void Engine::zoomAt(glm::vec2 position, float factor) {
+    this->camera.zoomAt(position, factor);
+
+    if (this->debugMode) {
+        printf("Zoom => %.3f (LOD level %d)\n", this->camera.zoom, Stroke::lodLevel(this->camera.zoom));
+    }
+}
+
+// getMousePositionCanvas returns the mouse position in canvas space
+glm::vec2 Engine::getMousePositionCanvas() {
+    return this->camera.screenToCanvas(getMousePositionFrameBuffer(this->window));
+}
+
+// addPointAtMousePosition applies the active tool at the current mouse position.
+// This starts a new stroke when drawing and erases when using an eraser.
+void Engine::addPointAtMousePosition() {
+    glm::vec2 mousePosition = this->getMousePositionCanvas();
+
+    ShapeKind kind;
+    if (this->tool == Tool::Brush) {
+        this->endStroke();
+        this->activeStroke = this->createStroke({mousePosition}, this->symmetry);
+        this->predictor.addSample(mousePosition, glfwGetTime(), this->predictionSmoothingMs);
+    } else if (shapeKind(this->tool, kind)) {
+        this->endShape();
+        bool filled = glfwGetKey(this->window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
+                      glfwGetKey(this->window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+        this->activeShape.reset(new Shape(this->nextStrokeId++, *this->shapeShader, kind, mousePosition,
+                                          this->shapeWidth, filled, this->shapeColor));
+        this->activeShape->layer = this->layers->at(this->activeLayer).id;
+    } else if (this->tool == Tool::Spray) {
+        // The spray emits a burst every frame until the mouse is released
+        this->endSpray();
+        std::unique_ptr<Spray> spray(new Spray(this->nextStrokeId++, *this->sprayShader, this->sprayColor));
+        spray->layer = this->layers->at(this->activeLayer).id;
+        this->activeSpray = spray.get();
+        this->sprays[spray->id] = std::move(spray);
+        this->lastSprayTime = glfwGetTime();
+        this->sprayCarry = 0.0f;
+    } else if (this->tool == Tool::Select) {
+        this->pressSelection(mousePosition);
+    } else if (this->tool == Tool::Fill) {
+        this->fillAt(mousePosition);
+    } else {
+        this->eraseAt(mousePosition);
+    }
+
+    // Set this point as the last point
+    this->lastPoint = glm::vec2{mousePosition.x, mousePosition.y};
+    this->hasLastPoint = true;
+}
+
+// addPointAtPosition continues the active tool's draw session at the given canvas space position
+void Engine::addPointAtPosition(glm::vec2 position) {
+    if (this->tool == Tool::Brush) {
+        this->extendStroke(position);
+        return;
+    }
+
+    // Dragging a shape only moves its end, which it's drawn from next frame
+    ShapeKind kind;
+    if (shapeKind(this->tool, kind)) {
+        if (this->activeShape) {
+            this->activeShape->end = position;
+        }
+        return;
+    }
+
+    // Selections move in whole pixels, so they're put down without resampling
+    if (this->tool == Tool::Select) {
+        if (this->movingSelection) {
+            glm::vec2 moved = position - this->selectionDragStart;
+            this->selection->offset =
+                this->selectionDragOffset + glm::ivec2{int(std::round(moved.x)), int(std::round(moved.y))};
+        } else if (this->selectionOutline) {
+            this->selectionOutline->end = position;
+        }
+        return;
+    }
+
+    // Sprays follow the cursor as they emit each frame
+    if (this->tool == Tool::Fill || this->tool == Tool::Spray)
+        return;
+
+    // Sweep the eraser from the last known position so fast mouse movements
+    // don't skip over strokes
+    glm::vec2 delta = position - this->lastPoint;
+    float distance = glm::length(delta);
+
+    int steps = std::max(1, int(std::ceil(distance / (this->eraserRadius / 2))));
+    for (int i = 1; i <= steps; i++) {
+        this->eraseAt(this->lastPoint + (delta * (float(i) / float(steps))));
+    }
+}
+
+// setTool sets the tool used when the mouse is pressed
+void Engine::setTool(Tool tool) {
+    if (this->tool == tool)
+        return;
+
+    this->endStroke();
+    this->endShape();
+    this->endSpray();
+    this->commitSelection();
+    this->tool = tool;
+
+    if (this->debugMode) {
+        printf("Tool => %d\n", int(tool));
+    }
+}
+
+// addLayer adds an empty layer above the active layer and makes it active.
+// It returns false once the drawing has LAYER_MAX layers.
+bool Engine::addLayer() {
+    int index = this->layers->add(this->activeLayer);
+    if (index < 0) {
+        if (this->debugMode) {
+            printf("Layers => already at the limit of %d\n", LAYER_MAX);
+        }
+        return false;
+    }
+
+    this->selectLayer(size_t(index));
+    return true;
+}
+
+// selectLayer makes the layer at the given index, counted from the bottom,
+// the one new strokes, shapes and sprays are drawn on and erasers erase from
+void Engine::selectLayer(size_t index) {
+    if (index >= this->layers->size())
+        return;
+
+    // Finish what was being drawn on the previous layer
+    this->endStroke();
+    this->endShape();
+    this->endSpray();
+
+    this->activeLayer = index;
+    this->reportLayer();
+}
+
+// activeLayerIndex returns the index of the active layer, counted from the bottom
+size_t Engine::activeLayerIndex() const {
+    return this->activeLayer;
+}
+
+// layerAt returns the layer at the given index, counted from the bottom
+const Layer &Engine::layerAt(size_t index) const {
+    return this->layers->at(index);
+}
+
+// setLayerVisible, setLayerOpacity and setLayerBlendMode change how the
+// active layer is composited
+void Engine::setLayerVisible(bool visible) {
+    this->layers->setVisible(this->activeLayer, visible);
+    this->reportLayer();
+}
+
+void Engine::setLayerOpacity(float opacity) {
+    this->layers->setOpacity(this->activeLayer, opacity);
+    this->reportLayer();
+}
+
+void Engine::setLayerBlendMode(BlendMode blendMode) {
+    this->layers->setBlendMode(this->activeLayer, blendMode);
+    this->reportLayer();
+}
+
+// reportLayer logs the active layer and the memory used by the layers
+void Engine::reportLayer() {
+    if (!this->debugMode)
+        return;
+
+    const char *blendModes[BLEND_MODE_COUNT] = {"normal", "multiply", "screen", "overlay"};
+    const Layer &layer = this->layers->at(this->activeLayer);
+    printf("Layer %zu of %zu => %s, %.0f%% opacity, %s blending - layers use %zu GPU bytes\n",
+           this->activeLayer + 1, this->layers->size(), layer.visible ? "visible" : "hidden", layer.opacity * 100,
+           blendModes[int(layer.blendMode)], this->layers->gpuBytes());
+}
+
+// setSymmetryMode sets how new strokes are copied, about the center of the view
+void Engine::setSymmetryMode(SymmetryMode mode) {
+    Rect visible = this->camera.visibleRect(this->viewportSize);
+    this->symmetry.mode = mode;
+    this->symmetry.center = (visible.min + visible.max) * 0.5f;
+
+    if (this->debugMode) {
+        const char *modes[SYMMETRY_MODE_COUNT] = {"none", "horizontal", "vertical", "radial"};
+        printf("Symmetry => %s, %d copies about (%.1f, %.1f)\n", modes[int(mode)], this->symmetry.numCopies(),
+               this->symmetry.center.x, this->symmetry.center.y);
+    }
+}
+
+// setSymmetryWays sets how many copies radial symmetry draws of new strokes,
+// including the stroke itself
+void Engine::setSymmetryWays(int ways) {
+    this->symmetry.ways = std::clamp(ways, 2, SYMMETRY_MAX_COPIES);
+
+    if (this->debugMode) {
+        printf("Symmetry ways => %d\n", this->symmetry.ways);
+    }
+}
+
+// createStroke creates a stroke with the given samples and symmetry and adds it
+// to the canvas. Only the stroke itself is stored, and its copies are saved as
+// its symmetry.
+Stroke *Engine::createStroke(const std::vector<glm::vec2> &samples, const Symmetry &symmetry) {
+    std::unique_ptr<Stroke> stroke(new Stroke(this->nextStrokeId++, *this->strokeShader, this->brushRadius));
+    stroke->layer = this->layers->at(this->activeLayer).id;
+    stroke->symmetry = symmetry;
+    this->trackSymmetry(symmetry);
+
+    for (const glm::vec2 &sample: samples) {
+        stroke->addSample(sample);
+    }
+
+    return this->addStroke(std::move(stroke));
+}
+
+// translatedStroke returns an unsealed copy of a stroke with the given ID,
+// moved by an offset in canvas space. Its symmetry is moved with it, so its
+// copies move by the same offset.
+std::unique_ptr<Stroke> Engine::translatedStroke(uint32_t id, const Stroke &source, glm::vec2 offset) {
+    std::unique_ptr<Stroke> stroke(new Stroke(id, *this->strokeShader, source.radius));
+    stroke->layer = source.layer;
+    stroke->symmetry = source.symmetry;
+    stroke->symmetry.center += offset;
+    this->trackSymmetry(stroke->symmetry);
+
+    for (const glm::vec2 &sample: source.samples) {
+        stroke->addSample(sample + offset);
+    }
+
+    return stroke;
+}
+
+// trackSymmetry remembers a symmetry a stroke is drawn with, so erasers find its copies
+void Engine::trackSymmetry(const Symmetry &symmetry) {
+    if (symmetry.numCopies() > 1 &&
+        std::find(this->symmetries.begin(), this->symmetries.end(), symmetry) == this->symmetries.end()) {
+        this->symmetries.push_back(symmetry);
+    }
+}
+
+// addStroke adds a stroke to the canvas and indexes its segments
+Stroke *Engine::addStroke(std::unique_ptr<Stroke> stroke) {
+    uint32_t id = stroke->id;
+
+    for (size_t segment = 0; segment < stroke->segmentCount(); segment++) {
+        this->strokeIndex.insert(id, uint32_t(segment), stroke->segmentBounds(segment));
+    }
+
+    if (stroke->isSealed() && !stroke->bounds.isEmpty()) {
+        this->strokeBoundsIndex.insert(id, 0, stroke->bounds);
+    }
+    if (stroke->isSealed()) {
+        this->geometryBytes += stroke->geometryBytes();
+    }
+
+    this->layers->markDirty(stroke->layer);
+
+    Stroke *added = stroke.get();
+    this->strokes[id] = std::move(stroke);
+
+    return added;
+}
+
+// clearStrokes removes every stroke from the canvas
+void Engine::clearStrokes() {
+    this->activeStroke = nullptr;
+    this->strokes.clear();
+    this->strokeIndex.clear();
+    this->strokeBoundsIndex.clear();
+    this->pendingLods.clear();
+    this->symmetries.clear();
+
+    this->bakedStrokes.clear();
+    this->coldStore.reset();
+    this->geometryBytes = 0;
+    this->geometryCompactionThreshold = 0;
+
+    if (this->layers) {
+        this->layers->invalidate();
+    }
+}
+
+// extendStroke appends a sample to the active stroke and indexes its new segment
+void Engine::extendStroke(glm::vec2 position) {
+    Stroke *stroke = this->activeStroke;
+    if (stroke == nullptr)
+        return;
+
+    this->predictor.addSample(position, this->inputTime, this->predictionSmoothingMs);
+
+    int numStamps = stroke->addSample(position);
+    if (numStamps == 0)
+        return;
+
+    if (this->debugMode) {
+        printf("Num interpolation steps => %d\n", numStamps);
+    }
+
+    // The event's first stamps are shown in the next frame
+    this->latency->tagInput(this->inputTime);
+
+    // The first segment of a stroke is indexed as a single point until its
+    // second sample arrives, so replace it rather than indexing it twice
+    if (stroke->samples.size() == 2) {
+        this->strokeIndex.remove(stroke->id);
+    }
+
+    size_t segment = stroke->segmentCount() - 1;
+    this->strokeIndex.insert(stroke->id, uint32_t(segment), stroke->segmentBounds(segment));
+}
+
+// endShape adds the shape being dragged out to the canvas, unless it's empty,
+// e.g after a click without a drag
+void Engine::endShape() {
+    if (!this->activeShape)
+        return;
+
+    std::unique_ptr<Shape> shape = std::move(this->activeShape);
+    if (shape->start == shape->end)
+        return;
+
+    if (this->debugMode) {
+        printf("Shape %u => kind %d from (%.1f, %.1f) to (%.1f, %.1f)%s\n", shape->id, int(shape->kind), shape->start.x,
+               shape->start.y, shape->end.x, shape->end.y, shape->filled ? " filled" : "");
+    }
+
+    this->shapes[shape->id] = std::move(shape);
+}
+
+// emitSpray adds a burst to the active spray at the cursor, holding the
+// particles sprayed since the last burst. Only the burst is uploaded; its
+// particles are generated on the GPU from its seed.
+void Engine::emitSpray() {
+    double now = glfwGetTime();
+    float particles = (float(now - this->lastSprayTime) * this->sprayRate) + this->sprayCarry;
+    this->lastSprayTime = now;
+
+    // Particles past the most a burst draws are dropped rather than carried over,
+    // e.g after a stalled frame
+    int numParticles = std::min(int(particles), SPRAY_MAX_PARTICLES);
+    this->sprayCarry = numParticles < SPRAY_MAX_PARTICLES ? particles - float(numParticles) : 0.0f;
+    if (numParticles == 0)
+        return;
+
+    this->activeSpray->addBurst(
+        SprayBurst{this->getMousePositionCanvas(), this->sprayRadius, float(numParticles), this->nextSpraySeed++});
+}
+
+// endSpray finishes the active spray, dropping it if it emitted nothing
+void Engine::endSpray() {
+    if (this->activeSpray == nullptr)
+        return;
+
+    Spray *spray = this->activeSpray;
+    this->activeSpray = nullptr;
+
+    if (spray->bursts.empty()) {
+        this->sprays.erase(spray->id);
+        return;
+    }
+
+    if (this->journal) {
+        this->journal->appendSpray(DocumentSpray{spray->id, spray->color, &spray->bursts});
+    }
+
+    if (this->debugMode) {
+        printf("Spray %u => %zu bursts\n", spray->id, spray->bursts.size());
+    }
+}
+
+// loadSpray adds a spray read from a document or the journal to the canvas.
+// Later bursts are seeded after its own, so they spray different particles.
+void Engine::loadSpray(uint32_t id, uint32_t color, const std::vector<SprayBurst> &bursts) {
+    std::unique_ptr<Spray> spray(new Spray(this->claimStrokeId(id), *this->sprayShader, color));
+    for (const SprayBurst &burst: bursts) {
+        spray->addBurst(burst);
+        this->nextSpraySeed = std::max(this->nextSpraySeed, burst.seed + 1);
+    }
+
+    this->layers->markDirty(spray->layer);
+    this->sprays[spray->id] = std::move(spray);
+}
+
+// pressSelection starts dragging the floating selection when pressed inside
+// it, or else puts it down and starts dragging out a new one. Holding alt as
+// a drag starts puts down a copy and drags the selection away from it.
+void Engine::pressSelection(glm::vec2 position) {
+    if (this->selection && this->selection->bounds().contains(position)) {
+        if (glfwGetKey(this->window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS ||
+            glfwGetKey(this->window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS) {
+            this->stampSelection();
+            this->putDownStrokes(true);
+        }
+
+        this->movingSelection = true;
+        this->selectionDragStart = position;
+        this->selectionDragOffset = this->selection->offset;
+        return;
+    }
+
+    this->commitSelection();
+    this->selectionOutline.reset(new Shape(0, *this->shapeShader, ShapeKind::Rectangle, position,
+                                           SELECTION_OUTLINE_WIDTH, false, SELECTION_OUTLINE_COLOR));
+}
+
+// releaseSelection finishes dragging the floating selection, or lifts the
+// rectangle which was dragged out
+void Engine::releaseSelection() {
+    if (this->movingSelection) {
+        this->movingSelection = false;
+        return;
+    }
+
+    if (!this->selectionOutline || this->selection)
+        return;
+
+    Rect region = Rect::empty();
+    region.expand(this->selectionOutline->start);
+    region.expand(this->selectionOutline->end);
+    this->liftSelection(region);
+
+    // A click without a drag selects nothing
+    if (!this->selection) {
+        this->selectionOutline.reset();
+    }
+}
+
+// liftSelection lifts the canvas' pixels under a region of canvas space into
+// a floating selection, leaving the background behind. Strokes on the bottom
+// layer lying entirely in the region are lifted with it: they're hidden from
+// the layer and drawn at the selection's offset until it's put down, when
+// their samples are moved. The lifted pixels are copied on the GPU, and
+// nothing is drawn again while the selection is moved.
+void Engine::liftSelection(const Rect &region) {
+    // Snap the region to the canvas' pixels. Canvas rows are stored bottom first.
+    int minX = std::max(0, int(std::floor(region.min.x)));
+    int maxX = std::min({this->canvas->width, int(std::ceil(region.max.x)), minX + CANVAS_MAX_READBACK_SIZE});
+    int maxRow = std::min(this->canvas->height, this->canvas->height - int(std::floor(region.min.y)));
+    int minRow = std::max({0, this->canvas->height - int(std::ceil(region.max.y)), maxRow - CANVAS_MAX_READBACK_SIZE});
+    if (maxX - minX <= 1 || maxRow - minRow <= 1)
+        return;
+
+    double start = glfwGetTime();
+
+    // Lift the strokes on the bottom layer lying entirely in the region
+    uint32_t bottom = this->layers->at(0).id;
+    Rect lifted{glm::vec2{float(minX), float(this->canvas->height - maxRow)},
+                glm::vec2{float(maxX), float(this->canvas->height - minRow)}};
+    std::vector<SegmentRef> hits;
+    this->strokeBoundsIndex.query(lifted, hits);
+
+    this->liftedStrokes.clear();
+    for (const SegmentRef &hit: hits) {
+        auto found = this->strokes.find(hit.strokeId);
+        if (found == this->strokes.end())
+            continue;
+
+        const Stroke *stroke = found->second.get();
+        if (stroke->isSealed() && stroke->layer == bottom && lifted.contains(stroke->bounds.min) &&
+            lifted.contains(stroke->bounds.max)) {
+            this->liftedStrokes.insert(stroke->id);
+        }
+    }
+
+    // Render the canvas under the region and copy it into the floating texture
+    int width = maxX - minX;
+    int height = maxRow - minRow;
+    Camera screenCamera = this->camera;
+    glm::vec2 screenViewportSize = this->viewportSize;
+
+    this->canvas->bindReadbackTarget(minX, minRow, width, height);
+    this->camera = Camera();
+    this->camera.position = glm::vec2{float(minX), float(this->canvas->height - maxRow)};
+    this->viewportSize = glm::vec2{float(width), float(height)};
+
+    this->clearScreen();
+    this->renderReadbackCanvas();
+
+    this->camera = screenCamera;
+    this->viewportSize = screenViewportSize;
+
+    this->selection.reset(
+        new Selection(*this->canvasShader, minX, minRow, width, height, this->canvas->height));
+    this->selection->lift();
+
+    // Leave the background behind
+    this->clearScreen();
+    this->canvas->commitReadbackRegion(minX, minRow, width, height);
+
+    this->bindScreenTarget();
+    this->layers->markDirty(bottom);
+
+    if (this->debugMode) {
+        printf("Selection => lifted %dx%d px and %zu strokes at (%d, %d) in %.3f ms\n", width, height,
+               this->liftedStrokes.size(), minX, this->canvas->height - maxRow, (glfwGetTime() - start) * 1000);
+    }
+}
+
+// stampSelection copies the floating selection's pixels into the canvas where
+// it lies, with a single blit. Pixels moved off the canvas are dropped.
+void Engine::stampSelection() {
+    Selection *selection = this->selection.get();
+    int x = selection->x + selection->offset.x;
+    int row = selection->y - selection->offset.y;
+
+    int minX = std::max(0, x);
+    int maxX = std::min(this->canvas->width, x + selection->width);
+    int minRow = std::max(0, row);
+    int maxRow = std::min(this->canvas->height, row + selection->height);
+    if (minX >= maxX || minRow >= maxRow)
+        return;
+
+    this->canvas->bindReadbackTarget(minX, minRow, maxX - minX, maxRow - minRow);
+    selection->blit(x - minX, row - minRow);
+    this->canvas->commitReadbackRegion(minX, minRow, maxX - minX, maxRow - minRow);
+
+    this->bindScreenTarget();
+    this->layers->markDirty(this->layers->at(0).id);
+}
+
+// putDownStrokes moves the strokes lifted with the floating selection to where
+// it lies, moving their samples by its offset, and shows them on their layer
+// again. Baked strokes whose pixels it holds are moved with them, so the drawing
+// is saved as it's shown. With copy, moved copies are put down instead and the
+// lifted strokes stay lifted.
+void Engine::putDownStrokes(bool copy) {
+    glm::vec2 offset{float(this->selection->offset.x), float(this->selection->offset.y)};
+
+    if (copy || offset != glm::vec2{0.0f, 0.0f}) {
+        for (uint32_t id: this->liftedStrokes) {
+            const Stroke &source = *this->strokes.at(id);
+
+            if (copy) {
+                this->sealStroke(this->addStroke(this->translatedStroke(this->nextStrokeId++, source, offset)));
+            } else {
+                std::unique_ptr<Stroke> moved = this->translatedStroke(id, source, offset);
+                this->removeStroke(id);
+                this->sealStroke(this->addStroke(std::move(moved)));
+            }
+        }
+
+        this->moveBakedStrokes(this->selection->region(), offset, copy);
+    }
+
+    if (!copy) {
+        this->liftedStrokes.clear();
+        this->layers->markDirty(this->layers->at(0).id);
+    }
+}
+
+// moveBakedStrokes moves the samples of the baked strokes lying entirely in a
+// region of canvas space by an offset, once their pixels have been moved with a
+// selection, or adds moved copies of them. Strokes in the cold store are read
+// back, and the moved strokes are kept in memory.
+void Engine::moveBakedStrokes(const Rect &region, glm::vec2 offset, bool copy) {
+    std::vector<std::pair<uint32_t, BakedStroke> > moved;
+
+    // move moves a baked stroke's samples if every copy of it lies in the region
+    auto move = [&region, &offset, &moved](uint32_t id, const BakedStroke &baked,
+                                           const std::vector<glm::vec2> &samples) {
+        Rect bounds = Rect::empty();
+        for (const glm::vec2 &sample: samples) {
+            bounds.expand(sample);
+        }
+        if (bounds.isEmpty())
+            return;
+
+        bounds = baked.symmetry.bounds(bounds.inflated(baked.radius));
+        if (!region.contains(bounds.min) || !region.contains(bounds.max))
+            return;
+
+        BakedStroke stroke{baked.radius, baked.symmetry, -1, samples};
+        stroke.symmetry.center += offset;
+        for (glm::vec2 &sample: stroke.samples) {
+            sample += offset;
+        }
+        moved.emplace_back(id, std::move(stroke));
+    };
+
+    std::vector<int64_t> coldBlocks;
+    for (auto &entry: this->bakedStrokes) {
+        if (entry.second.coldBlock >= 0) {
+            coldBlocks.push_back(entry.second.coldBlock);
+        } else {
+            move(entry.first, entry.second, entry.second.samples);
+        }
+    }
+
+    std::sort(coldBlocks.begin(), coldBlocks.end());
+    coldBlocks.erase(std::unique(coldBlocks.begin(), coldBlocks.end()), coldBlocks.end());
+
+    for (int64_t block: coldBlocks) {
+        this->coldStore->get(uint32_t(block),
+                             [this, block, &move](uint32_t id, float, const Symmetry &,
+                                                  std::vector<glm::vec2> &samples) {
+                                 auto baked = this->bakedStrokes.find(id);
+                                 if (baked != this->bakedStrokes.end() && baked->second.coldBlock == block) {
+                                     move(id, baked->second, samples);
+                                 }
+                             });
+    }
+
+    for (auto &entry: moved) {
+        uint32_t id = entry.first;
+        BakedStroke &stroke = entry.second;
+
+        if (copy) {
+            id = this->nextStrokeId++;
+        } else if (this->journal) {
+            this->journal->appendRemove(id);
+        }
+
+        this->trackSymmetry(stroke.symmetry);
+        this->journalStroke(id, stroke.radius, stroke.symmetry, stroke.samples);
+        this->bakedStrokes[id] = std::move(stroke);
+    }
+}
+
+// commitSelection puts the floating selection down, if any
+void Engine::commitSelection() {
+    if (this->selection) {
+        this->stampSelection();
+        this->putDownStrokes(false);
+    }
+
+    this->selection.reset();
+    this->selectionOutline.reset();
+    this->movingSelection = false;
+}
+
+// endStroke seals the active stroke
+void Engine::endStroke() {
+    if (this->activeStroke == nullptr)
+        return;
+
+    this->sealStroke(this->activeStroke);
+    this->activeStroke = nullptr;
+    this->predictor.reset();
+}
+
+// sealStroke seals a stroke and records it in the journal
+void Engine::sealStroke(Stroke *stroke) {
+    stroke->seal();
+    if (!stroke->bounds.isEmpty()) {
+        this->strokeBoundsIndex.insert(stroke->id, 0, stroke->bounds);
+    }
+    this->geometryBytes += stroke->geometryBytes();
+
+    this->journalStroke(stroke->id, stroke->radius, stroke->symmetry, stroke->samples);
+}
+
+// journalStroke records a stroke, with the symmetry its copies are drawn with,
+// in the journal, if any
+void Engine::journalStroke(uint32_t id, float radius, const Symmetry &symmetry, const std::vector<glm::vec2> &samples) {
+    if (this->journal) {
+        this->journal->appendStroke(DocumentStroke{id, radius, symmetry, &samples});
+    }
+}
+
+// unindexStroke removes a stroke from the stroke indexes
+void Engine::unindexStroke(uint32_t id) {
+    this->strokeIndex.remove(id);
+    this->strokeBoundsIndex.remove(id);
+}
+
+// claimStrokeId returns the ID a stroke or spray loaded with the given ID
+// should use. Missing or already used IDs are replaced with a new one.
+uint32_t Engine::claimStrokeId(uint32_t id) {
+    if (id == 0 || this->strokes.count(id) != 0 || this->sprays.count(id) != 0)
+        return this->nextStrokeId++;
+
+    this->nextStrokeId = std::max(this->nextStrokeId, id + 1);
+    return id;
+}
+
+// removeStroke removes a stroke from the canvas
+void Engine::removeStroke(uint32_t id) {
+    auto stroke = this->strokes.find(id);
+    if (stroke == this->strokes.end())
+        return;
+
+    if (stroke->second.get() == this->activeStroke) {
+        this->activeStroke = nullptr;
+    } else if (stroke->second->isSealed()) {
+        this->geometryBytes -= stroke->second->geometryBytes();
+    }
+
+    this->layers->markDirty(stroke->second->layer);
+    this->unindexStroke(id);
+    this->strokes.erase(stroke);
+    this->pendingLods.erase(id);
+
+    if (this->journal) {
+        this->journal->appendRemove(id);
+    }
+}
+
+// eraseAt applies the active eraser tool at the given canvas space position.
+// Only the segments found in the stroke index under the eraser are inspected,
+// so erasing costs the same regardless of how much has been drawn elsewhere.
+// Only strokes themselves are indexed, so the copies of strokes drawn with a
+// symmetry are erased by mapping the eraser back onto the strokes, through
+// each copy of each symmetry in use. Erasing a copy erases the stroke it's
+// drawn from, and with it every other copy.
+void Engine::eraseAt(glm::vec2 position) {
+    this->eraseStrokesAt(position, nullptr);
+
+    // Erasing splits strokes into new ones with the same symmetry, which is
+    // already in use, so the symmetries don't change while they're visited
+    for (size_t i = 0; i < this->symmetries.size(); i++) {
+        Symmetry symmetry = this->symmetries[i];
+        for (int copy = 1; copy < symmetry.numCopies(); copy++) {
+            this->eraseStrokesAt(symmetry.unapply(copy, position), &symmetry);
+        }
+    }
+}
+
+// eraseStrokesAt applies the active eraser tool to the strokes under the
+// given canvas space position, or only to those drawn with a symmetry if one is given
+void Engine::eraseStrokesAt(glm::vec2 position, const Symmetry *symmetry) {
+    std::vector<SegmentRef> hits;
+    this->strokeIndex.query(Rect::around(position, this->eraserRadius), hits);
+
+    if (hits.empty())
+        return;
+
+    // Group the hit segments by stroke
+    std::sort(hits.begin(), hits.end(), [](const SegmentRef &a, const SegmentRef &b) {
+        return a.strokeId < b.strokeId;
+    });
+
+    uint32_t lastStrokeId = 0;
+    for (const SegmentRef &hit: hits) {
+        if (hit.strokeId == lastStrokeId)
+            continue;
+
+        auto found = this->strokes.find(hit.strokeId);
+        if (found == this->strokes.end())
+            continue;
+
+        // Erasers only erase from the active layer
+        Stroke *stroke = found->second.get();
+        if (stroke->layer != this->layers->at(this->activeLayer).id ||
+            (symmetry != nullptr && stroke->symmetry != *symmetry))
+            continue;
+
+        if (this->tool == Tool::StrokeEraser) {
+            if (stroke->distanceToSegment(hit.segment, position) > this->eraserRadius + stroke->radius)
+                continue;
+
+            lastStrokeId = hit.strokeId;
+            this->removeStroke(hit.strokeId);
+            continue;
+        }
+
+        lastStrokeId = hit.strokeId;
+
+        // Split the stroke into the pieces which survive the eraser
+        std::vector<std::vector<glm::vec2> > runs;
+        if (!stroke->erase(position, this->eraserRadius, runs))
+            continue;
+
+        Symmetry strokeSymmetry = stroke->symmetry;
+        this->removeStroke(hit.strokeId);
+
+        for (const std::vector<glm::vec2> &run: runs) {
+            this->sealStroke(this->createStroke(run, strokeSymmetry));
+        }
+    }
+}
+
+// fillAt starts a bucket fill of the region under the given canvas space position.
+// The scene is rendered into the canvas' offscreen frame buffer and read back, then the
+// region is found on the thread pool so large fills don't stall the render loop.
+void Engine::fillAt(glm::vec2 position) {
+    int seedX = int(std::floor(position.x));
+    int seedY = this->canvas->height - 1 - int(std::floor(position.y));
+
+    if (seedX < 0 || seedY < 0 || seedX >= this->canvas->width || seedY >= this->canvas->height)
+        return;
+
+    // Only a single fill runs at a time
+    if (this->pendingFill)
+        return;
+
+    double readbackStart = glfwGetTime();
+
+    // Render the scene around the seed and read it back. Fills on canvases too
+    // large to read back at once stop at the edges of the region.
+    auto job = std::make_shared<FillJob>();
+    this->readbackRegion(position, job->regionX, job->regionY, job->width, job->height);
+    this->renderToReadbackTarget(job->regionX, job->regionY, job->width, job->height);
+
+    job->pixels = this->canvas->readback();
+    job->seedX = seedX - job->regionX;
+    job->seedY = seedY - job->regionY;
+    job->readbackMs = (glfwGetTime() - readbackStart) * 1000;
+
+    this->bindScreenTarget();
+
+    ThreadPool &pool = this->threadPool;
+    this->pendingFill = job;
+
+    this->threadPool.submit([job, &pool]() {
+        auto fillStart = std::chrono::steady_clock::now();
+
+        job->result = floodFill(job->pixels.data(), job->width, job->height, job->seedX, job->seedY, pool, job->cancel);
+        job->fillMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fillStart).count();
+        job->done.store(true, std::memory_order_release);
+    });
+}
+
+// exportPng exports the scene to a PNG file. The canvas is rendered into the
+// canvas' offscreen frame buffer a region at a time and each region's read back
+// is queued, so the pixels are collected over the following frames and encoded
+// on the thread pool. Canvases too large to read back at once are exported
+// whole, a region at a time.
+void Engine::exportPng(const char *path) {
+    if (this->exporter->isBusy()) {
+        std::cout << "An export is already in progress" << std::endl;
+        return;
+    }
+
+    if (!this->exporter->begin(this->canvas->width, this->canvas->height, path))
+        return;
 
-    // 3. Finally update the viewport with the updated frame buffer size
-    int frameBufferWidth, frameBufferHeight;
-    glfwGetFramebufferSize(window, &frameBufferWidth, &frameBufferHeight);
+    for (int y = 0; y < this->canvas->height; y += CANVAS_MAX_READBACK_SIZE) {
+        for (int x = 0; x < this->canvas->width; x += CANVAS_MAX_READBACK_SIZE) {
+            int width = std::min(CANVAS_MAX_READBACK_SIZE, this->canvas->width - x);
+            int height = std::min(CANVAS_MAX_READBACK_SIZE, this->canvas->height - y);
 
-    glViewport(0, 0, frameBufferWidth, frameBufferHeight);
+            this->renderToReadbackTarget(x, y, width, height);
+            this->exporter->read(x, y, width, height);
+        }
+    }
+
+    this->bindScreenTarget();
 }
 
-/**
- * emscriptenResizeCallback handles the HTML window being resized
- */
-bool emscriptenResizeCallback(int eventType, const EmscriptenUiEvent *uiEvent, void *userData) {
-    GLFWwindow *window = reinterpret_cast<GLFWwindow *>(userData);
-    if (!window) return false;
+// processPendingExport advances the PNG export in progress and reports it once it has completed
+void Engine::processPendingExport() {
+    ExportStats stats;
+    if (!this->exporter->update(stats))
+        return;
 
-    applyEmscriptenCanvasResize(window);
+    if (stats.failed) {
+        std::cout << "Failed to export " << stats.path << std::endl;
+        return;
+    }
 
-    return true;
+    if (this->debugMode) {
+        printf("Exported %s (%dx%d, %zu bytes) in %.3f ms - readback %.3f ms, encode %.3f ms\n", stats.path.c_str(),
+               stats.width, stats.height, stats.numBytes, stats.totalMs, stats.readbackMs, stats.encodeMs);
+    }
 }
-#endif
 
-// engineMouseButtonCallback is a callback handler called each time the mouse button is pressed or released.
-// We update the draw state accordingly based on the given button event.
-void engineMouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
-    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+// cancelFill cancels the bucket fill in progress, if any
+void Engine::cancelFill() {
+    if (!this->pendingFill)
+        return;
 
-    if (action == GLFW_PRESS) {
-        engine->setDrawing(true);
-        engine->addPointAtMousePosition();
-    } else if (action == GLFW_RELEASE) {
-        engine->setDrawing(false);
-    }
+    this->pendingFill->cancel.store(true);
 }
 
-// engineCursorPositionCallback is a callback handler called each time the mouse button is moved within the window.
-// We linearly interpolate the distance between the __last known position__ in a given draw session and the __current mouse position__.
-// A draw session is created when the user starts pressing down on the mouse, and it is cleared when the mouse is released.
-// This approach allows us to minimize the gaps in stroke lines when drawing continuously.
-void engineCursorPositionCallback(GLFWwindow *window, double xpos, double ypos) {
-    auto engine = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window));
+// processPendingFill applies the pending bucket fill to the canvas once it has completed.
+// Only the bounding rectangle of the filled region is uploaded to the canvas texture.
+void Engine::processPendingFill() {
+    if (!this->pendingFill || !this->pendingFill->done.load(std::memory_order_acquire))
+        return;
 
-    if (!engine->isDrawing()) {
+    std::shared_ptr<FillJob> job = std::move(this->pendingFill);
+    const FloodFillResult &result = job->result;
+
+    if (result.cancelled) {
+        if (this->debugMode) {
+            printf("Fill cancelled after %.3f ms\n", job->readbackMs + job->fillMs);
+        }
         return;
-    };
+    }
 
-    glm::vec2 mousePositionFrameBuffer = getMousePositionFrameBuffer(window);
+    double applyStart = glfwGetTime();
 
-    if (!engine->hasLastPoint) {
-        engine->lastPoint = glm::vec2{mousePositionFrameBuffer.x, mousePositionFrameBuffer.y};
-        engine->hasLastPoint = true;
+    // The tiles the fill touched are uploaded when they are next drawn
+    this->canvas->fillSpans(result.spans, job->regionX, job->regionY, this->fillColor, this->threadPool);
+    this->layers->markDirty(this->layers->at(0).id);
 
-        // Return early as there's nothing to do.
-        // We have only just started drawing
-        return;
+    double applyMs = (glfwGetTime() - applyStart) * 1000;
+
+    if (this->debugMode) {
+        printf("Fill %zu px (%dx%d region, %s) in %.3f ms - readback %.3f ms, fill %.3f ms, apply %.3f ms\n",
+               result.numPixels, result.maxX - result.minX, result.maxY - result.minY,
+               result.parallel ? "parallel" : "scanline", job->readbackMs + job->fillMs + applyMs,
+               job->readbackMs, job->fillMs, applyMs);
     }
+}
 
-    // Compute the distance between the current position and the last point
-    auto dx = mousePositionFrameBuffer.x - engine->lastPoint.x;
-    auto dy = mousePositionFrameBuffer.y - engine->lastPoint.y;
+// save saves the strokes and sprays on the canvas to a .drawww document
+void Engine::save(const char *path) {
+    double start = glfwGetTime();
 
-    auto euclidian_distance = std::sqrt(dx * dx + dy * dy);
+    std::vector<DocumentStroke> documentStrokes;
+    documentStrokes.reserve(this->strokes.size());
 
-    if (euclidian_distance <= 0) {
-        // Nothing to interpolate
-        return;
+    size_t numSamples = 0;
+    for (auto &stroke: this->strokes) {
+        documentStrokes.push_back(DocumentStroke{stroke.first, stroke.second->radius, stroke.second->symmetry,
+                                                 &stroke.second->samples});
+        numSamples += stroke.second->samples.size();
+    }
+
+    // Baked strokes are saved from a snapshot, once it's complete
+    JournalSnapshot baked;
+    this->appendBakedStrokes(baked);
+    for (size_t i = 0; i < baked.ids.size(); i++) {
+        documentStrokes.push_back(DocumentStroke{baked.ids[i], baked.radii[i], baked.symmetries[i], &baked.samples[i]});
+        numSamples += baked.samples[i].size();
+    }
+
+    std::vector<DocumentSpray> documentSprays;
+    documentSprays.reserve(this->sprays.size());
+    for (auto &spray: this->sprays) {
+        documentSprays.push_back(DocumentSpray{spray.first, spray.second->color, &spray.second->bursts});
     }
 
-    float gapSize = 10;
-    int interpolationSteps = std::ceil(euclidian_distance / gapSize);
+    saveDocument(path, documentStrokes, documentSprays);
 
-    if (engine->debugMode) {
-        printf("Num interpolation steps => %d\n", interpolationSteps);
+    if (this->debugMode) {
+        printf("Saved %zu strokes (%zu samples) and %zu sprays to %s in %.3f ms\n", documentStrokes.size(),
+               numSamples, documentSprays.size(), path, (glfwGetTime() - start) * 1000);
     }
+}
 
-    // Perform the linear interpolation and add points accordingly
-    for (int i = 1; i <= interpolationSteps; i++) {
-        double t = double(i) / double(interpolationSteps);
+// open replaces the strokes and sprays on the canvas with those of a .drawww document.
+// Samples are decoded from the mapped document straight into each stroke's storage.
+void Engine::open(const char *path) {
+    double start = glfwGetTime();
 
-        auto pointPosX = engine->lastPoint.x + (dx * t);
-        auto pointPosY = engine->lastPoint.y + (dy * t);
+    DocumentReader reader(path);
 
-        auto pointPositionNDC = frameBufferPosToNDC(glm::vec2{pointPosX, pointPosY});
+    this->setDrawing(false);
+    this->clearStrokes();
+
+    // The canvas holds fills and baked strokes of the drawing being replaced,
+    // and shapes aren't saved with it
+    this->selection.reset();
+    this->selectionOutline.reset();
+    this->liftedStrokes.clear();
+    this->canvas->clear();
+    this->shapes.clear();
+    this->sprays.clear();
+    this->activeSpray = nullptr;
+
+    for (size_t chunk = 0; chunk < reader.chunks().size(); chunk++) {
+        DocumentChunkReader chunkReader = reader.readChunk(chunk);
+
+        for (uint32_t i = 0; i < reader.chunks()[chunk].numStrokes; i++) {
+            uint32_t id;
+            std::unique_ptr<Stroke> stroke(new Stroke(0, *this->strokeShader, this->brushRadius));
+            if (!chunkReader.next(id, stroke->radius, stroke->symmetry, stroke->samples))
+                break;
+
+            stroke->id = this->claimStrokeId(id);
+            this->trackSymmetry(stroke->symmetry);
+            stroke->rebuild();
+            stroke->seal();
+            this->addStroke(std::move(stroke));
+        }
+    }
 
-        // Add a new point at this position
-        std::unique_ptr<Point> point(new Point(pointPositionNDC.x, pointPositionNDC.y));
+    DocumentSprayReader sprayReader = reader.readSprays();
+    uint32_t sprayId, sprayColor;
+    std::vector<SprayBurst> bursts;
+    while (sprayReader.next(sprayId, sprayColor, bursts)) {
+        this->loadSpray(sprayId, sprayColor, bursts);
+    }
 
-        engine->add(std::move(point));
+    // The journal describes changes to the drawing which was just replaced
+    if (this->journal) {
+        this->compactJournal();
     }
 
-    // Set this position as the last known position in the drawing session (i.e mouse press)
-    engine->lastPoint = glm::vec2{mousePositionFrameBuffer.x, mousePositionFrameBuffer.y};
+    if (this->debugMode) {
+        printf("Opened %zu strokes (%zu samples) and %zu sprays (%zu bytes) from %s in %.3f ms\n",
+               this->strokes.size(), reader.numSamples(), this->sprays.size(), reader.size(), path,
+               (glfwGetTime() - start) * 1000);
+    }
 }
 
-// Initialises the engine
-Engine::Engine(int width, int height, const char *title) {
-    this->setRenderContext();
-    this->createWindow(width, height, title);
-    this->initOpenGL();
-    this->registerCallbacks();
+// compactJournal saves the drawing to its document on the journal's I/O
+// thread and empties the journal. Only copying the samples happens on the
+// render thread; encoding and writing the document happen in the background.
+void Engine::compactJournal() {
+    if (!this->journal) {
+        this->save(this->documentPath.c_str());
+        return;
+    }
 
-    this->setDrawing(false);
+    std::unique_ptr<JournalSnapshot> snapshot(new JournalSnapshot());
+    snapshot->ids.reserve(this->strokes.size());
+    snapshot->radii.reserve(this->strokes.size());
+    snapshot->symmetries.reserve(this->strokes.size());
+    snapshot->samples.reserve(this->strokes.size());
+
+    for (auto &stroke: this->strokes) {
+        // The active stroke is journaled once it is sealed
+        if (!stroke.second->isSealed())
+            continue;
+
+        snapshot->ids.push_back(stroke.first);
+        snapshot->radii.push_back(stroke.second->radius);
+        snapshot->symmetries.push_back(stroke.second->symmetry);
+        snapshot->samples.push_back(stroke.second->samples);
+    }
+
+    this->appendBakedStrokes(*snapshot);
+
+    for (auto &spray: this->sprays) {
+        // The active spray is journaled once it is finished
+        if (spray.second.get() == this->activeSpray)
+            continue;
+
+        snapshot->sprayIds.push_back(spray.first);
+        snapshot->sprayColors.push_back(spray.second->color);
+        snapshot->sprayBursts.push_back(spray.second->bursts);
+    }
+
+    if (this->debugMode) {
+        printf("Compacting journal (%zu bytes) into %s with %zu strokes\n", this->journal->size(),
+               this->documentPath.c_str(), snapshot->ids.size());
+    }
+
+    this->journal->compact(std::move(snapshot));
 }
 
-// Destructor to clean up heap-allocated objects
-Engine::~Engine() { this->nodes.clear(); }
+// recover rebuilds the drawing from its document and the journal of changes
+// made since, then starts journaling new changes
+void Engine::recover() {
+    std::string journalPath = this->documentPath + ".journal";
+
+    if (std::ifstream(this->documentPath).good()) {
+        try {
+            this->open(this->documentPath.c_str());
+        } catch (const std::exception &error) {
+            std::cout << "Failed to open " << this->documentPath << ": " << error.what() << std::endl;
+        }
+    }
 
-void Engine::setRenderContext() {
-#ifdef __EMSCRIPTEN__
-    this->context = RENDER_CONTEXT_WEB;
-#else
-    this->context = RENDER_CONTEXT_NATIVE;
-#endif
+    // Replay the journal tail on top of the document. Replaying a change the
+    // document already contains is a no-op, so a crash during compaction is safe.
+    size_t numReplayed = 0;
+    size_t journalLength = Journal::replay(
+        journalPath,
+        [this, &numReplayed](uint32_t id, float radius, const Symmetry &symmetry, std::vector<glm::vec2> &samples) {
+            if (this->strokes.count(id) != 0)
+                return;
+
+            std::unique_ptr<Stroke> stroke(new Stroke(this->claimStrokeId(id), *this->strokeShader, radius));
+            stroke->symmetry = symmetry;
+            this->trackSymmetry(symmetry);
+            stroke->samples.swap(samples);
+            stroke->rebuild();
+            stroke->seal();
+            this->addStroke(std::move(stroke));
+
+            numReplayed++;
+        },
+        [this, &numReplayed](uint32_t id) {
+            auto stroke = this->strokes.find(id);
+            if (stroke == this->strokes.end())
+                return;
+
+            this->geometryBytes -= stroke->second->geometryBytes();
+            this->unindexStroke(id);
+            this->strokes.erase(stroke);
+
+            numReplayed++;
+        },
+        [this, &numReplayed](uint32_t id, uint32_t color, std::vector<SprayBurst> &bursts) {
+            if (this->sprays.count(id) != 0)
+                return;
+
+            this->loadSpray(id, color, bursts);
+
+            numReplayed++;
+        });
+
+    if (this->debugMode) {
+        printf("Recovered %zu strokes, replaying %zu journal records\n", this->strokes.size(), numReplayed);
+    }
+
+    // A journal from an older version can't be appended to, so the changes it
+    // held are saved to the document before it's replaced
+    if (journalLength == 0 && numReplayed > 0) {
+        try {
+            this->save(this->documentPath.c_str());
+        } catch (const std::exception &error) {
+            std::cout << "Failed to save " << this->documentPath << ": " << error.what() << ", autosave is disabled"
+                      << std::endl;
+            return;
+        }
+    }
+
+    try {
+        this->journal.reset(new Journal(journalPath, this->documentPath, journalLength));
+    } catch (const std::exception &error) {
+        std::cout << error.what() << ", autosave is disabled" << std::endl;
+    }
 }
 
-void Engine::setDrawing(bool isDrawing) {
-    this->_isDrawing = isDrawing;
+// compactGeometry bakes the oldest strokes into the canvas and frees their
+// geometry, once the geometry of sealed strokes exceeds the budget.
+// Baked strokes are rasterized over the canvas in its offscreen frame buffer and
+// the region they cover is copied back into the canvas. Their buffers are then
+// deleted and their samples kept only for saving, in the cold store if enabled.
+void Engine::compactGeometry() {
+    double start = glfwGetTime();
+
+    size_t gpuBytesBefore, cpuBytesBefore;
+    this->measureMemory(gpuBytesBefore, cpuBytesBefore);
+
+    // Pick the oldest strokes until the geometry is back within half the budget,
+    // but only as many as fit in a single offscreen frame buffer
+    size_t remainingBytes = this->geometryBytes;
+
+    std::vector<Stroke *> baking;
+    Rect bakingBounds = Rect::empty();
+    for (auto &entry: this->strokes) {
+        if (remainingBytes <= this->geometryBudget / 2)
+            break;
+
+        Stroke *stroke = entry.second.get();
+        if (!this->canBake(stroke))
+            continue;
+
+        Rect bounds = bakingBounds;
+        bounds.expand(stroke->bounds);
+        if (bounds.max.x - bounds.min.x + 2 > CANVAS_MAX_READBACK_SIZE ||
+            bounds.max.y - bounds.min.y + 2 > CANVAS_MAX_READBACK_SIZE)
+            continue;
+
+        baking.push_back(stroke);
+        bakingBounds = bounds;
+        remainingBytes -= stroke->geometryBytes();
+    }
 
-    if (!isDrawing) {
-        // Reset last point if we are not drawing
-        this->hasLastPoint = false;
+    // Strokes off the raster layer can't be baked, so back off rather than
+    // retrying every frame
+    this->geometryCompactionThreshold = remainingBytes + (this->geometryBudget / 4);
+
+    if (baking.empty())
+        return;
+
+    this->bakeStrokes(baking, bakingBounds);
+
+    if (this->debugMode) {
+        size_t gpuBytesAfter, cpuBytesAfter;
+        this->measureMemory(gpuBytesAfter, cpuBytesAfter);
+
+        printf("Baked %zu strokes in %.3f ms - GPU %zu => %zu bytes, CPU %zu => %zu bytes, cold store %zu bytes\n",
+               baking.size(), (glfwGetTime() - start) * 1000, gpuBytesBefore, gpuBytesAfter, cpuBytesBefore,
+               cpuBytesAfter, this->coldStore ? this->coldStore->size() : size_t(0));
     }
 }
 
-bool Engine::isDrawing() {
-    return this->_isDrawing;
+// canBake indicates whether a stroke can be baked into the canvas. The canvas
+// is the bottom layer's raster, so only strokes on the bottom layer are baked,
+// and they're composited with it however it's shown later. Only strokes lying
+// entirely on the canvas fit in it, and lifted strokes are baked once they're
+// put down.
+bool Engine::canBake(const Stroke *stroke) const {
+    const Layer &bottom = this->layers->at(0);
+    Rect canvasBounds{glm::vec2{0.0f, 0.0f}, glm::vec2{float(this->canvas->width), float(this->canvas->height)}};
+    return stroke->isSealed() && stroke->layer == bottom.id && this->liftedStrokes.count(stroke->id) == 0 &&
+           !stroke->bounds.isEmpty() && canvasBounds.contains(stroke->bounds.min) &&
+           canvasBounds.contains(stroke->bounds.max);
 }
 
-// addPointAtMousePosition adds a point at the current mouse position
-void Engine::addPointAtMousePosition() {
-    glm::vec2 mousePositionNDC = getMousePositionNDC(window);
-    glm::vec2 mousePositionFrameBuffer = getMousePositionFrameBuffer(window);
+// bakeStrokes rasterizes strokes into the region of the canvas they cover and
+// frees their geometry. Their samples are kept only for saving, in the cold
+// store if enabled. The strokes must be bakeable and their bounds must fit in
+// the offscreen frame buffer.
+void Engine::bakeStrokes(const std::vector<Stroke *> &baking, const Rect &bakingBounds) {
+    // Rasterize the strokes over the region of the canvas they cover, in the
+    // order they were drawn. Canvas rows are stored bottom first.
+    int minX = std::max(0, int(std::floor(bakingBounds.min.x)));
+    int maxX = std::min(this->canvas->width, int(std::ceil(bakingBounds.max.x)));
+    int minRow = std::max(0, this->canvas->height - int(std::ceil(bakingBounds.max.y)));
+    int maxRow = std::min(this->canvas->height, this->canvas->height - int(std::floor(bakingBounds.min.y)));
+    Camera screenCamera = this->camera;
+    glm::vec2 screenViewportSize = this->viewportSize;
+
+    this->canvas->bindReadbackTarget(minX, minRow, maxX - minX, maxRow - minRow);
+    this->camera = Camera();
+    this->camera.position = glm::vec2{float(minX), float(this->canvas->height - maxRow)};
+    this->viewportSize = glm::vec2{float(maxX - minX), float(maxRow - minRow)};
 
-    // Add the mouse position as a point in the engine nodes
-    std::unique_ptr<Point> point(new Point(mousePositionNDC.x, mousePositionNDC.y));
-    this->add(std::move(point));
+    this->clearScreen();
+    this->renderReadbackCanvas();
 
-    // Set this point as the last point
-    this->lastPoint = glm::vec2{mousePositionFrameBuffer.x, mousePositionFrameBuffer.y};
-    this->hasLastPoint = true;
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    this->useStrokeShader(this->camera.viewProjection(this->viewportSize));
+    for (Stroke *stroke: baking) {
+        this->strokeShader->setFloat("pointSize", stroke->radius * 2);
+        stroke->draw();
+    }
+
+    this->camera = screenCamera;
+    this->viewportSize = screenViewportSize;
+
+    this->canvas->commitReadbackRegion(minX, minRow, maxX - minX, maxRow - minRow);
+
+    this->bindScreenTarget();
+
+    // Keep the samples of the baked strokes so they are still saved
+    std::vector<DocumentStroke> coldStrokes;
+    for (Stroke *stroke: baking) {
+        BakedStroke &baked = this->bakedStrokes[stroke->id];
+        baked.radius = stroke->radius;
+        baked.symmetry = stroke->symmetry;
+        baked.coldBlock = -1;
+        baked.samples.swap(stroke->samples);
+
+        coldStrokes.push_back(DocumentStroke{stroke->id, baked.radius, baked.symmetry, &baked.samples});
+    }
+
+    if (this->useColdStore) {
+        try {
+            if (!this->coldStore) {
+                this->coldStore.reset(new ColdStore(this->documentPath + ".cold"));
+            }
+
+            int64_t block = this->coldStore->put(coldStrokes);
+            for (const DocumentStroke &coldStroke: coldStrokes) {
+                BakedStroke &baked = this->bakedStrokes[coldStroke.id];
+                baked.coldBlock = block;
+                std::vector<glm::vec2>().swap(baked.samples);
+            }
+        } catch (const std::exception &error) {
+            std::cout << error.what() << ", keeping baked strokes in memory" << std::endl;
+        }
+    }
+
+    // Free the baked strokes' geometry
+    for (Stroke *stroke: baking) {
+        uint32_t id = stroke->id;
+
+        this->geometryBytes -= stroke->geometryBytes();
+        this->unindexStroke(id);
+        this->pendingLods.erase(id);
+        this->strokes.erase(id);
+    }
+}
+
+// appendBakedStrokes appends a copy of every baked stroke to a snapshot.
+// Strokes in the cold store are read back a block at a time.
+void Engine::appendBakedStrokes(JournalSnapshot &snapshot) {
+    std::vector<int64_t> coldBlocks;
+
+    for (auto &entry: this->bakedStrokes) {
+        const BakedStroke &baked = entry.second;
+        if (baked.coldBlock >= 0) {
+            coldBlocks.push_back(baked.coldBlock);
+            continue;
+        }
+
+        snapshot.ids.push_back(entry.first);
+        snapshot.radii.push_back(baked.radius);
+        snapshot.symmetries.push_back(baked.symmetry);
+        snapshot.samples.push_back(baked.samples);
+    }
+
+    std::sort(coldBlocks.begin(), coldBlocks.end());
+    coldBlocks.erase(std::unique(coldBlocks.begin(), coldBlocks.end()), coldBlocks.end());
+
+    for (int64_t block: coldBlocks) {
+        this->coldStore->get(uint32_t(block), [&snapshot](uint32_t id, float radius, const Symmetry &symmetry,
+                                                          std::vector<glm::vec2> &samples) {
+            snapshot.ids.push_back(id);
+            snapshot.radii.push_back(radius);
+            snapshot.symmetries.push_back(symmetry);
+            snapshot.samples.push_back(samples);
+        });
+    }
+}
+
+// measureMemory returns the number of bytes the drawing occupies on the GPU and the heap
+void Engine::measureMemory(size_t &gpuBytes, size_t &cpuBytes) {
+    gpuBytes = this->canvas->gpuBytes() + this->layers->gpuBytes();
+    if (this->selection) {
+        gpuBytes += this->selection->gpuBytes();
+    }
+    cpuBytes = this->canvas->cpuBytes();
+
+    for (auto &stroke: this->strokes) {
+        gpuBytes += stroke.second->gpuBytes();
+        cpuBytes += stroke.second->cpuBytes();
+    }
+
+    for (auto &baked: this->bakedStrokes) {
+        cpuBytes += sizeof(BakedStroke) + (baked.second.samples.capacity() * sizeof(glm::vec2));
+    }
 }
 
 // registerCallbacks registers a set of window callbacks
 void Engine::registerCallbacks() {
     glfwSetMouseButtonCallback(window, engineMouseButtonCallback);
     glfwSetCursorPosCallback(window, engineCursorPositionCallback);
+    glfwSetKeyCallback(window, engineKeyCallback);
+    glfwSetScrollCallback(window, engineScrollCallback);
 }
 
 // createWindow creates a window for the engine
 void Engine::createWindow(int width, int height, const char *title) {
     // Setup the GLFW library
     glfwInit();
+    this->startup.finish(StartupPhase::GlfwInit);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -218,6 +1699,7 @@ void Engine::createWindow(int width, int height, const char *title) {
 
     // Make the created window the GLFW current context
     glfwMakeContextCurrent(this->window);
+    this->startup.finish(StartupPhase::CreateWindow);
 }
 
 // initOpenGL intialises OpenGL
@@ -289,14 +1771,68 @@ void Engine::tick() {
     // Process input within the engine
     this->processInput();
 
+    // The spray can sprays for as long as it's held, even while the cursor is still
+    if (this->activeSpray != nullptr) {
+        this->emitSpray();
+    }
+
+    // Apply background work which has completed
+    this->threadPool.drainCompletions();
+    this->processPendingFill();
+    this->processPendingExport();
+
+    // Keep the geometry of long sessions bounded
+    if (this->geometryBytes > std::max(this->geometryBudget, this->geometryCompactionThreshold)) {
+        this->compactGeometry();
+    }
+
+    // Keep the autosave journal bounded
+    if (this->journal && this->journal->needsCompaction()) {
+        this->compactJournal();
+    }
+
+    // Render at the render scale's fraction of the frame buffer size. The camera
+    // is zoomed to match, so the same region of the canvas is shown.
+    int frameBufferWidth, frameBufferHeight;
+    glfwGetFramebufferSize(this->window, &frameBufferWidth, &frameBufferHeight);
+    this->viewportSize = glm::vec2{float(frameBufferWidth), float(frameBufferHeight)};
+
+    glm::ivec2 renderSize = this->renderScaler->bind(frameBufferWidth, frameBufferHeight);
+    Camera screenCamera = this->camera;
+    this->camera.zoom *= float(renderSize.x) / float(frameBufferWidth);
+    this->viewportSize = glm::vec2{float(renderSize.x), float(renderSize.y)};
+
     // Clear the screen
     this->clearScreen();
 
-    // Draw the objects
+    // Draw the objects, then the floating selection over them
     this->render();
+    this->renderSelection();
+
+    // Input is mapped at the frame buffer's size, so restore it before polling
+    this->camera = screenCamera;
+    this->viewportSize = glm::vec2{float(frameBufferWidth), float(frameBufferHeight)};
+    this->renderScaler->present(frameBufferWidth, frameBufferHeight);
+
+    bool firstFrame = !this->startup.isComplete();
+    if (firstFrame) {
+        this->startup.finish(StartupPhase::FirstTick);
+    }
 
-    // Swap buffers to render the draw calls
+    // Swap buffers to render the draw calls, then fence the frame to see when
+    // the GPU has finished it
+    double submitTime = glfwGetTime();
     glfwSwapBuffers(this->window);
+    this->latency->frameSubmitted(submitTime);
+
+    if (firstFrame) {
+        this->startup.finish(StartupPhase::FirstSwap);
+        this->reportFirstFrame();
+
+        if (this->exitAfterFirstFrame) {
+            glfwSetWindowShouldClose(this->window, true);
+        }
+    }
 
     // Poll for events i.e process all pending OpenGL events
     glfwPollEvents();
@@ -322,6 +1858,43 @@ int Engine::processKeyboardInput() {
         return -1;
     }
 
+    // Tool keys are ignored while a shortcut modifier is held, so shortcuts such
+    // as Ctrl+E don't also select a tool
+    if (glfwGetKey(this->window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
+        glfwGetKey(this->window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS ||
+        glfwGetKey(this->window, GLFW_KEY_LEFT_SUPER) == GLFW_PRESS ||
+        glfwGetKey(this->window, GLFW_KEY_RIGHT_SUPER) == GLFW_PRESS) {
+        return 0;
+    }
+
+    // Tool selection
+    if (glfwGetKey(this->window, GLFW_KEY_B) == GLFW_PRESS) {
+        this->setTool(Tool::Brush);
+    } else if (glfwGetKey(this->window, GLFW_KEY_E) == GLFW_PRESS) {
+        this->setTool(Tool::PixelEraser);
+    } else if (glfwGetKey(this->window, GLFW_KEY_X) == GLFW_PRESS) {
+        this->setTool(Tool::StrokeEraser);
+    } else if (glfwGetKey(this->window, GLFW_KEY_F) == GLFW_PRESS) {
+        this->setTool(Tool::Fill);
+    } else if (glfwGetKey(this->window, GLFW_KEY_L) == GLFW_PRESS) {
+        this->setTool(Tool::Line);
+    } else if (glfwGetKey(this->window, GLFW_KEY_R) == GLFW_PRESS) {
+        this->setTool(Tool::Rectangle);
+    } else if (glfwGetKey(this->window, GLFW_KEY_O) == GLFW_PRESS) {
+        this->setTool(Tool::Ellipse);
+    } else if (glfwGetKey(this->window, GLFW_KEY_U) == GLFW_PRESS) {
+        this->setTool(Tool::RoundedRectangle);
+    } else if (glfwGetKey(this->window, GLFW_KEY_A) == GLFW_PRESS) {
+        this->setTool(Tool::Spray);
+    } else if (glfwGetKey(this->window, GLFW_KEY_V) == GLFW_PRESS) {
+        this->setTool(Tool::Select);
+    }
+
+    // Cancel a long-running fill
+    if (glfwGetKey(this->window, GLFW_KEY_C) == GLFW_PRESS) {
+        this->cancelFill();
+    }
+
     return 0;
 }
 
@@ -336,21 +1909,428 @@ void Engine::add(std::unique_ptr<Drawable> node) {
     this->nodes.push_back(std::move(node));
 }
 
-// render renders the nodes in the engine's scene graph
+// render renders the canvas, the layers and the nodes in the engine's scene graph
+// into the bound frame buffer. The canvas and each layer are cached in textures
+// which are only rendered again once they change, and the layers are only
+// composited again once one of them has, so a frame in which nothing changed
+// only copies the previous composite.
 // Todo: Optimise how points are drawn, so we use a single draw call per frame.
 void Engine::render() {
+    GLint target = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+    int width = int(this->viewportSize.x);
+    int height = int(this->viewportSize.y);
+
+    // The cached textures hold the view they were rendered from, so moving the
+    // view renders them again
+    if (this->camera.position != this->layersCamera.position || this->camera.zoom != this->layersCamera.zoom ||
+        this->viewportSize != this->layersViewportSize || this->brushHardness != this->layersHardness ||
+        this->brushColor != this->layersBrushColor) {
+        this->layers->invalidate();
+        this->layersCamera = this->camera;
+        this->layersViewportSize = this->viewportSize;
+        this->layersHardness = this->brushHardness;
+        this->layersBrushColor = this->brushColor;
+    }
+
+    // What's being drawn, and the prediction ahead of it, changes every frame
+    if (this->activeStroke != nullptr || this->activeShape || this->activeSpray != nullptr) {
+        this->layers->markDirty(this->layers->at(this->activeLayer).id);
+    }
+
+    if (this->layers->isBackgroundDirty()) {
+        this->layers->bindBackground(width, height);
+        this->clearScreen();
+    }
+
+    for (size_t index = 0; index < this->layers->size(); index++) {
+        const Layer &layer = this->layers->at(index);
+        if (!layer.visible || !layer.dirty)
+            continue;
+
+        // The canvas is the bottom layer's raster, beneath its strokes
+        this->layers->bindLayer(index, width, height);
+        if (index == 0) {
+            this->renderCanvas();
+        }
+        this->renderStrokes(layer.id);
+    }
+
+    this->layers->composite(GLuint(target), width, height);
+
+    for (std::unique_ptr<Drawable> &node: this->nodes) {
+        node->draw();
+    }
+}
+
+// useStrokeShader binds the stroke shader with the brush's hardness and color,
+// drawing in the given view projection
+void Engine::useStrokeShader(const glm::mat4 &viewProjection) {
+    this->strokeShader->use();
+    this->strokeShader->setMat4("viewProjection", viewProjection);
+    this->strokeShader->setFloat("hardness", this->brushHardness);
+
+    uint32_t color = this->brushColor;
+    this->strokeShader->setVec4("strokeColor", float(color & 0xFF) / 255.0f, float((color >> 8) & 0xFF) / 255.0f,
+                                float((color >> 16) & 0xFF) / 255.0f, float(color >> 24) / 255.0f);
+}
+
+// renderStrokes renders the strokes, shapes and sprays of a layer in view.
+// Strokes outside the view are culled with the stroke bounds index, so the cost of a
+// frame depends on what is visible rather than on the size of the drawing. Each
+// stroke draws all of its stamps with a single draw call, each shape is a
+// single quad, and each spray draws all of its particles with a single draw call.
+void Engine::renderStrokes(uint32_t layer) {
+    if (this->strokes.empty() && this->shapes.empty() && !this->activeShape && this->sprays.empty())
+        return;
+
+    Rect visibleRect = this->camera.visibleRect(this->viewportSize);
+    this->visibleStrokes.clear();
+    this->strokeBoundsIndex.query(visibleRect, this->visibleStrokes);
+
+    // Draw the visible strokes in the order they were drawn
+    std::sort(this->visibleStrokes.begin(), this->visibleStrokes.end(),
+              [](const SegmentRef &a, const SegmentRef &b) { return a.strokeId < b.strokeId; });
+
+    glm::mat4 viewProjection = this->camera.viewProjection(this->viewportSize);
+
+    this->shapeShader->use();
+    this->shapeShader->setMat4("viewProjection", viewProjection);
+    this->shapeShader->setFloat("pixelSize", 1.0f / this->camera.zoom);
+
+    this->sprayShader->use();
+    this->sprayShader->setMat4("viewProjection", viewProjection);
+    this->sprayShader->setFloat("pointSize", std::max(1.0f, SPRAY_PARTICLE_SIZE * this->camera.zoom));
+
+    // Enable point rendering
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    this->useStrokeShader(viewProjection);
+
+    // Draws the visible shapes and sprays older than the given stroke ID, in the
+    // order they were drawn. Stroke uniforms are set on the bound program, so the
+    // stroke shader is bound again afterwards.
+    auto nextShape = this->shapes.begin();
+    auto nextSpray = this->sprays.begin();
+    auto drawOverlaysBefore = [this, layer, &nextShape, &nextSpray, &visibleRect](uint32_t id) {
+        bool drawn = false;
+        while (true) {
+            bool hasShape = nextShape != this->shapes.end() && nextShape->first < id;
+            bool hasSpray = nextSpray != this->sprays.end() && nextSpray->first < id;
+            if (!hasShape && !hasSpray)
+                break;
+
+            if (hasShape && (!hasSpray || nextShape->first < nextSpray->first)) {
+                if (nextShape->second->layer == layer && nextShape->second->bounds().intersects(visibleRect)) {
+                    nextShape->second->draw();
+                    drawn = true;
+                }
+                ++nextShape;
+            } else {
+                if (nextSpray->second->layer == layer && nextSpray->second->bounds.intersects(visibleRect)) {
+                    nextSpray->second->draw();
+                    drawn = true;
+                }
+                ++nextSpray;
+            }
+        }
+
+        if (drawn) {
+            this->strokeShader->use();
+        }
+    };
+
+    // Zoomed out strokes are drawn with fewer stamps. Their levels of detail are
+    // only built once they are needed, and until then they draw at full resolution.
+    int level = Stroke::lodLevel(this->camera.zoom);
+    size_t numLodBuilds = 0;
+
+    for (const SegmentRef &visible: this->visibleStrokes) {
+        auto stroke = this->strokes.find(visible.strokeId);
+        if (stroke == this->strokes.end() || stroke->second->layer != layer ||
+            this->liftedStrokes.count(visible.strokeId) != 0)
+            continue;
+
+        drawOverlaysBefore(visible.strokeId);
+
+        if (level > 0 && !stroke->second->hasLods() && numLodBuilds < LOD_BUILDS_PER_FRAME &&
+            this->pendingLods.count(visible.strokeId) == 0) {
+            this->requestLods(stroke->second.get());
+            numLodBuilds++;
+        }
+
+        this->strokeShader->setFloat("pointSize", stroke->second->radius * 2 * this->camera.zoom);
+        stroke->second->drawLevel(level);
+    }
+
+    drawOverlaysBefore(UINT32_MAX);
+
+    // The stroke being drawn is indexed once it is sealed
+    if (this->activeStroke != nullptr && this->activeStroke->layer == layer) {
+        this->strokeShader->setFloat("pointSize", this->activeStroke->radius * 2 * this->camera.zoom);
+        this->activeStroke->draw();
+
+        // Draw the predicted head from the latest sample, hiding a frame of lag
+        glm::vec2 predicted;
+        if (this->predictor.predict(this->predictionHorizonMs, glfwGetTime(), predicted)) {
+            this->predictionStroke->radius = this->activeStroke->radius;
+            this->predictionStroke->symmetry = this->activeStroke->symmetry;
+            this->predictionStroke->samples.assign({this->activeStroke->samples.back(), predicted});
+            this->predictionStroke->rebuild();
+            this->predictionStroke->draw();
+        }
+    }
+
+    // The shape being dragged out is drawn over the rest of its layer
+    if (this->activeShape && this->activeShape->layer == layer) {
+        this->activeShape->draw();
+    }
+}
+
+// renderSelection renders the floating selection and its outline over the
+// scene. Moving the selection only changes the offset it's drawn at.
+void Engine::renderSelection() {
+    if (!this->selectionOutline)
+        return;
+
+    glm::mat4 viewProjection = this->camera.viewProjection(this->viewportSize);
+
+    if (this->selection) {
+        this->canvasShader->use();
+        this->canvasShader->setMat4("viewProjection", viewProjection);
+        this->selection->draw();
+
+        // The lifted strokes are drawn over the lifted pixels at the same offset
+        if (!this->liftedStrokes.empty()) {
+            glm::mat4 offset(1.0f);
+            offset[3][0] = float(this->selection->offset.x);
+            offset[3][1] = float(this->selection->offset.y);
+
+            glEnable(GL_PROGRAM_POINT_SIZE);
+            this->useStrokeShader(viewProjection * offset);
+
+            for (uint32_t id: this->liftedStrokes) {
+                Stroke *stroke = this->strokes.at(id).get();
+                this->strokeShader->setFloat("pointSize", stroke->radius * 2 * this->camera.zoom);
+                stroke->draw();
+            }
+        }
+
+        Rect bounds = this->selection->bounds();
+        this->selectionOutline->start = bounds.min;
+        this->selectionOutline->end = bounds.max;
+    }
+
+    // The outline stays a pixel wide at any zoom
+    this->shapeShader->use();
+    this->shapeShader->setMat4("viewProjection", viewProjection);
+    this->shapeShader->setFloat("pixelSize", 1.0f / this->camera.zoom);
+    this->selectionOutline->strokeWidth = SELECTION_OUTLINE_WIDTH / this->camera.zoom;
+    this->selectionOutline->draw();
+}
+
+// requestLods starts building a sealed stroke's levels of detail on the thread pool
+void Engine::requestLods(Stroke *stroke) {
+    auto job = std::make_shared<LodJob>();
+    job->samples = stroke->samples;
+
+    uint32_t id = stroke->id;
+    this->pendingLods[id] = job;
+
+    this->threadPool.submit([job]() { Stroke::buildLods(job->samples, job->lods); }, {},
+                            [this, id, job]() { this->finishLods(id, job); });
+}
+// finishLods hands levels of detail which have been built to their stroke, on the
+// main thread. Strokes are immutable once sealed, so a build is only dropped if its
+// stroke was removed.
+void Engine::finishLods(uint32_t id, const std::shared_ptr<LodJob> &job) {
+    // The stroke may have been removed, or its ID reused, since the build started
+    auto pending = this->pendingLods.find(id);
+    if (pending == this->pendingLods.end() || pending->second != job)
+        return;
+
+    this->pendingLods.erase(pending);
+
+    auto stroke = this->strokes.find(id);
+    if (stroke == this->strokes.end())
+        return;
+
+    if (this->debugMode) {
+        printf("Stroke %u LODs => %zu", id, stroke->second->numStamps);
+        for (int level = 0; level < STROKE_LOD_LEVELS; level++) {
+            printf(" / %zu", job->lods.numStamps[level]);
+        }
+        printf(" stamps\n");
+    }
+
+    this->geometryBytes -= stroke->second->geometryBytes();
+    stroke->second->setLods(std::move(job->lods));
+    this->geometryBytes += stroke->second->geometryBytes();
+    this->layers->markDirty(stroke->second->layer);
+}
+// renderCanvas renders the canvas raster layer
+void Engine::renderCanvas() {
+    this->canvasShader->use();
+    this->canvasShader->setMat4("viewProjection", this->camera.viewProjection(this->viewportSize));
+
+    Rect visible = this->camera.visibleRect(this->viewportSize);
+    this->canvas->drawRegion(visible, this->camera.zoom);
+
+    // Page in the tiles a screen's width around the view, so panning or
+    // zooming out doesn't wait on the disk
+    this->canvas->prefetch(visible.inflated(std::max(visible.max.x - visible.min.x, visible.max.y - visible.min.y)));
+}
+
+// renderReadbackCanvas renders the canvas raster layer under the region the
+// canvas' offscreen frame buffer covers, which must be bound with the camera
+// over it. Only the tiles the region intersects are read, and the tile
+// textures of the view are left alone.
+void Engine::renderReadbackCanvas() {
+    this->canvasShader->use();
+    this->canvasShader->setMat4("viewProjection", this->camera.viewProjection(this->viewportSize));
+    this->canvas->drawReadbackRegion();
+}
+
+// readbackRegion picks the region of the canvas' pixels rendered offscreen for
+// work which needs the scene's pixels. It is the whole canvas when that fits in
+// the offscreen frame buffer, or else the largest region centered on focus.
+void Engine::readbackRegion(glm::vec2 focus, int &x, int &y, int &width, int &height) {
+    width = std::min(this->canvas->width, CANVAS_MAX_READBACK_SIZE);
+    height = std::min(this->canvas->height, CANVAS_MAX_READBACK_SIZE);
+
+    // Keep the region on the canvas. Canvas rows are stored bottom first.
+    x = std::clamp(int(std::floor(focus.x)) - (width / 2), 0, this->canvas->width - width);
+    int top = std::clamp(int(std::floor(focus.y)) - (height / 2), 0, this->canvas->height - height);
+    y = this->canvas->height - (top + height);
+}
+
+// renderToReadbackTarget renders a region of the canvas' pixels, one pixel per
+// unit, into the canvas' offscreen frame buffer and leaves it bound. Each layer,
+// the canvas included as the bottom layer's raster, is blended over the paper
+// through the layers' scratch target, so the layers' cached textures of the
+// view are kept. Layers drawn as they are over what's beneath them skip the
+// scratch target.
+void Engine::renderToReadbackTarget(int x, int y, int width, int height) {
+    glm::vec2 screenViewportSize = this->viewportSize;
+    Camera screenCamera = this->camera;
+
+    this->canvas->bindReadbackTarget(x, y, width, height);
+    GLint target = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+
+    this->viewportSize = glm::vec2{float(width), float(height)};
+    this->camera = Camera();
+    this->camera.position = glm::vec2{float(x), float(this->canvas->height - (y + height))};
+
+    this->clearScreen();
+
+    for (size_t index = 0; index < this->layers->size(); index++) {
+        const Layer &layer = this->layers->at(index);
+        if (!layer.visible || layer.opacity <= 0.0f)
+            continue;
+
+        bool direct = layer.blendMode == BlendMode::Normal && layer.opacity >= 1.0f;
+        if (!direct) {
+            this->layers->bindScratch(width, height);
+        }
+
+        if (index == 0) {
+            this->renderReadbackCanvas();
+        }
+        this->renderStrokes(layer.id);
+
+        if (!direct) {
+            this->layers->blendScratch(index, GLuint(target), width, height);
+        }
+    }
+
     for (std::unique_ptr<Drawable> &node: this->nodes) {
         node->draw();
     }
+
+    this->viewportSize = screenViewportSize;
+    this->camera = screenCamera;
+}
+
+// bindScreenTarget binds the window's frame buffer after rendering offscreen.
+// The layers' scratch targets are released, as they may be as large as the
+// whole canvas. The canvas keeps its offscreen frame buffer for the next read back.
+void Engine::bindScreenTarget() {
+    this->layers->releaseScratch();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, int(this->viewportSize.x), int(this->viewportSize.y));
 }
 
 // Terminates the window and engine
-void Engine::terminate() { glfwTerminate(); }
+void Engine::terminate() {
+    // Stop background work which would otherwise outlive the window
+    this->cancelFill();
+
+    // Seal the stroke being drawn, put down the strokes of a floating selection
+    // and flush the journal to disk
+    this->endStroke();
+    this->commitSelection();
+    this->journal.reset();
+
+    // Release GL resources while the context is still alive. An export still
+    // encoding keeps its pixels and finishes on the thread pool.
+    this->exporter.reset();
+    this->renderScaler.reset();
+    this->latency.reset();
+    this->selection.reset();
+    this->selectionOutline.reset();
+    this->canvas.reset();
+    this->layers.reset();
+
+    this->clearStrokes();
+    this->predictionStroke.reset();
+    this->shapes.clear();
+    this->activeShape.reset();
+    this->sprays.clear();
+    this->activeSpray = nullptr;
+
+    this->shaders.clear();
+    this->shapeShader = nullptr;
+    this->sprayShader = nullptr;
+    this->strokeShader = nullptr;
+    this->canvasShader = nullptr;
+    this->compositeShader = nullptr;
+
+    glfwTerminate();
+}
+
+// reportFirstFrame logs how long the engine took to present its first frame.
+// A cold start compiles every startup shader, while a warm one loads them from
+// the program binaries cached by the last launch. The time of each phase is
+// logged in debug mode, or when only the first frame is shown.
+void Engine::reportFirstFrame() {
+    const ProgramBinaryCache &binaries = this->shaders.binaryCache();
+    const char *start = binaries.numHits > 0 && this->shaders.numCompiled == 0 ? "warm" : "cold";
+    if (!binaries.isEnabled()) {
+        start = "uncached";
+    }
+
+    printf("First frame after %.1f ms (%s start, shaders %.1f ms: %zu loaded, %zu compiled, %zu rejected)\n",
+           this->startup.totalMs(), start, this->startup.phaseMs(StartupPhase::CompileShaders), binaries.numHits,
+           this->shaders.numCompiled, binaries.numRejected);
+
+    if (this->debugMode || this->exitAfterFirstFrame) {
+        printf("Startup =>");
+        for (int i = 0; i < STARTUP_NUM_PHASES; i++) {
+            StartupPhase phase = StartupPhase(i);
+            printf(" %s %.1f ms", StartupProfile::name(phase), this->startup.phaseMs(phase));
+        }
+        printf("\n");
+    }
+}
 
 // recordMetrics records metrics (e.g FPS) on each iteration of the render loop.
 void Engine::recordMetrics() {
     double now = glfwGetTime();
 
+    // Check which of the previous frames the GPU has finished
+    this->latency->poll(now);
+
     if (this->lastCheckpointTime == 0.0) {
         this->lastCheckpointTime = now;
         return;
@@ -377,16 +2357,98 @@ void Engine::recordMetrics() {
     windowTitle << this->title << " @ " << fps << " FPS — "
             << std::setprecision(3) << milliSecondsPerFrame << "ms/frame";
 
+    // Adjust the render scale to the frame time
+    this->renderScaler->update(milliSecondsPerFrame, now, this->minRenderScale, this->maxRenderScale);
+    if (this->renderScaler->scale() < 1.0f) {
+        windowTitle << " — " << int(std::lround(this->renderScaler->scale() * 100)) << "% scale";
+    }
+
 #ifndef  __EMSCRIPTEN__
     glfwSetWindowTitle(window, windowTitle.str().c_str());
 #endif
 
 
     if (this->debugMode) {
-        printf("%i FPS - %.3f ms/frame\n", fps, milliSecondsPerFrame);
+        printf("%i FPS - %.3f ms/frame - %.0f%% render scale\n", fps, milliSecondsPerFrame,
+               this->renderScaler->scale() * 100);
+
+        LatencyStats submitLatency = this->latency->submitLatency.interval();
+        LatencyStats gpuLatency = this->latency->gpuLatency.interval();
+        PredictionStats prediction = this->predictor.intervalStats();
+        if (prediction.count > 0) {
+            printf("Prediction (%.1f ms ahead, %zu samples) - mean error %.2f, max error %.2f\n",
+                   this->predictionHorizonMs, prediction.count, prediction.meanError, prediction.maxError);
+        }
+
+        if (submitLatency.count > 0) {
+            printf("Input latency (%zu events) - submit p50 %.2f ms, p99 %.2f ms - GPU complete p50 %.2f ms, "
+                   "p99 %.2f ms\n",
+                   submitLatency.count, submitLatency.p50, submitLatency.p99, gpuLatency.p50, gpuLatency.p99);
+        }
+
+        CanvasStats canvasStats = this->canvas->stats();
+        printf("Canvas tiles - %zu resident (%zu bytes), %zu compressed (%zu bytes), %zu mapped (%zu bytes), "
+               "%zu uniform, %zu empty, %zu textures\n",
+               canvasStats.numResident, canvasStats.residentBytes, canvasStats.numCompressed,
+               canvasStats.compressedBytes, canvasStats.numMapped, canvasStats.mappedBytes, canvasStats.numUniform,
+               canvasStats.numEmpty, canvasStats.numTextures);
+
+        printf("Layers - %zu layers using %zu GPU bytes - composited %zu times, skipped on %zu frames\n",
+               this->layers->size(), this->layers->gpuBytes(), this->layers->numComposites, this->layers->numSkipped);
     }
 
     // Reset the metrics for the next second
+    this->measuredFps = fps;
+    this->measuredMsPerFrame = milliSecondsPerFrame;
+    this->latency->submitLatency.resetInterval();
+    this->latency->gpuLatency.resetInterval();
+    this->predictor.resetInterval();
+
     this->numFrames = 0;
     this->lastCheckpointTime = now;
 }
+
+// exportMetrics writes the frame rate, input latency and startup metrics to a JSON file.
+// Latencies are summarised over the most recent input events of the session.
+void Engine::exportMetrics(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        throw std::runtime_error(std::string("failed to open ") + path);
+    }
+
+    auto writeLatency = [file](const char *name, const LatencyStats &stats, const char *separator) {
+        fprintf(file, "    \"%s\": {\"count\": %zu, \"p50Ms\": %.3f, \"p99Ms\": %.3f, \"maxMs\": %.3f}%s\n", name,
+                stats.count, stats.p50, stats.p99, stats.max, separator);
+    };
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"fps\": %d,\n", this->measuredFps);
+    fprintf(file, "  \"msPerFrame\": %.3f,\n", this->measuredMsPerFrame);
+    fprintf(file, "  \"renderScale\": %.2f,\n", this->renderScaler->scale());
+    fprintf(file, "  \"inputLatency\": {\n");
+    writeLatency("submit", this->latency->submitLatency.session(), ",");
+    writeLatency("gpuComplete", this->latency->gpuLatency.session(), "");
+    fprintf(file, "  },\n");
+
+    PredictionStats prediction = this->predictor.sessionStats();
+    fprintf(file, "  \"prediction\": {\"horizonMs\": %.3f, \"count\": %zu, \"meanError\": %.3f, \"maxError\": %.3f},\n",
+            this->predictionHorizonMs, prediction.count, prediction.meanError, prediction.maxError);
+
+    fprintf(file, "  \"layers\": {\"count\": %zu, \"gpuBytes\": %zu, \"composites\": %zu, \"skippedComposites\": %zu},\n",
+            this->layers->size(), this->layers->gpuBytes(), this->layers->numComposites, this->layers->numSkipped);
+
+    const ProgramBinaryCache &binaries = this->shaders.binaryCache();
+    fprintf(file, "  \"startup\": {\"firstFrameMs\": %.3f, \"phases\": ", this->startup.totalMs());
+    this->startup.writeJson(file);
+    fprintf(file, ", \"binaryCache\": %s, \"shadersLoaded\": %zu, \"shadersCompiled\": %zu}\n",
+            binaries.isEnabled() ? "true" : "false", binaries.numHits, this->shaders.numCompiled);
+    fprintf(file, "}\n");
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+        throw std::runtime_error(std::string("failed to write ") + path);
+    }
+
+    std::cout << "Exported metrics to " << path << std::endl;
+}
@@ -1,17 +1,67 @@
 #include "../vendor/glad/gl.h"
 #include "../vendor/glfw/include/GLFW/glfw3.h"
+#include "camera.h"
+#include "canvas.h"
+#include "cold_store.h"
 #include "drawable.h"
+#include "exporter.h"
+#include "flood_fill.h"
+#include "journal.h"
+#include "latency.h"
+#include "layer_stack.h"
+#include "predictor.h"
+#include "render_scale.h"
+#include "selection.h"
+#include "shader.h"
+#include "shader_cache.h"
+#include "shape.h"
+#include "spray.h"
+#include "spatial_index.h"
+#include "startup_profile.h"
+#include "stroke.h"
+#include "symmetry.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <vector>
 #include "../vendor/glm/glm/glm.hpp"
 
+// Tool describes what a mouse press does on the canvas
+enum class Tool {
+    // Brush draws strokes
+    Brush,
+    // PixelEraser cuts away the parts of strokes under the cursor
+    PixelEraser,
+    // StrokeEraser removes whole strokes touched by the cursor
+    StrokeEraser,
+    // Fill bucket fills the region under the cursor
+    Fill,
+    // Line, Rectangle, Ellipse and RoundedRectangle drag out a shape from the
+    // press to the release
+    Line,
+    Rectangle,
+    Ellipse,
+    RoundedRectangle,
+    // Spray scatters random particles around the cursor for as long as the
+    // mouse is held, like an airbrush
+    Spray,
+    // Select drags out a rectangle of the canvas' pixels, which can then be
+    // dragged elsewhere and is put down once the canvas is clicked outside it
+    Select,
+};
+
 // Engine is a rendering engine which uses a given graphics library (OpenGL by
 // default) to render graphics to the screen. The Engine primarily manages the
 // state of the main loop and the app window
 class Engine {
 public:
-    // Initialises the engine
-    Engine(int width, int height, const char *title);
+    // Initialises the engine. The canvas is the size of the frame buffer unless
+    // a canvas size is given, which may be far larger than the window.
+    Engine(int width, int height, const char *title, int canvasWidth = 0, int canvasHeight = 0);
 
     // Destructor to clean up heap-allocated objects
     ~Engine();
@@ -41,20 +91,165 @@ public:
     // isDrawing indicates whether we are currently drawing i.e is the mouse pressed.
     bool isDrawing();
 
-    // addPointAtMousePosition adds a point at the current mouse position
+    // setPanning sets whether mouse movements pan the canvas
+    void setPanning(bool isPanning);
+
+    // isPanning indicates whether mouse movements pan the canvas
+    bool isPanning();
+
+    // panTo pans the canvas so it follows the mouse to the given frame buffer position
+    void panTo(glm::vec2 position);
+
+    // zoomAt zooms the canvas by a factor about the given frame buffer position
+    void zoomAt(glm::vec2 position, float factor);
+
+    // getMousePositionCanvas returns the mouse position in canvas space
+    glm::vec2 getMousePositionCanvas();
+
+    // addPointAtMousePosition applies the active tool at the current mouse position.
+    // This starts a new stroke when drawing and erases when using an eraser.
     void addPointAtMousePosition();
 
+    // addPointAtPosition continues the active tool's draw session at the given canvas space position
+    void addPointAtPosition(glm::vec2 position);
+
+    // setTool sets the tool used when the mouse is pressed
+    void setTool(Tool tool);
+
+    // addLayer adds an empty layer above the active layer and makes it active.
+    // It returns false once the drawing has LAYER_MAX layers.
+    bool addLayer();
+
+    // selectLayer makes the layer at the given index, counted from the bottom,
+    // the one new strokes, shapes and sprays are drawn on and erasers erase from
+    void selectLayer(size_t index);
+
+    // activeLayerIndex returns the index of the active layer, counted from the bottom
+    size_t activeLayerIndex() const;
+
+    // layerAt returns the layer at the given index, counted from the bottom
+    const Layer &layerAt(size_t index) const;
+
+    // setLayerVisible, setLayerOpacity and setLayerBlendMode change how the
+    // active layer is composited
+    void setLayerVisible(bool visible);
+    void setLayerOpacity(float opacity);
+    void setLayerBlendMode(BlendMode blendMode);
+
+    // setSymmetryMode sets how new strokes are copied, about the center of the view
+    void setSymmetryMode(SymmetryMode mode);
+
+    // setSymmetryWays sets how many copies radial symmetry draws of new strokes,
+    // including the stroke itself
+    void setSymmetryWays(int ways);
+
+    // removeStroke removes a stroke from the canvas
+    void removeStroke(uint32_t id);
+
+    // fillAt starts a bucket fill of the region under the given canvas space position.
+    // The fill runs on the thread pool and is applied to the canvas once it completes.
+    void fillAt(glm::vec2 position);
+
+    // cancelFill cancels the bucket fill in progress, if any
+    void cancelFill();
+
+    // save saves the strokes on the canvas to a .drawww document
+    void save(const char *path);
+
+    // open replaces the strokes on the canvas with those of a .drawww document
+    void open(const char *path);
+
+    // compactJournal saves the drawing to its document on the journal's I/O
+    // thread and empties the journal
+    void compactJournal();
+
+    // exportPng exports the whole canvas to a PNG file. The pixels are read back
+    // over the following frames and the image is encoded on the thread pool.
+    void exportPng(const char *path);
+
+    // exportMetrics writes the frame rate, input latency and startup metrics to a JSON file
+    void exportMetrics(const char *path);
+
     // Indicates the last drawn point
     glm::vec2 lastPoint;
     bool hasLastPoint;
 
+    // The time in seconds the input event being handled was seen, so the
+    // latency of the stamps it draws can be measured
+    double inputTime;
+
     // This allows us enable debug logs
     bool debugMode;
 
+    // Whether the engine closes its window as soon as its first frame has been
+    // presented, so startup can be benchmarked by launching it in a loop
+    bool exitAfterFirstFrame;
+
+    // The radius of the brush and the erasers in pixels
+    float brushRadius;
+    float eraserRadius;
+
+    // How much of the brush's radius is solid before its edge fades, from 0 for
+    // a soft brush to 1 for a hard one. It applies to every stroke in the drawing.
+    float brushHardness;
+
+    // The color of the brush, as packed RGBA8. Like its hardness, it applies to
+    // every stroke in the drawing.
+    uint32_t brushColor;
+
+    // The symmetry new strokes are drawn with. Strokes keep the symmetry they
+    // were drawn with.
+    Symmetry symmetry;
+
+    // The color used by the fill tool, as packed RGBA8
+    uint32_t fillColor;
+
+    // The outline width and color, as packed RGBA8, of shapes drawn with the
+    // shape tools. Shapes started with shift held are filled.
+    float shapeWidth;
+    uint32_t shapeColor;
+
+    // The radius in canvas space, rate in particles per second and color, as
+    // packed RGBA8, of the spray tool
+    float sprayRadius;
+    float sprayRate;
+    uint32_t sprayColor;
+
+    // The path of the document the drawing is saved to and opened from
+    std::string documentPath;
+
+    // The directory compiled shader programs are cached in between launches,
+    // by default a per-user cache directory
+    std::string shaderCachePath;
+
+    // The number of bytes of stroke geometry kept before the oldest strokes are
+    // baked into the canvas raster layer
+    size_t geometryBudget;
+
+    // Indicates whether the vector data of baked strokes is moved to a
+    // compressed cold store on disk rather than kept in memory
+    bool useColdStore;
+
+    // The range the render scale is kept within. The scene is rendered at a
+    // fraction of the frame buffer's resolution when frames take too long.
+    float minRenderScale;
+    float maxRenderScale;
+
+    // How far ahead of the latest cursor sample the head of the stroke being
+    // drawn is predicted, and the time its velocity is smoothed over, in
+    // milliseconds. A horizon of 0 disables prediction.
+    double predictionHorizonMs;
+    double predictionSmoothingMs;
+
 private:
     // Indicates if we are currently drawing
     bool _isDrawing;
 
+    // Indicates if we are currently panning, and the frame buffer position
+    // the pan last moved to
+    bool _isPanning;
+    glm::vec2 lastPanPosition;
+
     // context describes the render context of the engine e.g web or native
     const char *context;
 
@@ -64,6 +259,22 @@ private:
     double lastCheckpointTime;
     int numFrames;
 
+    // The frame rate and frame time measured over the last second
+    int measuredFps;
+    double measuredMsPerFrame;
+
+    // startup times each phase of starting the engine, up to its first frame
+    StartupProfile startup;
+
+    // latency measures the latency from input events to the frames showing them
+    std::unique_ptr<LatencyTracker> latency;
+
+    // predictor predicts the cursor's motion, and predictionStroke draws the
+    // predicted head of the stroke being drawn. The prediction is redrawn from
+    // the latest sample each frame, so real samples replace it as they arrive.
+    MotionPredictor predictor;
+    std::unique_ptr<Stroke> predictionStroke;
+
     /**
       Engine metadata
      */
@@ -78,6 +289,330 @@ private:
     // The nodes which will be rendered in the sceene
     std::vector<std::unique_ptr<Drawable> > nodes;
 
+    /**
+      Stroke fields and methods
+    */
+    // The tool used when the mouse is pressed
+    Tool tool;
+
+    // The strokes drawn on the canvas, keyed by ID. IDs increase monotonically
+    // so iterating the map renders strokes in the order they were drawn.
+    std::map<uint32_t, std::unique_ptr<Stroke> > strokes;
+    uint32_t nextStrokeId;
+
+    // The stroke currently being drawn, if any
+    Stroke *activeStroke;
+
+    // strokeIndex indexes the segments of every stroke so tools can find what
+    // lies under the cursor without scanning every stroke
+    SpatialIndex strokeIndex;
+
+    // strokeBoundsIndex indexes the bounds of every sealed stroke, so rendering
+    // only visits the strokes in view
+    SpatialIndex strokeBoundsIndex;
+
+    // The strokes found in view by the last frame, reused across frames
+    std::vector<SegmentRef> visibleStrokes;
+
+    // The symmetries strokes have been drawn with, so erasers can find the
+    // copies of strokes by mapping the cursor back through each of them
+    std::vector<Symmetry> symmetries;
+
+    // LodJob builds the levels of detail of a sealed stroke on the thread pool
+    struct LodJob {
+        std::vector<glm::vec2> samples;
+        StrokeLods lods;
+    };
+
+    // The level of detail builds in progress, keyed by stroke ID
+    std::map<uint32_t, std::shared_ptr<LodJob> > pendingLods;
+
+    // requestLods starts building a sealed stroke's levels of detail on the thread pool
+    void requestLods(Stroke *stroke);
+
+    // finishLods hands levels of detail which have been built to their stroke
+    void finishLods(uint32_t id, const std::shared_ptr<LodJob> &job);
+
+    // The shader permutations compiled so far
+    ShaderCache shaders;
+
+    // The shader shared by every stroke, owned by the shader cache
+    Shader *strokeShader;
+
+    // The shapes drawn on the canvas, keyed by ID. Shapes take their IDs from
+    // the same sequence as strokes, so they're drawn in order with them.
+    // Like fills, they're part of the session and aren't saved to the document.
+    std::map<uint32_t, std::unique_ptr<Shape> > shapes;
+
+    // The shape being dragged out, if any, and the shader shared by every shape
+    std::unique_ptr<Shape> activeShape;
+    Shader *shapeShader;
+
+    // endShape adds the shape being dragged out to the canvas, unless it's empty
+    void endShape();
+
+    // The sprays drawn on the canvas, keyed by ID, which are ordered with strokes
+    std::map<uint32_t, std::unique_ptr<Spray> > sprays;
+
+    // The spray being drawn, if any, and the shader shared by every spray
+    Spray *activeSpray;
+    Shader *sprayShader;
+
+    // The time the active spray last emitted a burst, the fraction of a particle
+    // it has yet to emit, and the seed of the next burst. Bursts are journaled
+    // and saved with their particle counts and seeds, so a spray is drawn the
+    // same way again when it's recovered or reopened.
+    double lastSprayTime;
+    float sprayCarry;
+    uint32_t nextSpraySeed;
+
+    // emitSpray adds a burst to the active spray at the cursor, holding the
+    // particles sprayed since the last burst
+    void emitSpray();
+
+    // endSpray finishes the active spray, dropping it if it emitted nothing
+    void endSpray();
+
+    // loadSpray adds a spray read from a document or the journal to the canvas
+    void loadSpray(uint32_t id, uint32_t color, const std::vector<SprayBurst> &bursts);
+
+    // The floating selection, if any, and the outline drawn around it or around
+    // the rectangle being dragged out with the select tool
+    std::unique_ptr<Selection> selection;
+    std::unique_ptr<Shape> selectionOutline;
+
+    // The strokes lifted with the floating selection. They're hidden from their
+    // layer and drawn at the selection's offset until it's put down.
+    std::set<uint32_t> liftedStrokes;
+
+    // Whether the floating selection is being dragged, and the cursor position
+    // and offset the drag started from
+    bool movingSelection;
+    glm::vec2 selectionDragStart;
+    glm::ivec2 selectionDragOffset;
+
+    // pressSelection starts dragging the floating selection when pressed inside
+    // it, or else puts it down and starts dragging out a new one
+    void pressSelection(glm::vec2 position);
+
+    // releaseSelection finishes dragging the floating selection, or lifts the
+    // rectangle which was dragged out
+    void releaseSelection();
+
+    // liftSelection lifts the canvas' pixels and the strokes of the bottom layer
+    // under a region of canvas space into a floating selection, leaving the
+    // background behind
+    void liftSelection(const Rect &region);
+
+    // stampSelection copies the floating selection's pixels into the canvas where it lies
+    void stampSelection();
+
+    // putDownStrokes moves the strokes lifted with the floating selection to
+    // where it lies, or puts down moved copies of them
+    void putDownStrokes(bool copy);
+
+    // moveBakedStrokes moves the samples of the baked strokes lying in a region
+    // of canvas space by an offset once their pixels have been moved, or adds
+    // moved copies of them
+    void moveBakedStrokes(const Rect &region, glm::vec2 offset, bool copy);
+
+    // commitSelection puts the floating selection down, if any
+    void commitSelection();
+
+    // renderSelection renders the floating selection and its outline over the scene
+    void renderSelection();
+
+    // createStroke creates a stroke with the given samples and symmetry and adds it to the canvas
+    Stroke *createStroke(const std::vector<glm::vec2> &samples, const Symmetry &symmetry);
+
+    // translatedStroke returns an unsealed copy of a stroke with the given ID,
+    // moved by an offset in canvas space
+    std::unique_ptr<Stroke> translatedStroke(uint32_t id, const Stroke &source, glm::vec2 offset);
+
+    // trackSymmetry remembers a symmetry a stroke is drawn with, so erasers find its copies
+    void trackSymmetry(const Symmetry &symmetry);
+
+    // addStroke adds a stroke to the canvas and indexes its segments
+    Stroke *addStroke(std::unique_ptr<Stroke> stroke);
+
+    // clearStrokes removes every stroke from the canvas
+    void clearStrokes();
+
+    // claimStrokeId returns the ID a stroke or spray loaded with the given ID
+    // should use. Missing or already used IDs are replaced with a new one.
+    uint32_t claimStrokeId(uint32_t id);
+
+    // sealStroke seals a stroke and records it in the journal
+    void sealStroke(Stroke *stroke);
+
+    // journalStroke records a stroke, with the symmetry its copies are drawn with,
+    // in the journal, if any
+    void journalStroke(uint32_t id, float radius, const Symmetry &symmetry, const std::vector<glm::vec2> &samples);
+
+    // unindexStroke removes a stroke from the stroke indexes
+    void unindexStroke(uint32_t id);
+
+    /**
+      Autosave fields and methods
+    */
+    // The journal of changes made since the document was last saved
+    std::unique_ptr<Journal> journal;
+
+    // recover rebuilds the drawing from its document and the journal of changes
+    // made since, then starts journaling new changes
+    void recover();
+
+    /**
+      Geometry compaction fields and methods
+    */
+    // BakedStroke is a stroke which has been rasterized into the canvas and no
+    // longer has geometry. Its samples are kept so it is still saved with the
+    // drawing, either in memory or in the cold store.
+    struct BakedStroke {
+        float radius;
+        Symmetry symmetry;
+
+        // The cold store block holding the stroke's samples, or -1 if they are held in samples
+        int64_t coldBlock;
+        std::vector<glm::vec2> samples;
+    };
+
+    // The strokes which have been baked into the canvas, keyed by ID
+    std::map<uint32_t, BakedStroke> bakedStrokes;
+
+    // The store baked strokes' samples are moved to, created once first needed
+    std::unique_ptr<ColdStore> coldStore;
+
+    // The number of bytes of geometry held by sealed strokes, and the number
+    // past which the next compaction runs
+    size_t geometryBytes;
+    size_t geometryCompactionThreshold;
+
+    // compactGeometry bakes the oldest strokes into the canvas and frees their
+    // geometry, once the geometry of sealed strokes exceeds the budget
+    void compactGeometry();
+
+    // canBake indicates whether a stroke can be baked into the canvas
+    bool canBake(const Stroke *stroke) const;
+
+    // bakeStrokes rasterizes strokes into the region of the canvas they cover and
+    // frees their geometry
+    void bakeStrokes(const std::vector<Stroke *> &baking, const Rect &bakingBounds);
+
+    // appendBakedStrokes appends a copy of every baked stroke to a snapshot
+    void appendBakedStrokes(JournalSnapshot &snapshot);
+
+    // measureMemory returns the number of bytes the drawing occupies on the GPU and the heap
+    void measureMemory(size_t &gpuBytes, size_t &cpuBytes);
+
+    // extendStroke appends a sample to the active stroke and indexes its new segment
+    void extendStroke(glm::vec2 position);
+
+    // endStroke seals the active stroke
+    void endStroke();
+
+    // eraseAt applies the active eraser tool at the given canvas space position
+    void eraseAt(glm::vec2 position);
+
+    // eraseStrokesAt applies the active eraser tool to the strokes under the
+    // given canvas space position, or only to those drawn with a symmetry if one is given
+    void eraseStrokesAt(glm::vec2 position, const Symmetry *symmetry);
+
+    // useStrokeShader binds the stroke shader with the brush's hardness and color,
+    // drawing in the given view projection
+    void useStrokeShader(const glm::mat4 &viewProjection);
+
+    // renderStrokes renders the strokes, shapes and sprays of a layer in view
+    void renderStrokes(uint32_t layer);
+
+    /**
+      Canvas fields and methods
+    */
+    // The size of the target being rendered to in pixels
+    glm::vec2 viewportSize;
+
+    // The camera used to view the canvas
+    Camera camera;
+
+    // The raster drawn beneath the bottom layer's strokes and its shader, owned
+    // by the shader cache
+    std::unique_ptr<Canvas> canvas;
+    Shader *canvasShader;
+
+    // The drawing's layers, composited over the canvas, and the compositor's
+    // shader, owned by the shader cache
+    std::unique_ptr<LayerStack> layers;
+    Shader *compositeShader;
+
+    // The index of the layer being drawn on
+    size_t activeLayer;
+
+    // The view and brush hardness and color the cached layers were rendered
+    // with. Any change renders every layer again.
+    Camera layersCamera;
+    glm::vec2 layersViewportSize;
+    float layersHardness;
+    uint32_t layersBrushColor;
+
+    // reportLayer logs the active layer and the memory used by the layers
+    void reportLayer();
+
+    // threadPool runs CPU-heavy work such as fills off the render loop
+    ThreadPool threadPool;
+
+    // FillJob is a bucket fill running on the thread pool
+    struct FillJob {
+        // The scene read back from the canvas, used as scratch space by the fill
+        std::vector<uint32_t> pixels;
+        int width, height;
+        int seedX, seedY;
+
+        // The position of the read back region on the canvas
+        int regionX, regionY;
+
+        FloodFillResult result;
+        std::atomic<bool> cancel{false};
+        std::atomic<bool> done{false};
+
+        // Timings of the fill's stages in milliseconds
+        double readbackMs = 0;
+        double fillMs = 0;
+    };
+
+    // The bucket fill in progress, if any
+    std::shared_ptr<FillJob> pendingFill;
+
+    // processPendingFill applies the pending bucket fill to the canvas once it has completed
+    void processPendingFill();
+
+    // The PNG export in progress, if any
+    std::unique_ptr<Exporter> exporter;
+
+    // renderScaler renders frames below full resolution when the GPU can't keep up
+    std::unique_ptr<RenderScaler> renderScaler;
+
+    // processPendingExport advances the PNG export in progress and reports it once it has completed
+    void processPendingExport();
+
+    // readbackRegion picks the region of the canvas' pixels rendered offscreen for
+    // work which needs the scene's pixels. It is the whole canvas when that fits in
+    // the offscreen frame buffer, or else the largest region centered on focus.
+    void readbackRegion(glm::vec2 focus, int &x, int &y, int &width, int &height);
+
+    // renderToReadbackTarget renders a region of the canvas' pixels, one pixel per
+    // unit, into the canvas' offscreen frame buffer and leaves it bound
+    void renderToReadbackTarget(int x, int y, int width, int height);
+
+    // bindScreenTarget binds the window's frame buffer after rendering offscreen
+    void bindScreenTarget();
+
+    // renderCanvas renders the canvas raster layer
+    void renderCanvas();
+
+    // renderReadbackCanvas renders the canvas raster layer under the region the
+    // canvas' offscreen frame buffer covers
+    void renderReadbackCanvas();
+
     // createWindow creates a window for the engine
     void createWindow(int width, int height, const char *title);
 
@@ -103,6 +638,9 @@ private:
     // recordMetrics records metrics on each iteration of the render loop.
     void recordMetrics();
 
+    // reportFirstFrame logs how long the engine took to present its first frame
+    void reportFirstFrame();
+
     // runNative runs the render loop on a native platform.
     void runNative();
 };
@@ -0,0 +1,229 @@
+#include "exporter.h"
+#include "png_encoder.h"
+#include "../vendor/glfw/include/GLFW/glfw3.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// The number of rows read back per strip
+const int EXPORT_ROWS_PER_STRIP = 128;
+
+// The number of completed strips copied out of the pixel buffer objects per frame
+const size_t EXPORT_STRIPS_PER_FRAME = 4;
+
+// The most bytes of read back regions held on the GPU at once. Exports of
+// larger images wait for older regions to be copied out before reading more.
+const size_t EXPORT_MAX_PENDING_BYTES = size_t(256) * 1024 * 1024;
+
+// How long to wait for the GPU to finish reading a strip before giving up, in nanoseconds
+const GLuint64 EXPORT_WAIT_TIMEOUT_NS = 1000000000;
+
+Exporter::Exporter(ThreadPool &pool)
+    : pool(pool), nextStrip(0), pendingBytes(0), busy(false), startTime(0), readbackMs(0) {}
+
+Exporter::~Exporter() { this->releaseReadback(); }
+
+// begin starts exporting an image of the given size to path. Its pixels are
+// then read with read, all within the same frame. It returns false if an
+// export is already in progress.
+bool Exporter::begin(int width, int height, const std::string &path) {
+  if (this->busy || width <= 0 || height <= 0)
+    return false;
+
+  this->busy = true;
+  this->startTime = glfwGetTime();
+
+  this->job = std::make_shared<EncodeJob>();
+  this->job->pixels.resize(size_t(width) * height * 4);
+  this->job->width = width;
+  this->job->height = height;
+  this->job->path = path;
+
+  return true;
+}
+
+// read queues the read back of the bottom left corner of the bound read
+// frame buffer into a region of the image, with rows counted from the bottom
+void Exporter::read(int x, int y, int width, int height) {
+  if (!this->busy || width <= 0 || height <= 0)
+    return;
+
+  // Regions still held on the GPU are copied out first once they'd take up
+  // too much of its memory, so a huge image is never held there whole
+  while (this->pendingBytes > EXPORT_MAX_PENDING_BYTES && this->copyStrips(1, true) > 0) {
+  }
+
+  // Queue the read back of every strip. With a pixel pack buffer bound,
+  // glReadPixels returns immediately and the GPU copies in the background.
+  Region region{0, x, y, width, height, 0};
+  size_t rowBytes = size_t(width) * 4;
+
+  glGenBuffers(1, &(region.PBO));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, region.PBO);
+  glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(rowBytes * height), nullptr, GL_STREAM_READ);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  for (int row = 0; row < height; row += EXPORT_ROWS_PER_STRIP) {
+    int numRows = std::min(EXPORT_ROWS_PER_STRIP, height - row);
+
+    glReadPixels(0, row, width, numRows, GL_RGBA, GL_UNSIGNED_BYTE, (void *)(size_t(row) * rowBytes));
+    this->strips.push_back(Strip{this->regions.size(), row, numRows, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    region.numStrips++;
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glFlush();
+
+  this->regions.push_back(region);
+  this->pendingBytes += rowBytes * height;
+}
+
+// copyStrips copies out up to maxStrips strips, in order, and returns the
+// number copied. It stops at the first strip the GPU hasn't finished reading
+// unless told to wait for it.
+size_t Exporter::copyStrips(size_t maxStrips, bool wait) {
+  std::shared_ptr<EncodeJob> job = this->job;
+  size_t imageRowBytes = size_t(job->width) * 4;
+
+  size_t numCopied = 0;
+  while (this->nextStrip < this->strips.size() && numCopied < maxStrips) {
+    Strip &strip = this->strips[this->nextStrip];
+    Region &region = this->regions[strip.region];
+
+    GLenum status = glClientWaitSync(strip.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                     wait ? EXPORT_WAIT_TIMEOUT_NS : 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+
+    glDeleteSync(strip.fence);
+    strip.fence = nullptr;
+
+    size_t rowBytes = size_t(region.width) * 4;
+    size_t offset = size_t(strip.firstRow) * rowBytes;
+    size_t length = size_t(strip.numRows) * rowBytes;
+
+    // PNG rows are stored top first, so flip the strip while copying it
+    std::vector<uint8_t> rows(length);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, region.PBO);
+#ifdef __EMSCRIPTEN__
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, GLintptr(offset), GLsizeiptr(length), rows.data());
+#else
+    void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, GLintptr(offset), GLsizeiptr(length), GL_MAP_READ_BIT);
+    if (mapped != nullptr) {
+      std::memcpy(rows.data(), mapped, length);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+#endif
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    for (int i = 0; i < strip.numRows; i++) {
+      int destinationRow = job->height - 1 - (region.y + strip.firstRow + i);
+      std::memcpy(job->pixels.data() + (size_t(destinationRow) * imageRowBytes) + (size_t(region.x) * 4),
+                  rows.data() + (size_t(i) * rowBytes), rowBytes);
+    }
+
+    // A region's pixel buffer object is freed once its last strip is copied
+    if (--region.numStrips == 0) {
+      glDeleteBuffers(1, &(region.PBO));
+      region.PBO = 0;
+      this->pendingBytes -= rowBytes * region.height;
+    }
+
+    this->nextStrip++;
+    numCopied++;
+  }
+
+  return numCopied;
+}
+
+// update advances the export in progress. It returns true, filling in
+// stats, on the frame the export completes.
+bool Exporter::update(ExportStats &stats) {
+  if (!this->busy)
+    return false;
+
+  // Copy out completed strips, in order, without waiting on the GPU
+  if (this->nextStrip < this->strips.size()) {
+    std::shared_ptr<EncodeJob> job = this->job;
+    this->copyStrips(EXPORT_STRIPS_PER_FRAME, false);
+
+    if (this->nextStrip < this->strips.size())
+      return false;
+
+    // Every strip has been read, so encode the image in the background
+    this->readbackMs = (glfwGetTime() - this->startTime) * 1000;
+    this->releaseReadback();
+
+    // The file is written by a second task once encoding has finished, so the
+    // disk write never holds up other tasks' encoding on the pool
+    ThreadPool &pool = this->pool;
+    Task encode = this->pool.submit([job, &pool]() {
+      job->encodeStart = std::chrono::steady_clock::now();
+
+      try {
+        job->png = encodePng(job->pixels.data(), job->width, job->height, pool);
+        std::vector<uint8_t>().swap(job->pixels);
+      } catch (const std::exception &) {
+        job->failed = true;
+      }
+    });
+
+    this->pool.submit(
+        [job]() {
+          if (!job->failed) {
+            FILE *file = fopen(job->path.c_str(), "wb");
+            job->failed = file == nullptr || fwrite(job->png.data(), 1, job->png.size(), file) != job->png.size();
+            if (file != nullptr) {
+              fclose(file);
+            }
+            job->numBytes = job->png.size();
+          }
+
+          job->encodeMs =
+              std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->encodeStart).count();
+        },
+        {encode}, [job]() { job->done = true; });
+
+    return false;
+  }
+
+  if (!this->job->done)
+    return false;
+
+  stats.path = this->job->path;
+  stats.width = this->job->width;
+  stats.height = this->job->height;
+  stats.numBytes = this->job->numBytes;
+  stats.failed = this->job->failed;
+  stats.readbackMs = this->readbackMs;
+  stats.encodeMs = this->job->encodeMs;
+  stats.totalMs = (glfwGetTime() - this->startTime) * 1000;
+
+  this->job.reset();
+  this->busy = false;
+
+  return true;
+}
+
+// isBusy indicates whether an export is in progress
+bool Exporter::isBusy() const { return this->busy; }
+
+// releaseReadback deletes the pixel buffer objects and any pending fences
+void Exporter::releaseReadback() {
+  for (Strip &strip : this->strips) {
+    if (strip.fence != nullptr) {
+      glDeleteSync(strip.fence);
+    }
+  }
+  this->strips.clear();
+  this->nextStrip = 0;
+
+  for (Region &region : this->regions) {
+    if (region.PBO != 0) {
+      glDeleteBuffers(1, &(region.PBO));
+    }
+  }
+  this->regions.clear();
+  this->pendingBytes = 0;
+}
@@ -0,0 +1,116 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+#include "../vendor/glad/gl.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ExportStats describes the timings of a completed export in milliseconds
+struct ExportStats {
+  std::string path;
+  int width, height;
+  size_t numBytes;
+  bool failed;
+
+  // The time from the start of the export until the last pixels were read back
+  double readbackMs;
+  // The time spent encoding and writing the PNG on the thread pool
+  double encodeMs;
+  // The time from the start of the export until it completed
+  double totalMs;
+};
+
+// Exporter exports the scene to a PNG file without stalling the render loop.
+//
+// The image is read back in regions, so images larger than can be rendered
+// offscreen at once are exported whole. The pixels of each region are read
+// from the bound read frame buffer into a pixel buffer object in strips, each
+// followed by a fence. Later frames copy out the strips whose fences have
+// signalled, a few at a time, so neither the GPU transfer nor the copy blocks a
+// frame. Once every strip is read, the image is encoded and written on the
+// thread pool and the engine is told when it completes.
+class Exporter {
+public:
+  explicit Exporter(ThreadPool &pool);
+  ~Exporter();
+
+  // begin starts exporting an image of the given size to path. Its pixels are
+  // then read with read, all within the same frame. It returns false if an
+  // export is already in progress.
+  bool begin(int width, int height, const std::string &path);
+
+  // read queues the read back of the bottom left corner of the bound read
+  // frame buffer into a region of the image, with rows counted from the bottom
+  void read(int x, int y, int width, int height);
+
+  // update advances the export in progress. It returns true, filling in
+  // stats, on the frame the export completes.
+  bool update(ExportStats &stats);
+
+  // isBusy indicates whether an export is in progress
+  bool isBusy() const;
+
+private:
+  // Region is a region of the image read back into its own pixel buffer object
+  struct Region {
+    unsigned int PBO;
+    int x, y, width, height;
+
+    // The number of its strips not yet copied out
+    int numStrips;
+  };
+
+  // Strip is a band of rows of a region read back into its pixel buffer object
+  struct Strip {
+    size_t region;
+    int firstRow;
+    int numRows;
+    GLsync fence;
+  };
+
+  // EncodeJob is the encoding of a read back image running on the thread pool
+  struct EncodeJob {
+    std::vector<uint8_t> pixels;
+    int width, height;
+    std::string path;
+
+    std::vector<uint8_t> png;
+    std::chrono::steady_clock::time_point encodeStart;
+
+    size_t numBytes = 0;
+    double encodeMs = 0;
+    bool failed = false;
+
+    // Set on the main thread once the file has been written
+    bool done = false;
+  };
+
+  ThreadPool &pool;
+
+  std::vector<Region> regions;
+  std::vector<Strip> strips;
+  size_t nextStrip;
+
+  // The bytes of the regions whose pixel buffer objects are still held
+  size_t pendingBytes;
+
+  std::shared_ptr<EncodeJob> job;
+  bool busy;
+
+  double startTime;
+  double readbackMs;
+
+  // copyStrips copies out up to maxStrips strips, in order, and returns the
+  // number copied. It stops at the first strip the GPU hasn't finished reading
+  // unless told to wait for it.
+  size_t copyStrips(size_t maxStrips, bool wait);
+
+  // releaseReadback deletes the pixel buffer objects and any pending fences
+  void releaseReadback();
+};
+
+#endif // EXPORTER_H
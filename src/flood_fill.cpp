@@ -0,0 +1,272 @@
+#include "flood_fill.h"
+#include <algorithm>
+#include <deque>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// The number of pixels the sequential scanline fill may visit before the
+// region is considered large enough to split across the thread pool
+const size_t SEQUENTIAL_PIXEL_BUDGET = 1 << 18;
+
+// How often, in spans, the sequential fill checks for cancellation
+const size_t CANCEL_CHECK_INTERVAL = 1024;
+
+// The number of rows handed to each thread pool chunk
+const size_t ROWS_PER_CHUNK = 32;
+
+// matchMask4 compares 4 consecutive pixels against a target color and returns
+// a 4-bit mask with a bit set for each pixel which matches
+static inline unsigned matchMask4(const uint32_t *pixels, uint32_t target) {
+#if defined(__SSE2__)
+  __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+  __m128i matches = _mm_cmpeq_epi32(values, _mm_set1_epi32(int(target)));
+  return unsigned(_mm_movemask_ps(_mm_castsi128_ps(matches)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  static const uint32_t bits[4] = {1, 2, 4, 8};
+  uint32x4_t matches = vceqq_u32(vld1q_u32(pixels), vdupq_n_u32(target));
+  return vaddvq_u32(vandq_u32(matches, vld1q_u32(bits)));
+#elif defined(__wasm_simd128__)
+  v128_t matches = wasm_i32x4_eq(wasm_v128_load(pixels), wasm_i32x4_splat(int32_t(target)));
+  return wasm_i32x4_bitmask(matches);
+#else
+  return unsigned(pixels[0] == target) | (unsigned(pixels[1] == target) << 1) |
+         (unsigned(pixels[2] == target) << 2) | (unsigned(pixels[3] == target) << 3);
+#endif
+}
+
+// findMatch returns the index of the first pixel in [x, end) matching the
+// target, or end if there is none
+static int findMatch(const uint32_t *row, int x, int end, uint32_t target) {
+  for (; x + 4 <= end; x += 4) {
+    unsigned mask = matchMask4(row + x, target);
+    if (mask != 0)
+      return x + __builtin_ctz(mask);
+  }
+
+  for (; x < end; x++) {
+    if (row[x] == target)
+      return x;
+  }
+
+  return end;
+}
+
+// findMismatch returns the index of the first pixel in [x, end) which doesn't
+// match the target, or end if they all match
+static int findMismatch(const uint32_t *row, int x, int end, uint32_t target) {
+  for (; x + 4 <= end; x += 4) {
+    unsigned mask = ~matchMask4(row + x, target) & 0xF;
+    if (mask != 0)
+      return x + __builtin_ctz(mask);
+  }
+
+  for (; x < end; x++) {
+    if (row[x] != target)
+      return x;
+  }
+
+  return end;
+}
+
+// findMismatchBackward scans leftwards from x and returns the start of the run
+// of pixels in [begin, x) matching the target which ends at x
+static int findMismatchBackward(const uint32_t *row, int begin, int x, uint32_t target) {
+  for (; x - 4 >= begin; x -= 4) {
+    unsigned mask = ~matchMask4(row + x - 4, target) & 0xF;
+    if (mask != 0)
+      return x - 4 + (31 - __builtin_clz(mask)) + 1;
+  }
+
+  for (; x > begin; x--) {
+    if (row[x - 1] != target)
+      return x;
+  }
+
+  return begin;
+}
+
+// addSpan adds a span to a fill result and grows its bounding rectangle
+static void addSpan(FloodFillResult &result, int y, int x0, int x1) {
+  result.spans.push_back(FillSpan{y, x0, x1});
+  result.numPixels += size_t(x1 - x0);
+
+  result.minX = std::min(result.minX, x0);
+  result.maxX = std::max(result.maxX, x1);
+  result.minY = std::min(result.minY, y);
+  result.maxY = std::max(result.maxY, y + 1);
+}
+
+// scanlineFill walks the region with a sequential scanline fill. Visited
+// pixels are marked by overwriting them with the complement of the target.
+// It returns false, with the image restored, if the region exceeds the pixel budget.
+static bool scanlineFill(uint32_t *pixels, int width, int height, int seedX, int seedY, uint32_t target,
+                         const std::atomic<bool> &cancel, FloodFillResult &result) {
+  uint32_t marker = ~target;
+
+  struct Seed {
+    int x, y;
+  };
+  std::vector<Seed> seeds{Seed{seedX, seedY}};
+
+  while (!seeds.empty()) {
+    Seed seed = seeds.back();
+    seeds.pop_back();
+
+    uint32_t *row = pixels + (size_t(seed.y) * width);
+    if (row[seed.x] != target)
+      continue;
+
+    // Extend the span to the left and right of the seed
+    int x0 = findMismatchBackward(row, 0, seed.x, target);
+    int x1 = findMismatch(row, seed.x, width, target);
+
+    std::fill(row + x0, row + x1, marker);
+    addSpan(result, seed.y, x0, x1);
+
+    if (result.numPixels > SEQUENTIAL_PIXEL_BUDGET) {
+      for (const FillSpan &span : result.spans) {
+        std::fill(pixels + (size_t(span.y) * width) + span.x0, pixels + (size_t(span.y) * width) + span.x1, target);
+      }
+      return false;
+    }
+
+    if (result.spans.size() % CANCEL_CHECK_INTERVAL == 0 && cancel.load(std::memory_order_relaxed)) {
+      result.cancelled = true;
+      return true;
+    }
+
+    // Seed every matching run above and below the span
+    for (int y = seed.y - 1; y <= seed.y + 1; y += 2) {
+      if (y < 0 || y >= height)
+        continue;
+
+      const uint32_t *neighbour = pixels + (size_t(y) * width);
+      for (int x = findMatch(neighbour, x0, x1, target); x < x1; x = findMatch(neighbour, x, x1, target)) {
+        seeds.push_back(Seed{x, y});
+        x = findMismatch(neighbour, x, x1, target);
+      }
+    }
+  }
+
+  return true;
+}
+
+// parallelFill finds the matching runs of every row in parallel, then walks
+// the graph of overlapping runs from the seed
+static void parallelFill(const uint32_t *pixels, int width, int height, int seedX, int seedY, uint32_t target,
+                         ThreadPool &pool, const std::atomic<bool> &cancel, FloodFillResult &result) {
+  std::vector<std::vector<FillSpan> > rowRuns(height);
+
+  pool.parallelFor(size_t(height), ROWS_PER_CHUNK, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; y++) {
+      if (cancel.load(std::memory_order_relaxed))
+        return;
+
+      const uint32_t *row = pixels + (y * width);
+      std::vector<FillSpan> &runs = rowRuns[y];
+
+      for (int x = findMatch(row, 0, width, target); x < width; x = findMatch(row, x, width, target)) {
+        int runEnd = findMismatch(row, x, width, target);
+        runs.push_back(FillSpan{int(y), x, runEnd});
+        x = runEnd;
+      }
+    }
+  });
+
+  if (cancel.load()) {
+    result.cancelled = true;
+    return;
+  }
+
+  std::vector<std::vector<bool> > visited(height);
+  for (int y = 0; y < height; y++) {
+    visited[y].resize(rowRuns[y].size(), false);
+  }
+
+  // findRun returns the index of the first run in a row ending after x
+  auto findRun = [&rowRuns](int y, int x) {
+    const std::vector<FillSpan> &runs = rowRuns[y];
+    return size_t(std::upper_bound(runs.begin(), runs.end(), x,
+                                   [](int value, const FillSpan &run) { return value < run.x1; }) -
+                  runs.begin());
+  };
+
+  struct RunRef {
+    int y;
+    size_t index;
+  };
+  std::deque<RunRef> queue;
+
+  size_t seedRun = findRun(seedY, seedX);
+  visited[seedY][seedRun] = true;
+  queue.push_back(RunRef{seedY, seedRun});
+
+  while (!queue.empty()) {
+    RunRef ref = queue.front();
+    queue.pop_front();
+
+    const FillSpan &run = rowRuns[ref.y][ref.index];
+    addSpan(result, run.y, run.x0, run.x1);
+
+    if (result.spans.size() % CANCEL_CHECK_INTERVAL == 0 && cancel.load(std::memory_order_relaxed)) {
+      result.cancelled = true;
+      return;
+    }
+
+    // Visit every run above and below which overlaps this one
+    for (int y = ref.y - 1; y <= ref.y + 1; y += 2) {
+      if (y < 0 || y >= height)
+        continue;
+
+      const std::vector<FillSpan> &runs = rowRuns[y];
+      for (size_t i = findRun(y, run.x0); i < runs.size() && runs[i].x0 < run.x1; i++) {
+        if (visited[y][i])
+          continue;
+
+        visited[y][i] = true;
+        queue.push_back(RunRef{y, i});
+      }
+    }
+  }
+}
+
+// floodFill finds the 4-connected region of pixels matching the color of the
+// seed pixel in an RGBA8 image
+FloodFillResult floodFill(uint32_t *pixels, int width, int height, int seedX, int seedY, ThreadPool &pool,
+                          const std::atomic<bool> &cancel) {
+  FloodFillResult result;
+  result.minX = width;
+  result.minY = height;
+  result.maxX = 0;
+  result.maxY = 0;
+  result.numPixels = 0;
+  result.cancelled = false;
+  result.parallel = false;
+
+  if (seedX < 0 || seedY < 0 || seedX >= width || seedY >= height)
+    return result;
+
+  uint32_t target = pixels[(size_t(seedY) * width) + seedX];
+
+  if (scanlineFill(pixels, width, height, seedX, seedY, target, cancel, result))
+    return result;
+
+  // The region is large, so start over across the thread pool
+  result.spans.clear();
+  result.minX = width;
+  result.minY = height;
+  result.maxX = 0;
+  result.maxY = 0;
+  result.numPixels = 0;
+  result.parallel = true;
+
+  parallelFill(pixels, width, height, seedX, seedY, target, pool, cancel, result);
+
+  return result;
+}
@@ -0,0 +1,48 @@
+#ifndef FLOOD_FILL_H
+#define FLOOD_FILL_H
+#include "thread_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// FillSpan is a horizontal run of pixels [x0, x1) on a single row
+struct FillSpan {
+  int y;
+  int x0;
+  int x1;
+};
+
+// FloodFillResult describes the region found by a flood fill
+struct FloodFillResult {
+  // The spans which make up the filled region
+  std::vector<FillSpan> spans;
+
+  // The bounding rectangle of the region, with exclusive maximums
+  int minX, minY, maxX, maxY;
+
+  // The number of pixels in the region
+  size_t numPixels;
+
+  // Indicates whether the fill was cancelled before it completed
+  bool cancelled;
+
+  // Indicates whether the region was found by the parallel pass
+  bool parallel;
+};
+
+// floodFill finds the 4-connected region of pixels matching the color of the
+// seed pixel in an RGBA8 image.
+//
+// Small regions are walked with a scanline fill whose span comparisons use
+// SIMD. If the region grows beyond a pixel budget, the image is instead split
+// into row bands whose matching runs are found in parallel on the pool, and
+// the region is found by connecting overlapping runs, so the per-pixel work is
+// spread across every worker.
+//
+// The image is used as scratch space and is modified by the fill.
+// The fill stops early, with result.cancelled set, once cancel becomes true.
+FloodFillResult floodFill(uint32_t *pixels, int width, int height, int seedX, int seedY, ThreadPool &pool,
+                          const std::atomic<bool> &cancel);
+
+#endif // FLOOD_FILL_H
@@ -0,0 +1,351 @@
+#include "journal.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char JOURNAL_MAGIC[4] = {'D', 'R', 'W', 'J'};
+const uint16_t JOURNAL_VERSION = 2;
+
+// The first version whose strokes store their symmetry. Earlier journals hold
+// strokes in the encoding of documents which predate it.
+const uint16_t JOURNAL_VERSION_SYMMETRY = 2;
+
+const size_t JOURNAL_HEADER_SIZE = 6;
+const size_t JOURNAL_RECORD_HEADER_SIZE = 8;
+
+// How long the I/O thread gathers records before writing them as a batch
+const std::chrono::milliseconds JOURNAL_FLUSH_INTERVAL(100);
+
+// The journal is compacted once it grows past this many bytes
+const size_t JOURNAL_COMPACTION_BYTES = 8 * 1024 * 1024;
+
+// Threads are unavailable on web builds without pthreads, so records are
+// written as soon as they are appended
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define JOURNAL_INLINE_WRITES 1
+#endif
+
+// checksum computes the FNV-1a hash of a record payload
+static uint32_t checksum(const uint8_t *data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void putU32(uint8_t *out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = uint8_t(value >> (8 * i));
+  }
+}
+
+static uint32_t getU32(const uint8_t *data) {
+  return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+// beginRecord starts a record of the given type, leaving room for its header
+static std::vector<uint8_t> beginRecord(JournalRecordType type) {
+  std::vector<uint8_t> record(JOURNAL_RECORD_HEADER_SIZE);
+  record.push_back(uint8_t(type));
+  return record;
+}
+
+// endRecord fills in the header of a record once its payload is complete
+static void endRecord(std::vector<uint8_t> &record) {
+  const uint8_t *payload = record.data() + JOURNAL_RECORD_HEADER_SIZE;
+  size_t payloadSize = record.size() - JOURNAL_RECORD_HEADER_SIZE;
+
+  putU32(record.data(), uint32_t(payloadSize));
+  putU32(record.data() + 4, checksum(payload, payloadSize));
+}
+
+// writeAll writes a buffer to a file descriptor, retrying short writes
+static bool writeAll(int fd, const uint8_t *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0)
+      return false;
+
+    data += written;
+    length -= size_t(written);
+  }
+  return true;
+}
+
+// Journal opens the journal at path for appending and starts its I/O thread.
+// Anything past validLength, such as a torn record found by replay, is discarded.
+Journal::Journal(const std::string &path, const std::string &documentPath, size_t validLength)
+    : path(path), documentPath(documentPath), head(nullptr), bytes(0), compacting(false), stopping(false) {
+  this->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (this->fd < 0) {
+    throw std::runtime_error("failed to open journal: " + path);
+  }
+
+  if (validLength < JOURNAL_HEADER_SIZE) {
+    this->writeHeader();
+  } else {
+    if (ftruncate(this->fd, off_t(validLength)) != 0) {
+      close(this->fd);
+      throw std::runtime_error("failed to truncate journal: " + path);
+    }
+    this->bytes.store(validLength);
+  }
+
+#ifndef JOURNAL_INLINE_WRITES
+  this->writer = std::thread(&Journal::runWriter, this);
+#endif
+}
+
+// Writes everything still queued and stops the I/O thread
+Journal::~Journal() {
+  this->stopping.store(true);
+
+  if (this->writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+    }
+    this->wakeup.notify_one();
+    this->writer.join();
+  }
+
+  close(this->fd);
+}
+
+// writeHeader empties the journal file and writes its header
+void Journal::writeHeader() {
+  uint8_t header[JOURNAL_HEADER_SIZE];
+  std::memcpy(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  header[4] = uint8_t(JOURNAL_VERSION);
+  header[5] = uint8_t(JOURNAL_VERSION >> 8);
+
+  if (ftruncate(this->fd, 0) != 0 || !writeAll(this->fd, header, sizeof(header)) || fsync(this->fd) != 0) {
+    std::cout << "Failed to reset journal " << this->path << std::endl;
+  }
+}
+
+// appendStroke records a sealed stroke
+void Journal::appendStroke(const DocumentStroke &stroke) {
+  Item *item = new Item{nullptr, beginRecord(JournalRecordType::AddStroke), nullptr};
+  encodeStroke(item->record, stroke);
+  endRecord(item->record);
+
+  this->push(item);
+}
+
+// appendRemove records the removal of a stroke
+void Journal::appendRemove(uint32_t id) {
+  Item *item = new Item{nullptr, beginRecord(JournalRecordType::RemoveStroke), nullptr};
+  item->record.resize(item->record.size() + 4);
+  putU32(item->record.data() + item->record.size() - 4, id);
+  endRecord(item->record);
+
+  this->push(item);
+}
+
+// appendSpray records a finished spray
+void Journal::appendSpray(const DocumentSpray &spray) {
+  Item *item = new Item{nullptr, beginRecord(JournalRecordType::AddSpray), nullptr};
+  encodeSpray(item->record, spray);
+  endRecord(item->record);
+
+  this->push(item);
+}
+
+// compact saves a snapshot of the drawing as the document and empties the
+// journal. Records appended before compact are covered by the snapshot.
+void Journal::compact(std::unique_ptr<JournalSnapshot> snapshot) {
+  this->compacting.store(true);
+  this->push(new Item{nullptr, std::vector<uint8_t>(), std::move(snapshot)});
+}
+
+// needsCompaction indicates whether the journal has grown past its budget
+// and no compaction is already in progress
+bool Journal::needsCompaction() const {
+  return !this->compacting.load() && this->bytes.load() > JOURNAL_COMPACTION_BYTES;
+}
+
+// size returns the size of the journal in bytes, including queued records
+size_t Journal::size() const { return this->bytes.load(); }
+
+// push hands an item to the I/O thread
+void Journal::push(Item *item) {
+  this->bytes.fetch_add(item->record.size());
+
+#ifdef JOURNAL_INLINE_WRITES
+  this->writeBatch(item);
+#else
+  Item *head = this->head.load(std::memory_order_relaxed);
+  do {
+    item->next = head;
+  } while (!this->head.compare_exchange_weak(head, item, std::memory_order_release, std::memory_order_relaxed));
+#endif
+}
+
+// runWriter writes queued items until the journal is closed
+void Journal::runWriter() {
+  while (true) {
+    bool closing;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      closing = this->wakeup.wait_for(lock, JOURNAL_FLUSH_INTERVAL, [this]() { return this->stopping.load(); });
+    }
+
+    // Take everything queued so far. The queue is a stack, so reverse it to
+    // write items in the order they were appended.
+    Item *stack = this->head.exchange(nullptr, std::memory_order_acquire);
+    Item *batch = nullptr;
+    while (stack != nullptr) {
+      Item *next = stack->next;
+      stack->next = batch;
+      batch = stack;
+      stack = next;
+    }
+
+    if (batch != nullptr) {
+      this->writeBatch(batch);
+    }
+
+    if (closing && this->head.load() == nullptr)
+      return;
+  }
+}
+
+// writeBatch writes a batch of items in order and syncs them to disk
+void Journal::writeBatch(Item *batch) {
+  std::vector<uint8_t> buffer;
+
+  // flush writes the records gathered so far with a single fsync
+  auto flush = [this, &buffer]() {
+    if (buffer.empty())
+      return;
+
+    if (!writeAll(this->fd, buffer.data(), buffer.size()) || fsync(this->fd) != 0) {
+      std::cout << "Failed to write journal " << this->path << std::endl;
+    }
+    buffer.clear();
+  };
+
+  while (batch != nullptr) {
+    std::unique_ptr<Item> item(batch);
+    batch = batch->next;
+
+    if (!item->snapshot) {
+      buffer.insert(buffer.end(), item->record.begin(), item->record.end());
+      continue;
+    }
+
+    // Compact: the snapshot covers every record before it, so once it is saved
+    // as the document the journal can start over
+    flush();
+
+    const JournalSnapshot &snapshot = *item->snapshot;
+    std::vector<DocumentStroke> strokes;
+    strokes.reserve(snapshot.ids.size());
+    for (size_t i = 0; i < snapshot.ids.size(); i++) {
+      strokes.push_back(
+          DocumentStroke{snapshot.ids[i], snapshot.radii[i], snapshot.symmetries[i], &snapshot.samples[i]});
+    }
+
+    std::vector<DocumentSpray> sprays;
+    sprays.reserve(snapshot.sprayIds.size());
+    for (size_t i = 0; i < snapshot.sprayIds.size(); i++) {
+      sprays.push_back(DocumentSpray{snapshot.sprayIds[i], snapshot.sprayColors[i], &snapshot.sprayBursts[i]});
+    }
+
+    try {
+      saveDocument(this->documentPath.c_str(), strokes, sprays);
+
+      struct stat info;
+      size_t journalBytes = fstat(this->fd, &info) == 0 ? size_t(info.st_size) : 0;
+
+      this->writeHeader();
+      this->bytes.fetch_sub(std::min(this->bytes.load(), journalBytes - std::min(journalBytes, JOURNAL_HEADER_SIZE)));
+    } catch (const std::exception &error) {
+      std::cout << "Failed to compact journal: " << error.what() << std::endl;
+    }
+
+    this->compacting.store(false);
+  }
+
+  flush();
+}
+
+// replay reads the journal at path and calls onAdd, onRemove and onAddSpray
+// for each intact record in order. It returns the length of the intact part of
+// the journal, or 0 if there is no valid journal at path or it was written by
+// an older version, which can be replayed but not appended to.
+size_t Journal::replay(const std::string &path,
+                       const std::function<void(uint32_t id, float radius, const Symmetry &symmetry,
+                                                std::vector<glm::vec2> &samples)> &onAdd,
+                       const std::function<void(uint32_t id)> &onRemove,
+                       const std::function<void(uint32_t id, uint32_t color, std::vector<SprayBurst> &bursts)>
+                           &onAddSpray) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return 0;
+
+  std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  if (contents.size() < JOURNAL_HEADER_SIZE || std::memcmp(contents.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+    return 0;
+
+  uint16_t version = uint16_t(contents[4] | (contents[5] << 8));
+  if (version == 0 || version > JOURNAL_VERSION)
+    return 0;
+
+  uint16_t strokeVersion =
+      version >= JOURNAL_VERSION_SYMMETRY ? DOCUMENT_VERSION_SYMMETRY : DOCUMENT_VERSION_STROKE_IDS;
+
+  Symmetry symmetry;
+  std::vector<glm::vec2> samples;
+  std::vector<SprayBurst> bursts;
+  size_t offset = JOURNAL_HEADER_SIZE;
+
+  while (contents.size() - offset >= JOURNAL_RECORD_HEADER_SIZE) {
+    const uint8_t *record = contents.data() + offset;
+    size_t payloadSize = getU32(record);
+
+    // A record which runs past the end of the file or fails its checksum was
+    // torn by a crash while it was being written
+    if (payloadSize == 0 || payloadSize > contents.size() - offset - JOURNAL_RECORD_HEADER_SIZE)
+      break;
+
+    const uint8_t *payload = record + JOURNAL_RECORD_HEADER_SIZE;
+    if (checksum(payload, payloadSize) != getU32(record + 4))
+      break;
+
+    const uint8_t *data = payload + 1;
+    const uint8_t *end = payload + payloadSize;
+
+    try {
+      if (payload[0] == uint8_t(JournalRecordType::AddStroke)) {
+        uint32_t id;
+        float radius;
+        decodeStroke(data, end, strokeVersion, id, radius, symmetry, samples);
+        onAdd(id, radius, symmetry, samples);
+      } else if (payload[0] == uint8_t(JournalRecordType::RemoveStroke) && end - data >= 4) {
+        onRemove(getU32(data));
+      } else if (payload[0] == uint8_t(JournalRecordType::AddSpray)) {
+        uint32_t id, color;
+        decodeSpray(data, end, id, color, bursts);
+        onAddSpray(id, color, bursts);
+      }
+    } catch (const std::exception &) {
+      break;
+    }
+
+    offset += JOURNAL_RECORD_HEADER_SIZE + payloadSize;
+  }
+
+  // Records can't be appended to a journal of an older version
+  return version == JOURNAL_VERSION ? offset : 0;
+}
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include "document.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+  The journal is an append-only log of the changes made to a drawing since its
+  document was last saved.
+
+    header : "DRWJ" magic, u16 version
+    records: u32 payload size, u32 checksum of the payload, payload
+
+  A payload is a record type byte followed by the record. Sealed strokes are
+  stored in the document stroke encoding, finished sprays in the document
+  spray encoding and removals as a u32 stroke ID.
+  A crash can leave a torn record at the end of the journal, which replay
+  detects through its size or checksum and discards.
+*/
+
+// JournalRecordType identifies the change a journal record describes
+enum class JournalRecordType : uint8_t {
+  AddStroke = 1,
+  RemoveStroke = 2,
+  AddSpray = 3,
+};
+
+// JournalSnapshot is a copy of every stroke and spray in a drawing, taken for compaction
+struct JournalSnapshot {
+  std::vector<uint32_t> ids;
+  std::vector<float> radii;
+  std::vector<Symmetry> symmetries;
+  std::vector<std::vector<glm::vec2> > samples;
+
+  std::vector<uint32_t> sprayIds;
+  std::vector<uint32_t> sprayColors;
+  std::vector<std::vector<SprayBurst> > sprayBursts;
+};
+
+// Journal records each change to a drawing as it happens so the drawing can be
+// rebuilt after a crash. Records are handed to a background I/O thread through
+// a lock-free queue, so appending never blocks the render loop on disk I/O.
+// The I/O thread writes whatever has been queued in batches and syncs each
+// batch to disk with a single fsync.
+//
+// Compaction saves a snapshot of the drawing as its document and empties the
+// journal, which keeps the journal bounded. It also runs on the I/O thread.
+class Journal {
+public:
+  // Journal opens the journal at path for appending and starts its I/O thread.
+  // Anything past validLength, such as a torn record found by replay, is discarded.
+  Journal(const std::string &path, const std::string &documentPath, size_t validLength);
+
+  // Writes everything still queued and stops the I/O thread
+  ~Journal();
+
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  // appendStroke records a sealed stroke
+  void appendStroke(const DocumentStroke &stroke);
+
+  // appendRemove records the removal of a stroke
+  void appendRemove(uint32_t id);
+
+  // appendSpray records a finished spray
+  void appendSpray(const DocumentSpray &spray);
+
+  // compact saves a snapshot of the drawing as the document and empties the
+  // journal. Records appended before compact are covered by the snapshot.
+  void compact(std::unique_ptr<JournalSnapshot> snapshot);
+
+  // needsCompaction indicates whether the journal has grown past its budget
+  // and no compaction is already in progress
+  bool needsCompaction() const;
+
+  // size returns the size of the journal in bytes, including queued records
+  size_t size() const;
+
+  // replay reads the journal at path and calls onAdd, onRemove and onAddSpray
+  // for each intact record in order. It returns the length of the intact part of
+  // the journal, or 0 if there is no valid journal at path or it was written by
+  // an older version, which can be replayed but not appended to.
+  static size_t replay(const std::string &path,
+                       const std::function<void(uint32_t id, float radius, const Symmetry &symmetry,
+                                                std::vector<glm::vec2> &samples)> &onAdd,
+                       const std::function<void(uint32_t id)> &onRemove,
+                       const std::function<void(uint32_t id, uint32_t color, std::vector<SprayBurst> &bursts)>
+                           &onAddSpray);
+
+private:
+  // Item is an entry of the queue handed to the I/O thread. It either holds an
+  // encoded record or a snapshot to compact.
+  struct Item {
+    Item *next;
+    std::vector<uint8_t> record;
+    std::unique_ptr<JournalSnapshot> snapshot;
+  };
+
+  std::string path;
+  std::string documentPath;
+  int fd;
+
+  // The head of the lock-free queue. Producers push onto it and the I/O
+  // thread takes the whole queue at once.
+  std::atomic<Item *> head;
+
+  std::atomic<size_t> bytes;
+  std::atomic<bool> compacting;
+  std::atomic<bool> stopping;
+
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+
+  // push hands an item to the I/O thread
+  void push(Item *item);
+
+  // runWriter writes queued items until the journal is closed
+  void runWriter();
+
+  // writeBatch writes a batch of items in order and syncs them to disk
+  void writeBatch(Item *batch);
+
+  // writeHeader empties the journal file and writes its header
+  void writeHeader();
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,104 @@
+#include "latency.h"
+#include <algorithm>
+
+// The most frames whose fences are awaited at once. Older frames are dropped
+// rather than growing without bound if fences stop signalling.
+const size_t LATENCY_MAX_FRAMES = 8;
+
+// summarise returns the distribution of a set of latencies
+static LatencyStats summarise(std::vector<double> samples) {
+  if (samples.empty())
+    return LatencyStats{0, 0, 0, 0};
+
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples](double p) { return samples[size_t(p * double(samples.size() - 1))]; };
+
+  return LatencyStats{samples.size(), percentile(0.5), percentile(0.99), samples.back()};
+}
+
+LatencySamples::LatencySamples() : nextSample(0) {}
+
+// add adds a latency in milliseconds
+void LatencySamples::add(double milliseconds) {
+  this->intervalSamples.push_back(milliseconds);
+
+  if (this->sessionSamples.size() < LATENCY_MAX_SAMPLES) {
+    this->sessionSamples.push_back(milliseconds);
+  } else {
+    this->sessionSamples[this->nextSample] = milliseconds;
+    this->nextSample = (this->nextSample + 1) % LATENCY_MAX_SAMPLES;
+  }
+}
+
+// interval summarises the latencies added since the interval was last reset
+LatencyStats LatencySamples::interval() const {
+  return summarise(this->intervalSamples);
+}
+
+// session summarises the most recent latencies of the session
+LatencyStats LatencySamples::session() const {
+  return summarise(this->sessionSamples);
+}
+
+// resetInterval starts a new interval
+void LatencySamples::resetInterval() {
+  this->intervalSamples.clear();
+}
+
+LatencyTracker::LatencyTracker() {}
+
+// Cleanup
+LatencyTracker::~LatencyTracker() {
+  for (Frame &frame : this->frames) {
+    glDeleteSync(frame.fence);
+  }
+}
+
+// tagInput tags an input event, seen at inputTime in seconds, which produced a
+// stamp to be shown in the next frame
+void LatencyTracker::tagInput(double inputTime) {
+  this->taggedInputs.push_back(inputTime);
+}
+
+// frameSubmitted records the submit latency of the tagged inputs for a frame
+// submitted at submitTime, and fences the frame. It is called after the swap.
+void LatencyTracker::frameSubmitted(double submitTime) {
+  if (this->taggedInputs.empty())
+    return;
+
+  for (double inputTime : this->taggedInputs) {
+    this->submitLatency.add((submitTime - inputTime) * 1000);
+  }
+
+  if (this->frames.size() == LATENCY_MAX_FRAMES) {
+    glDeleteSync(this->frames.front().fence);
+    this->frames.pop_front();
+  }
+
+  Frame frame;
+  frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame.inputTimes.swap(this->taggedInputs);
+  this->frames.push_back(std::move(frame));
+
+  // Make sure the fence reaches the GPU, so polling it can't wait forever
+  glFlush();
+}
+
+// poll records the GPU complete latency of frames whose fences have signalled
+void LatencyTracker::poll(double now) {
+  // Frames complete in order, so stop at the first which hasn't
+  while (!this->frames.empty()) {
+    Frame &frame = this->frames.front();
+
+    GLenum status = glClientWaitSync(frame.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      return;
+
+    for (double inputTime : frame.inputTimes) {
+      this->gpuLatency.add((now - inputTime) * 1000);
+    }
+
+    glDeleteSync(frame.fence);
+    this->frames.pop_front();
+  }
+}
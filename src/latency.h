@@ -0,0 +1,88 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+#include "../vendor/glad/gl.h"
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// The number of latencies kept for the whole session's distribution
+const size_t LATENCY_MAX_SAMPLES = 8192;
+
+// LatencyStats summarises a distribution of latencies in milliseconds
+struct LatencyStats {
+  size_t count;
+  double p50;
+  double p99;
+  double max;
+};
+
+// LatencySamples collects latencies over the current interval and, up to
+// LATENCY_MAX_SAMPLES of the most recent, over the whole session
+class LatencySamples {
+public:
+  LatencySamples();
+
+  // add adds a latency in milliseconds
+  void add(double milliseconds);
+
+  // interval summarises the latencies added since the interval was last reset
+  LatencyStats interval() const;
+
+  // session summarises the most recent latencies of the session
+  LatencyStats session() const;
+
+  // resetInterval starts a new interval
+  void resetInterval();
+
+private:
+  std::vector<double> intervalSamples;
+
+  // A ring of the most recent samples
+  std::vector<double> sessionSamples;
+  size_t nextSample;
+};
+
+// LatencyTracker measures the latency from input events to the frames which
+// first show their effect.
+//
+// Input events which produced a stamp are tagged with the time they were seen.
+// When the frame showing them is submitted, the input to submit latency is
+// recorded and a fence is inserted after the swap. Once the fence has
+// signalled, the GPU has finished the frame and the input to GPU complete
+// latency is recorded. Fences are polled without waiting, once per frame, so
+// GPU complete latencies are accurate to within a frame.
+class LatencyTracker {
+public:
+  LatencyTracker();
+  ~LatencyTracker();
+
+  LatencyTracker(const LatencyTracker &) = delete;
+  LatencyTracker &operator=(const LatencyTracker &) = delete;
+
+  // tagInput tags an input event, seen at inputTime in seconds, which produced a
+  // stamp to be shown in the next frame
+  void tagInput(double inputTime);
+
+  // frameSubmitted records the submit latency of the tagged inputs for a frame
+  // submitted at submitTime, and fences the frame. It is called after the swap.
+  void frameSubmitted(double submitTime);
+
+  // poll records the GPU complete latency of frames whose fences have signalled
+  void poll(double now);
+
+  // The distributions of latencies from input to frame submit and to GPU complete
+  LatencySamples submitLatency;
+  LatencySamples gpuLatency;
+
+private:
+  // Frame is a submitted frame whose GPU completion hasn't been seen yet
+  struct Frame {
+    GLsync fence;
+    std::vector<double> inputTimes;
+  };
+
+  std::vector<double> taggedInputs;
+  std::deque<Frame> frames;
+};
+
+#endif // LATENCY_H
@@ -0,0 +1,285 @@
+#include "layer_stack.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// bindTarget binds a render target, recreating it first if it isn't the given
+// size. The target's texture is sampled one to one, so it isn't filtered.
+static void bindTarget(LayerTarget &target, int width, int height) {
+  if (target.FBO != 0 && (target.width != width || target.height != height)) {
+    glDeleteFramebuffers(1, &target.FBO);
+    glDeleteTextures(1, &target.texture);
+    target = LayerTarget{0, 0, 0, 0};
+  }
+
+  if (target.FBO == 0) {
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      throw std::runtime_error("layer frame buffer is incomplete");
+    }
+
+    target.width = width;
+    target.height = height;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+  glViewport(0, 0, width, height);
+}
+
+// releaseTarget deletes a render target
+static void releaseTarget(LayerTarget &target) {
+  if (target.FBO == 0)
+    return;
+
+  glDeleteFramebuffers(1, &target.FBO);
+  glDeleteTextures(1, &target.texture);
+  target = LayerTarget{0, 0, 0, 0};
+}
+
+// targetBytes returns the number of bytes a render target occupies on the GPU
+static size_t targetBytes(const LayerTarget &target) {
+  return size_t(target.width) * size_t(target.height) * 4;
+}
+
+// LayerStack creates a stack holding a single empty layer, with ID 0, which
+// is composited with the given shader
+LayerStack::LayerStack(Shader &shader)
+    : numComposites(0), numSkipped(0), nextId(1), background{0, 0, 0, 0}, composited{0, 0, 0, 0},
+      scratch{0, 0, 0, 0}, scratchBackdrop{0, 0, 0, 0}, backgroundDirty(true), compositeDirty(true), shader(shader) {
+  this->layers.push_back(Layer{0, true, 1.0f, BlendMode::Normal, true, LayerTarget{0, 0, 0, 0}});
+
+  // The core profile needs a vertex array bound to draw, even one without attributes
+  glGenVertexArrays(1, &(this->VAO));
+}
+
+// Cleanup
+LayerStack::~LayerStack() {
+  this->release();
+  glDeleteVertexArrays(1, &(this->VAO));
+}
+
+// add adds an empty layer above the layer at the given index and returns its
+// index. It returns -1 once the stack holds LAYER_MAX layers.
+int LayerStack::add(size_t below) {
+  if (this->layers.size() >= size_t(LAYER_MAX))
+    return -1;
+
+  size_t index = std::min(below + 1, this->layers.size());
+  this->layers.insert(this->layers.begin() + index,
+                      Layer{this->nextId++, true, 1.0f, BlendMode::Normal, true, LayerTarget{0, 0, 0, 0}});
+  this->compositeDirty = true;
+
+  return int(index);
+}
+
+// size returns the number of layers
+size_t LayerStack::size() const { return this->layers.size(); }
+
+// at returns the layer at the given index, counted from the bottom
+const Layer &LayerStack::at(size_t index) const { return this->layers.at(index); }
+
+// setVisible, setOpacity and setBlendMode change how a layer is composited
+void LayerStack::setVisible(size_t index, bool visible) {
+  this->layers.at(index).visible = visible;
+  this->compositeDirty = true;
+}
+
+void LayerStack::setOpacity(size_t index, float opacity) {
+  this->layers.at(index).opacity = std::clamp(opacity, 0.0f, 1.0f);
+  this->compositeDirty = true;
+}
+
+void LayerStack::setBlendMode(size_t index, BlendMode blendMode) {
+  this->layers.at(index).blendMode = blendMode;
+  this->compositeDirty = true;
+}
+
+// markDirty marks the layer with the given ID to be rendered again
+void LayerStack::markDirty(uint32_t id) {
+  for (Layer &layer : this->layers) {
+    if (layer.id == id) {
+      layer.dirty = true;
+      return;
+    }
+  }
+}
+
+// invalidate marks the paper and every layer to be rendered again, e.g once
+// the view has moved
+void LayerStack::invalidate() {
+  this->backgroundDirty = true;
+  for (Layer &layer : this->layers) {
+    layer.dirty = true;
+  }
+}
+
+// isBackgroundDirty indicates whether the paper needs to be rendered again
+bool LayerStack::isBackgroundDirty() const { return this->backgroundDirty; }
+
+// bindBackground binds the paper's render target at the given size, so the
+// paper can be rendered into it
+void LayerStack::bindBackground(int width, int height) {
+  bindTarget(this->background, width, height);
+  this->backgroundDirty = false;
+  this->compositeDirty = true;
+}
+
+// bindLayer binds a layer's render target at the given size and clears it to
+// transparent, so its contents can be rendered into it
+void LayerStack::bindLayer(size_t index, int width, int height) {
+  Layer &layer = this->layers.at(index);
+  bindTarget(layer.target, width, height);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  layer.dirty = false;
+  this->compositeDirty = true;
+}
+
+// composite blends the visible layers over the paper if any of them changed
+// since they were last composited, then copies the composite into the given
+// frame buffer. It returns whether the layers were composited.
+bool LayerStack::composite(unsigned int target, int width, int height) {
+  bool compositing = this->compositeDirty || this->composited.width != width || this->composited.height != height;
+
+  if (compositing) {
+    bindTarget(this->composited, width, height);
+
+    this->shader.use();
+    this->shader.setInt("background", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->background.texture);
+
+    // Pack the visible layers into the shader's texture units, bottom first
+    int numLayers = 0;
+    for (const Layer &layer : this->layers) {
+      if (!layer.visible || layer.opacity <= 0.0f)
+        continue;
+
+      std::string index = "[" + std::to_string(numLayers) + "]";
+      this->shader.setInt(("layers" + index).c_str(), numLayers + 1);
+      this->shader.setFloat(("opacity" + index).c_str(), layer.opacity);
+      this->shader.setInt(("blendMode" + index).c_str(), int(layer.blendMode));
+
+      glActiveTexture(GL_TEXTURE1 + numLayers);
+      glBindTexture(GL_TEXTURE_2D, layer.target.texture);
+      numLayers++;
+    }
+    this->shader.setInt("numLayers", numLayers);
+
+    glBindVertexArray(this->VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    for (int unit = numLayers; unit >= 0; unit--) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    this->compositeDirty = false;
+    this->numComposites++;
+  } else {
+    this->numSkipped++;
+  }
+
+  // Copy the composite into the target, which is the same size
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, this->composited.FBO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(0, 0, width, height);
+
+  return compositing;
+}
+
+// bindScratch binds the scratch target at the given size and clears it to
+// transparent, so a layer's contents can be rendered into it offscreen
+// without touching the layer's cached texture
+void LayerStack::bindScratch(int width, int height) {
+  bindTarget(this->scratch, width, height);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+// blendScratch blends the scratch target, holding the contents of the layer
+// at the given index, over the given frame buffer of the same size with the
+// layer's opacity and blend mode, and leaves that frame buffer bound
+void LayerStack::blendScratch(size_t index, unsigned int target, int width, int height) {
+  const Layer &layer = this->layers.at(index);
+
+  // Copy what the layer is blended over, then composite it back into the target
+  bindTarget(this->scratchBackdrop, width, height);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(0, 0, width, height);
+
+  this->shader.use();
+  this->shader.setInt("background", 0);
+  this->shader.setInt("layers[0]", 1);
+  this->shader.setFloat("opacity[0]", layer.opacity);
+  this->shader.setInt("blendMode[0]", int(layer.blendMode));
+  this->shader.setInt("numLayers", 1);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, this->scratchBackdrop.texture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, this->scratch.texture);
+
+  glBindVertexArray(this->VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// releaseScratch deletes the scratch targets, e.g after rendering a large
+// region offscreen
+void LayerStack::releaseScratch() {
+  releaseTarget(this->scratch);
+  releaseTarget(this->scratchBackdrop);
+}
+
+// release deletes every render target. Targets are created again once
+// they're next rendered into.
+void LayerStack::release() {
+  this->releaseScratch();
+  releaseTarget(this->background);
+  releaseTarget(this->composited);
+  for (Layer &layer : this->layers) {
+    releaseTarget(layer.target);
+  }
+
+  this->invalidate();
+  this->compositeDirty = true;
+}
+
+// gpuBytes returns the number of bytes the render targets occupy on the GPU
+size_t LayerStack::gpuBytes() const {
+  size_t bytes = targetBytes(this->background) + targetBytes(this->composited) + targetBytes(this->scratch) +
+                 targetBytes(this->scratchBackdrop);
+  for (const Layer &layer : this->layers) {
+    bytes += targetBytes(layer.target);
+  }
+
+  return bytes;
+}
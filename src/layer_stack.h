@@ -0,0 +1,157 @@
+#ifndef LAYER_STACK_H
+#define LAYER_STACK_H
+#include "shader.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The most layers a drawing can have. The compositor blends every layer in a
+// single pass, sampling each from its own texture unit.
+const int LAYER_MAX = 8;
+
+// BlendMode is how a layer's colors mix with the colors beneath it. The values
+// match the BLEND_ constants of the composite shader.
+enum class BlendMode {
+  Normal = 0,
+  Multiply = 1,
+  Screen = 2,
+  Overlay = 3,
+};
+
+// The number of blend modes
+const int BLEND_MODE_COUNT = 4;
+
+// LayerTarget is an offscreen frame buffer with a texture the size of the view
+struct LayerTarget {
+  unsigned int FBO, texture;
+  int width, height;
+};
+
+// Layer is a group of strokes, shapes and sprays which is rendered and blended
+// as one. Its contents are cached in a texture, rendered with premultiplied
+// alpha over transparency.
+struct Layer {
+  // The identifier strokes, shapes and sprays refer to their layer by
+  uint32_t id;
+
+  bool visible;
+  float opacity;
+  BlendMode blendMode;
+
+  // Whether the layer's contents have changed since its texture was rendered
+  bool dirty;
+
+  LayerTarget target;
+};
+
+// LayerStack holds a drawing's layers, bottom first, and composites them over
+// the paper. The bottom layer's raster is the canvas, rendered beneath its
+// strokes, so fills and baked strokes are shown with the bottom layer.
+//
+// The paper and each layer are rendered into cached textures, which are only
+// rendered again once they change, e.g when a stroke is added to the layer or
+// the view moves. The compositor then blends the visible layers over the
+// paper in a single pass, with their opacity and blend mode, into a cached
+// composite. Frames in which nothing changed skip composition and only copy
+// the previous composite.
+class LayerStack {
+public:
+  // LayerStack creates a stack holding a single empty layer, with ID 0, which
+  // is composited with the given shader
+  explicit LayerStack(Shader &shader);
+  ~LayerStack();
+
+  LayerStack(const LayerStack &) = delete;
+  LayerStack &operator=(const LayerStack &) = delete;
+
+  // add adds an empty layer above the layer at the given index and returns its
+  // index. It returns -1 once the stack holds LAYER_MAX layers.
+  int add(size_t below);
+
+  // size returns the number of layers
+  size_t size() const;
+
+  // at returns the layer at the given index, counted from the bottom
+  const Layer &at(size_t index) const;
+
+  // setVisible, setOpacity and setBlendMode change how a layer is composited
+  void setVisible(size_t index, bool visible);
+  void setOpacity(size_t index, float opacity);
+  void setBlendMode(size_t index, BlendMode blendMode);
+
+  // markDirty marks the layer with the given ID to be rendered again
+  void markDirty(uint32_t id);
+
+  // invalidate marks the paper and every layer to be rendered again, e.g once
+  // the view has moved
+  void invalidate();
+
+  // isBackgroundDirty indicates whether the paper needs to be rendered again
+  bool isBackgroundDirty() const;
+
+  // bindBackground binds the paper's render target at the given size, so the
+  // paper can be rendered into it
+  void bindBackground(int width, int height);
+
+  // bindLayer binds a layer's render target at the given size and clears it to
+  // transparent, so its contents can be rendered into it
+  void bindLayer(size_t index, int width, int height);
+
+  // composite blends the visible layers over the paper if any of them changed
+  // since they were last composited, then copies the composite into the given
+  // frame buffer. It returns whether the layers were composited.
+  bool composite(unsigned int target, int width, int height);
+
+  // bindScratch binds the scratch target at the given size and clears it to
+  // transparent, so a layer's contents can be rendered into it offscreen
+  // without touching the layer's cached texture
+  void bindScratch(int width, int height);
+
+  // blendScratch blends the scratch target, holding the contents of the layer
+  // at the given index, over the given frame buffer of the same size with the
+  // layer's opacity and blend mode, and leaves that frame buffer bound
+  void blendScratch(size_t index, unsigned int target, int width, int height);
+
+  // releaseScratch deletes the scratch targets, e.g after rendering a large
+  // region offscreen
+  void releaseScratch();
+
+  // release deletes every render target. Targets are created again once
+  // they're next rendered into.
+  void release();
+
+  // gpuBytes returns the number of bytes the render targets occupy on the GPU
+  size_t gpuBytes() const;
+
+  // The number of times the layers were composited, and the number of frames
+  // composition was skipped because nothing had changed
+  size_t numComposites;
+  size_t numSkipped;
+
+private:
+  std::vector<Layer> layers;
+  uint32_t nextId;
+
+  // The render targets of the paper and of the composite
+  LayerTarget background;
+  LayerTarget composited;
+
+  // The render targets regions rendered offscreen go through: a layer's
+  // contents, and a copy of what it's blended over, as the compositor can't
+  // read from the frame buffer it draws into. They're the same however many
+  // layers there are, and never disturb the cached textures of the view.
+  LayerTarget scratch;
+  LayerTarget scratchBackdrop;
+
+  // Whether the paper needs to be rendered again, and whether the layers need
+  // to be composited again
+  bool backgroundDirty;
+  bool compositeDirty;
+
+  // Shader internals. The compositor's triangle is generated from the vertex
+  // ID, so its vertex array has no buffers.
+  Shader &shader;
+  unsigned int VAO;
+};
+
+#endif // LAYER_STACK_H
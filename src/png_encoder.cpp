@@ -0,0 +1,174 @@
+#include "png_encoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+// The number of rows deflated together as an independent band
+const int PNG_ROWS_PER_BAND = 64;
+
+const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+const uint8_t PNG_FILTER_NONE = 0;
+const uint8_t PNG_FILTER_SUB = 1;
+const uint8_t PNG_FILTER_UP = 2;
+
+// CompressedBand is a band of rows deflated independently of the others
+struct CompressedBand {
+  std::vector<uint8_t> data;
+  uLong adler;
+  uLong rawSize;
+};
+
+static void putU32BE(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(uint8_t(value >> 24));
+  out.push_back(uint8_t(value >> 16));
+  out.push_back(uint8_t(value >> 8));
+  out.push_back(uint8_t(value));
+}
+
+// putChunk appends a PNG chunk with its length and CRC to out
+static void putChunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t length) {
+  putU32BE(out, uint32_t(length));
+
+  size_t typeOffset = out.size();
+  out.insert(out.end(), type, type + 4);
+  if (length > 0) {
+    out.insert(out.end(), data, data + length);
+  }
+
+  uLong crc = crc32(0L, out.data() + typeOffset, uInt(length + 4));
+  putU32BE(out, uint32_t(crc));
+}
+
+// filterRow writes a row prefixed with the filter which leaves it with the
+// smallest sum of absolute residuals, a cheap estimate of how well it will compress
+static void filterRow(const uint8_t *row, const uint8_t *previousRow, size_t rowBytes, uint8_t *out) {
+  const size_t bytesPerPixel = 4;
+
+  uint64_t sumNone = 0, sumSub = 0, sumUp = 0;
+  for (size_t i = 0; i < rowBytes; i++) {
+    uint8_t left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+    uint8_t up = previousRow != nullptr ? previousRow[i] : 0;
+
+    sumNone += std::abs(int8_t(row[i]));
+    sumSub += std::abs(int8_t(uint8_t(row[i] - left)));
+    sumUp += std::abs(int8_t(uint8_t(row[i] - up)));
+  }
+
+  uint8_t filter = PNG_FILTER_NONE;
+  if (sumSub <= sumNone && sumSub <= sumUp) {
+    filter = PNG_FILTER_SUB;
+  } else if (sumUp < sumNone) {
+    filter = PNG_FILTER_UP;
+  }
+
+  out[0] = filter;
+  for (size_t i = 0; i < rowBytes; i++) {
+    uint8_t left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+    uint8_t up = previousRow != nullptr ? previousRow[i] : 0;
+
+    if (filter == PNG_FILTER_SUB) {
+      out[i + 1] = uint8_t(row[i] - left);
+    } else if (filter == PNG_FILTER_UP) {
+      out[i + 1] = uint8_t(row[i] - up);
+    } else {
+      out[i + 1] = row[i];
+    }
+  }
+}
+
+// compressBand filters and deflates a band of rows as a raw deflate stream.
+// Every band but the last ends on a full flush, so the next band's stream can
+// be appended to it directly.
+static CompressedBand compressBand(const uint8_t *pixels, int width, int firstRow, int lastRow, bool isLast) {
+  size_t rowBytes = size_t(width) * 4;
+  size_t filteredRowBytes = rowBytes + 1;
+
+  std::vector<uint8_t> filtered(filteredRowBytes * size_t(lastRow - firstRow));
+  for (int y = firstRow; y < lastRow; y++) {
+    const uint8_t *row = pixels + (size_t(y) * rowBytes);
+    const uint8_t *previousRow = y > 0 ? row - rowBytes : nullptr;
+
+    filterRow(row, previousRow, rowBytes, filtered.data() + (size_t(y - firstRow) * filteredRowBytes));
+  }
+
+  CompressedBand band;
+  band.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(), uInt(filtered.size()));
+  band.rawSize = uLong(filtered.size());
+
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("failed to initialise deflate");
+  }
+
+  band.data.resize(deflateBound(&stream, uLong(filtered.size())) + 16);
+
+  stream.next_in = filtered.data();
+  stream.avail_in = uInt(filtered.size());
+  stream.next_out = band.data.data();
+  stream.avail_out = uInt(band.data.size());
+
+  int status = deflate(&stream, isLast ? Z_FINISH : Z_FULL_FLUSH);
+  bool ok = isLast ? status == Z_STREAM_END : status == Z_OK;
+
+  band.data.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (!ok) {
+    throw std::runtime_error("failed to deflate PNG band");
+  }
+
+  return band;
+}
+
+// encodePng encodes an RGBA8 image, stored top row first, as a PNG file
+std::vector<uint8_t> encodePng(const uint8_t *pixels, int width, int height, ThreadPool &pool) {
+  if (width <= 0 || height <= 0) {
+    throw std::runtime_error("cannot encode an empty image");
+  }
+
+  int numBands = (height + PNG_ROWS_PER_BAND - 1) / PNG_ROWS_PER_BAND;
+  std::vector<CompressedBand> bands(numBands);
+
+  pool.parallelFor(size_t(numBands), 1, [&](size_t begin, size_t end) {
+    for (size_t band = begin; band < end; band++) {
+      int firstRow = int(band) * PNG_ROWS_PER_BAND;
+      int lastRow = std::min(firstRow + PNG_ROWS_PER_BAND, height);
+
+      bands[band] = compressBand(pixels, width, firstRow, lastRow, int(band) == numBands - 1);
+    }
+  });
+
+  // Stitch the bands into a single zlib stream
+  std::vector<uint8_t> idat;
+  idat.push_back(0x78);
+  idat.push_back(0x9C);
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (const CompressedBand &band : bands) {
+    idat.insert(idat.end(), band.data.begin(), band.data.end());
+    adler = adler32_combine(adler, band.adler, band.rawSize);
+  }
+  putU32BE(idat, uint32_t(adler));
+
+  // IHDR: 8-bit RGBA, no interlacing
+  std::vector<uint8_t> header;
+  putU32BE(header, uint32_t(width));
+  putU32BE(header, uint32_t(height));
+  header.push_back(8);
+  header.push_back(6);
+  header.push_back(0);
+  header.push_back(0);
+  header.push_back(0);
+
+  std::vector<uint8_t> png(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+  png.reserve(idat.size() + 64);
+  putChunk(png, "IHDR", header.data(), header.size());
+  putChunk(png, "IDAT", idat.data(), idat.size());
+  putChunk(png, "IEND", nullptr, 0);
+
+  return png;
+}
@@ -0,0 +1,16 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// encodePng encodes an RGBA8 image, stored top row first, as a PNG file.
+//
+// The image is split into bands of rows which are filtered and deflated in
+// parallel on the pool. Each band is compressed as an independent deflate
+// stream ending on a byte-aligned full flush, so the bands concatenate into a
+// single valid zlib stream whose checksum is combined from the bands'.
+std::vector<uint8_t> encodePng(const uint8_t *pixels, int width, int height, ThreadPool &pool);
+
+#endif // PNG_ENCODER_H
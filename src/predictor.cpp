@@ -0,0 +1,90 @@
+#include "predictor.h"
+#include <algorithm>
+#include <cmath>
+
+// Samples closer together than this are treated as this far apart in seconds,
+// so a burst of events doesn't produce huge instantaneous velocities
+const double PREDICTOR_MIN_SAMPLE_INTERVAL = 0.001;
+
+// The time in seconds after the latest sample beyond which the cursor is
+// assumed to have stopped, and nothing is predicted
+const double PREDICTOR_MAX_IDLE = 0.05;
+
+// Samples further apart than this in seconds start the velocity afresh, and
+// aren't used to measure the error
+const double PREDICTOR_MAX_SAMPLE_INTERVAL = 0.1;
+
+MotionPredictor::MotionPredictor()
+    : position(0.0f, 0.0f), time(0.0), velocity(0.0f, 0.0f), numSamples(0), interval{0, 0, 0}, session{0, 0, 0} {}
+
+// reset forgets the samples of the previous stroke
+void MotionPredictor::reset() {
+  this->velocity = glm::vec2{0.0f, 0.0f};
+  this->numSamples = 0;
+}
+
+// addSample adds a cursor sample seen at time in seconds, smoothing the
+// velocity over smoothingMs
+void MotionPredictor::addSample(glm::vec2 position, double time, double smoothingMs) {
+  if (this->numSamples > 0) {
+    double elapsed = time - this->time;
+
+    if (elapsed > PREDICTOR_MAX_SAMPLE_INTERVAL) {
+      this->velocity = glm::vec2{0.0f, 0.0f};
+    } else {
+      // Measure how far the last prediction was from where the cursor went
+      if (this->numSamples > 1) {
+        glm::vec2 predicted = this->position + (this->velocity * float(elapsed));
+        this->interval.add(double(glm::length(position - predicted)));
+        this->session.add(double(glm::length(position - predicted)));
+      }
+
+      double dt = std::max(elapsed, PREDICTOR_MIN_SAMPLE_INTERVAL);
+      glm::vec2 instantVelocity = (position - this->position) / float(dt);
+
+      // Weigh the new velocity by how much time it covers
+      float weight = smoothingMs > 0 ? float(1.0 - std::exp(-(dt * 1000) / smoothingMs)) : 1.0f;
+      this->velocity += (instantVelocity - this->velocity) * (this->numSamples == 1 ? 1.0f : weight);
+    }
+  }
+
+  this->position = position;
+  this->time = time;
+  this->numSamples++;
+}
+
+// predict predicts the cursor's position horizonMs after the latest sample.
+// It returns false if there is nothing to predict, e.g. once the cursor has
+// stopped moving and no samples have arrived for a while.
+bool MotionPredictor::predict(double horizonMs, double now, glm::vec2 &predicted) const {
+  if (horizonMs <= 0 || this->numSamples < 2 || now - this->time > PREDICTOR_MAX_IDLE)
+    return false;
+
+  predicted = this->position + (this->velocity * float(horizonMs / 1000));
+  return true;
+}
+
+// intervalStats describes the prediction error since resetInterval was last called
+PredictionStats MotionPredictor::intervalStats() const {
+  return this->interval.stats();
+}
+
+// sessionStats describes the prediction error over the whole session
+PredictionStats MotionPredictor::sessionStats() const {
+  return this->session.stats();
+}
+
+// resetInterval starts a new interval of prediction error statistics
+void MotionPredictor::resetInterval() {
+  this->interval = ErrorTotals{0, 0, 0};
+}
+
+void MotionPredictor::ErrorTotals::add(double error) {
+  this->count++;
+  this->sum += error;
+  this->max = std::max(this->max, error);
+}
+
+PredictionStats MotionPredictor::ErrorTotals::stats() const {
+  return PredictionStats{this->count, this->count > 0 ? this->sum / double(this->count) : 0.0, this->max};
+}
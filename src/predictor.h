@@ -0,0 +1,75 @@
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+#include "../vendor/glm/glm/glm.hpp"
+#include <cstddef>
+
+// The default time ahead of the latest cursor sample the stroke head is
+// predicted, in milliseconds. It is about a frame at 60 FPS.
+const double PREDICTOR_HORIZON_MS = 16.0;
+
+// The default time constant the cursor's velocity is smoothed over, in milliseconds
+const double PREDICTOR_SMOOTHING_MS = 24.0;
+
+// PredictionStats describes how far predictions were from the samples which
+// followed them, in canvas space units
+struct PredictionStats {
+  size_t count;
+  double meanError;
+  double maxError;
+};
+
+// MotionPredictor predicts where the cursor is heading from its recent
+// timestamped samples, so the head of a stroke can be drawn ahead of the
+// samples received so far.
+//
+// The cursor's velocity is tracked with an exponential filter, which smooths
+// out the jitter of individual samples, and the head is extrapolated from the
+// latest sample along it. Each new sample is compared to where the previous
+// state predicted it would be to measure the prediction error.
+class MotionPredictor {
+public:
+  MotionPredictor();
+
+  // reset forgets the samples of the previous stroke
+  void reset();
+
+  // addSample adds a cursor sample seen at time in seconds, smoothing the
+  // velocity over smoothingMs
+  void addSample(glm::vec2 position, double time, double smoothingMs);
+
+  // predict predicts the cursor's position horizonMs after the latest sample.
+  // It returns false if there is nothing to predict, e.g. once the cursor has
+  // stopped moving and no samples have arrived for a while.
+  bool predict(double horizonMs, double now, glm::vec2 &predicted) const;
+
+  // intervalStats describes the prediction error since resetInterval was last called
+  PredictionStats intervalStats() const;
+
+  // sessionStats describes the prediction error over the whole session
+  PredictionStats sessionStats() const;
+
+  // resetInterval starts a new interval of prediction error statistics
+  void resetInterval();
+
+private:
+  // The latest sample, its time in seconds and the filtered velocity in units per second
+  glm::vec2 position;
+  double time;
+  glm::vec2 velocity;
+  size_t numSamples;
+
+  // ErrorTotals accumulates prediction errors
+  struct ErrorTotals {
+    size_t count;
+    double sum;
+    double max;
+
+    void add(double error);
+    PredictionStats stats() const;
+  };
+
+  ErrorTotals interval;
+  ErrorTotals session;
+};
+
+#endif // PREDICTOR_H
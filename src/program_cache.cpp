@@ -0,0 +1,237 @@
+#include "program_cache.h"
+#include "../vendor/glfw/include/GLFW/glfw3.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+// Program binaries aren't part of OpenGL 3.3, so their enums may be missing
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+const char PROGRAM_CACHE_MAGIC[4] = {'D', 'R', 'W', 'P'};
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// The magic, version, binary format and binary length
+const size_t PROGRAM_CACHE_HEADER_SIZE = 16;
+
+// hashString folds a string into a running FNV-1a hash
+static uint64_t hashString(uint64_t hash, const std::string &value) {
+  for (unsigned char c : value) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+
+  // Separate consecutive strings, so their boundary is part of the hash
+  hash ^= 0xFF;
+  hash *= 1099511628211ull;
+  return hash;
+}
+
+static void putU32(uint8_t *out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = uint8_t(value >> (8 * i));
+  }
+}
+
+static uint32_t getU32(const uint8_t *data) {
+  return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+// glString returns a GL string such as GL_VENDOR, or an empty string
+static std::string glString(GLenum name) {
+  const GLubyte *value = glGetString(name);
+  return value == nullptr ? std::string() : std::string(reinterpret_cast<const char *>(value));
+}
+
+// makeDirectories creates a directory and any of its parents which are missing
+static bool makeDirectories(const std::string &path) {
+  for (size_t end = path.find('/', 1); end != std::string::npos; end = path.find('/', end + 1)) {
+    if (mkdir(path.substr(0, end).c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+  }
+
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// defaultProgramCacheDirectory returns the per-user directory program binaries
+// are cached in: $XDG_CACHE_HOME/drawww/shaders, ~/.cache/drawww/shaders or
+// ~/Library/Caches/drawww/shaders on macOS. It falls back to shader_cache in the
+// working directory when there is no home directory.
+std::string defaultProgramCacheDirectory() {
+  const char *cacheHome = std::getenv("XDG_CACHE_HOME");
+  if (cacheHome != nullptr && cacheHome[0] == '/')
+    return std::string(cacheHome) + "/drawww/shaders";
+
+  const char *home = std::getenv("HOME");
+  if (home == nullptr || home[0] == '\0')
+    return "shader_cache";
+
+#ifdef __APPLE__
+  return std::string(home) + "/Library/Caches/drawww/shaders";
+#else
+  return std::string(home) + "/.cache/drawww/shaders";
+#endif
+}
+
+// ProgramBinaryCache creates a disabled cache
+ProgramBinaryCache::ProgramBinaryCache()
+    : numHits(0), numMisses(0), numRejected(0), getProgramBinary(nullptr), programBinary(nullptr),
+      programParameteri(nullptr) {}
+
+// open enables the cache, storing binaries in the given directory, which is
+// created along with its parents if needed. It returns false and leaves the
+// cache disabled if the driver can't save binaries. The GL context must be current.
+bool ProgramBinaryCache::open(const std::string &directory) {
+#ifdef __EMSCRIPTEN__
+  (void)directory;
+  return false;
+#else
+  if (!glfwExtensionSupported("GL_ARB_get_program_binary"))
+    return false;
+
+  // Some drivers advertise the extension without any binary format
+  GLint numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  if (numFormats <= 0)
+    return false;
+
+  // The functions aren't loaded with OpenGL 3.3, so they're looked up directly
+  auto getProgramBinary = reinterpret_cast<GetProgramBinaryFunc>(glfwGetProcAddress("glGetProgramBinary"));
+  auto programBinary = reinterpret_cast<ProgramBinaryFunc>(glfwGetProcAddress("glProgramBinary"));
+  auto programParameteri = reinterpret_cast<ProgramParameteriFunc>(glfwGetProcAddress("glProgramParameteri"));
+  if (getProgramBinary == nullptr || programBinary == nullptr || programParameteri == nullptr)
+    return false;
+
+  if (!makeDirectories(directory))
+    return false;
+
+  this->getProgramBinary = getProgramBinary;
+  this->programBinary = programBinary;
+  this->programParameteri = programParameteri;
+  this->directory = directory;
+  this->driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+  return true;
+#endif
+}
+
+// isEnabled indicates whether the cache has been opened
+bool ProgramBinaryCache::isEnabled() const { return this->programBinary != nullptr; }
+
+// entryPath returns the path of the entry holding a program's binary
+std::string ProgramBinaryCache::entryPath(const std::string &vertexSource, const std::string &fragmentSource) const {
+  uint64_t hash = 14695981039346656037ull;
+  hash = hashString(hash, vertexSource);
+  hash = hashString(hash, fragmentSource);
+  hash = hashString(hash, this->driver);
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+  return this->directory + "/" + name;
+}
+
+// load creates a program from the cached binary of the given sources. It
+// returns 0 if there is no binary or the driver rejected it.
+unsigned int ProgramBinaryCache::load(const std::string &vertexSource, const std::string &fragmentSource) {
+  if (!this->isEnabled())
+    return 0;
+
+  std::string path = this->entryPath(vertexSource, fragmentSource);
+
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    this->numMisses++;
+    return 0;
+  }
+
+  uint8_t header[PROGRAM_CACHE_HEADER_SIZE];
+  std::vector<uint8_t> binary;
+  bool valid = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+               std::memcmp(header, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) == 0 &&
+               getU32(header + 4) == PROGRAM_CACHE_VERSION;
+  if (valid) {
+    binary.resize(getU32(header + 12));
+    valid = !binary.empty() && fread(binary.data(), 1, binary.size(), file) == binary.size();
+  }
+  fclose(file);
+
+  if (!valid) {
+    this->numRejected++;
+    return 0;
+  }
+
+  unsigned int program = glCreateProgram();
+  this->programBinary(program, GLenum(getU32(header + 8)), binary.data(), GLsizei(binary.size()));
+
+  // The driver rejects binaries it didn't produce, or which are out of date
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    glDeleteProgram(program);
+    this->numRejected++;
+    return 0;
+  }
+
+  this->numHits++;
+  return program;
+}
+
+// prepare asks the driver to keep a program's binary retrievable once it's
+// linked, so it can be stored. Without the hint, some drivers return no binary
+// or one they later reject. It must be called before the program is linked.
+void ProgramBinaryCache::prepare(unsigned int program) {
+  if (!this->isEnabled())
+    return;
+
+  this->programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// store saves the binary of a program linked from the given sources.
+// The entry is written to a temporary file and renamed into place, so a
+// launch which is interrupted never leaves a truncated entry behind.
+void ProgramBinaryCache::store(unsigned int program, const std::string &vertexSource,
+                               const std::string &fragmentSource) {
+  if (!this->isEnabled())
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  std::vector<uint8_t> entry(PROGRAM_CACHE_HEADER_SIZE + size_t(length));
+  GLsizei written = 0;
+  GLenum format = 0;
+  this->getProgramBinary(program, length, &written, &format, entry.data() + PROGRAM_CACHE_HEADER_SIZE);
+  if (written <= 0)
+    return;
+
+  entry.resize(PROGRAM_CACHE_HEADER_SIZE + size_t(written));
+  std::memcpy(entry.data(), PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+  putU32(entry.data() + 4, PROGRAM_CACHE_VERSION);
+  putU32(entry.data() + 8, uint32_t(format));
+  putU32(entry.data() + 12, uint32_t(written));
+
+  std::string path = this->entryPath(vertexSource, fragmentSource);
+  std::string tempPath = path + ".tmp";
+
+  FILE *file = fopen(tempPath.c_str(), "wb");
+  if (file == nullptr)
+    return;
+
+  bool wrote = fwrite(entry.data(), 1, entry.size(), file) == entry.size();
+  wrote = fclose(file) == 0 && wrote;
+
+  if (!wrote || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+#include "../vendor/glad/gl.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ProgramBinaryCache stores linked shader programs on disk with
+// ARB_get_program_binary, so later launches load them instead of compiling and
+// linking their sources again.
+//
+// Binaries are only valid for the driver which produced them, so entries are
+// keyed by a hash of the program's sources and the driver's vendor, renderer
+// and version strings. A driver may still reject a binary, e.g after an update
+// which kept its version string; the program is then compiled as usual and its
+// entry rewritten.
+//
+// WebGL2 has no program binaries, so the cache is never enabled on the web.
+class ProgramBinaryCache {
+public:
+  ProgramBinaryCache();
+
+  // open enables the cache, storing binaries in the given directory, which is
+  // created along with its parents if needed. It returns false and leaves the
+  // cache disabled if the driver can't save binaries. The GL context must be current.
+  bool open(const std::string &directory);
+
+  // isEnabled indicates whether the cache has been opened
+  bool isEnabled() const;
+
+  // load creates a program from the cached binary of the given sources. It
+  // returns 0 if there is no binary or the driver rejected it.
+  unsigned int load(const std::string &vertexSource, const std::string &fragmentSource);
+
+  // prepare asks the driver to keep a program's binary retrievable once it's
+  // linked, so it can be stored. It must be called before the program is linked.
+  void prepare(unsigned int program);
+
+  // store saves the binary of a program linked from the given sources
+  void store(unsigned int program, const std::string &vertexSource, const std::string &fragmentSource);
+
+  // The number of programs loaded from binaries, missing from the cache, and
+  // whose binary was rejected by the driver
+  size_t numHits, numMisses, numRejected;
+
+private:
+  typedef void(GLAD_API_PTR *GetProgramBinaryFunc)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                   GLenum *binaryFormat, void *binary);
+  typedef void(GLAD_API_PTR *ProgramBinaryFunc)(GLuint program, GLenum binaryFormat, const void *binary,
+                                                GLsizei length);
+  typedef void(GLAD_API_PTR *ProgramParameteriFunc)(GLuint program, GLenum pname, GLint value);
+
+  GetProgramBinaryFunc getProgramBinary;
+  ProgramBinaryFunc programBinary;
+  ProgramParameteriFunc programParameteri;
+
+  std::string directory;
+
+  // The driver's vendor, renderer and version strings
+  std::string driver;
+
+  // entryPath returns the path of the entry holding a program's binary
+  std::string entryPath(const std::string &vertexSource, const std::string &fragmentSource) const;
+};
+
+// defaultProgramCacheDirectory returns the per-user directory program binaries
+// are cached in: $XDG_CACHE_HOME/drawww/shaders, ~/.cache/drawww/shaders or
+// ~/Library/Caches/drawww/shaders on macOS. It falls back to shader_cache in the
+// working directory when there is no home directory.
+std::string defaultProgramCacheDirectory();
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,54 @@
+#include "rect.h"
+#include <limits>
+
+// empty returns a rect which contains nothing and grows from the first
+// point added to it
+Rect Rect::empty() {
+  float inf = std::numeric_limits<float>::infinity();
+  return Rect{glm::vec2{inf, inf}, glm::vec2{-inf, -inf}};
+}
+
+// around returns a square rect of the given radius centered on a point
+Rect Rect::around(glm::vec2 center, float radius) {
+  return Rect{glm::vec2{center.x - radius, center.y - radius},
+              glm::vec2{center.x + radius, center.y + radius}};
+}
+
+// isEmpty indicates whether the rect contains nothing
+bool Rect::isEmpty() const { return this->min.x > this->max.x || this->min.y > this->max.y; }
+
+// expand grows the rect so it contains the given point
+void Rect::expand(glm::vec2 point) {
+  this->min = glm::min(this->min, point);
+  this->max = glm::max(this->max, point);
+}
+
+// expand grows the rect so it contains the given rect
+void Rect::expand(const Rect &other) {
+  if (other.isEmpty())
+    return;
+
+  this->expand(other.min);
+  this->expand(other.max);
+}
+
+// inflated returns a copy of the rect grown by the given amount on every side
+Rect Rect::inflated(float amount) const {
+  if (this->isEmpty())
+    return *this;
+
+  return Rect{glm::vec2{this->min.x - amount, this->min.y - amount},
+              glm::vec2{this->max.x + amount, this->max.y + amount}};
+}
+
+// intersects indicates whether two rects overlap
+bool Rect::intersects(const Rect &other) const {
+  return this->min.x <= other.max.x && this->max.x >= other.min.x &&
+         this->min.y <= other.max.y && this->max.y >= other.min.y;
+}
+
+// contains indicates whether a point lies within the rect
+bool Rect::contains(glm::vec2 point) const {
+  return point.x >= this->min.x && point.x <= this->max.x &&
+         point.y >= this->min.y && point.y <= this->max.y;
+}
@@ -0,0 +1,36 @@
+#ifndef RECT_H
+#define RECT_H
+#include "../vendor/glm/glm/glm.hpp"
+
+// Rect is an axis-aligned bounding box in canvas space
+struct Rect {
+  glm::vec2 min;
+  glm::vec2 max;
+
+  // empty returns a rect which contains nothing and grows from the first
+  // point added to it
+  static Rect empty();
+
+  // around returns a square rect of the given radius centered on a point
+  static Rect around(glm::vec2 center, float radius);
+
+  // isEmpty indicates whether the rect contains nothing
+  bool isEmpty() const;
+
+  // expand grows the rect so it contains the given point
+  void expand(glm::vec2 point);
+
+  // expand grows the rect so it contains the given rect
+  void expand(const Rect &other);
+
+  // inflated returns a copy of the rect grown by the given amount on every side
+  Rect inflated(float amount) const;
+
+  // intersects indicates whether two rects overlap
+  bool intersects(const Rect &other) const;
+
+  // contains indicates whether a point lies within the rect
+  bool contains(glm::vec2 point) const;
+};
+
+#endif // RECT_H
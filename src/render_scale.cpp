@@ -0,0 +1,121 @@
+#include "render_scale.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Frame times this far over the target lower the scale, and frame times within
+// this far of it raise the scale, so it settles rather than oscillating
+const double RENDER_SCALE_OVER_TARGET = 1.15;
+const double RENDER_SCALE_NEAR_TARGET = 1.05;
+
+// The amount the scale is raised by per interval. Scales are multiples of it,
+// so the offscreen target is only resized when the scale really changes.
+const float RENDER_SCALE_STEP = 0.05f;
+
+// The number of seconds after lowering the scale before it may be raised again
+const double RENDER_SCALE_HOLD_SECONDS = 5.0;
+
+// RenderScaler creates a scaler which renders at full resolution
+RenderScaler::RenderScaler()
+    : currentScale(1.0f), holdUntil(0.0), FBO(0), renderbuffer(0), targetWidth(0), targetHeight(0) {}
+
+// Cleanup
+RenderScaler::~RenderScaler() {
+  this->release();
+}
+
+// scale returns the fraction of the frame buffer's resolution rendered at
+float RenderScaler::scale() const {
+  return this->currentScale;
+}
+
+// update adjusts the scale within the given bounds from the average frame
+// time over the last interval. It returns whether the scale changed.
+bool RenderScaler::update(double milliSecondsPerFrame, double now, float minScale, float maxScale) {
+  float previousScale = this->currentScale;
+
+  if (milliSecondsPerFrame > RENDER_SCALE_TARGET_MS * RENDER_SCALE_OVER_TARGET) {
+    // The pixels rendered grow with the square of the scale
+    float scale = this->currentScale * float(std::sqrt(RENDER_SCALE_TARGET_MS / milliSecondsPerFrame));
+    this->currentScale = std::floor(scale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+    this->holdUntil = now + RENDER_SCALE_HOLD_SECONDS;
+  } else if (milliSecondsPerFrame < RENDER_SCALE_TARGET_MS * RENDER_SCALE_NEAR_TARGET && now >= this->holdUntil) {
+    this->currentScale += RENDER_SCALE_STEP;
+  }
+
+  this->currentScale = std::clamp(this->currentScale, minScale, maxScale);
+
+  return this->currentScale != previousScale;
+}
+
+// bind binds the target the scene is rendered into for a frame buffer of the
+// given size and returns the size it renders at. At full resolution the
+// frame buffer is bound directly.
+glm::ivec2 RenderScaler::bind(int frameBufferWidth, int frameBufferHeight) {
+  int width = std::max(1, int(std::lround(frameBufferWidth * this->currentScale)));
+  int height = std::max(1, int(std::lround(frameBufferHeight * this->currentScale)));
+
+  if (width >= frameBufferWidth && height >= frameBufferHeight) {
+    this->release();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, frameBufferWidth, frameBufferHeight);
+    return glm::ivec2{frameBufferWidth, frameBufferHeight};
+  }
+
+  // Recreate the target when the scale or the frame buffer's size changes
+  if (this->FBO != 0 && (width != this->targetWidth || height != this->targetHeight)) {
+    this->release();
+  }
+
+  if (this->FBO == 0) {
+    glGenRenderbuffers(1, &(this->renderbuffer));
+    glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &(this->FBO));
+    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->renderbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      this->release();
+      throw std::runtime_error("render scale frame buffer is incomplete");
+    }
+
+    this->targetWidth = width;
+    this->targetHeight = height;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+  glViewport(0, 0, width, height);
+  return glm::ivec2{width, height};
+}
+
+// present upscales what was rendered to the frame buffer and binds it
+void RenderScaler::present(int frameBufferWidth, int frameBufferHeight) {
+  if (this->FBO == 0)
+    return;
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, this->FBO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, this->targetWidth, this->targetHeight, 0, 0, frameBufferWidth, frameBufferHeight,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, frameBufferWidth, frameBufferHeight);
+}
+
+// release deletes the offscreen target
+void RenderScaler::release() {
+  if (this->FBO == 0)
+    return;
+
+  glDeleteFramebuffers(1, &(this->FBO));
+  glDeleteRenderbuffers(1, &(this->renderbuffer));
+  this->FBO = 0;
+  this->renderbuffer = 0;
+  this->targetWidth = 0;
+  this->targetHeight = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef RENDER_SCALE_H
+#define RENDER_SCALE_H
+#include "../vendor/glad/gl.h"
+#include "../vendor/glm/glm/glm.hpp"
+
+// The range the render scale is kept within by default
+const float RENDER_SCALE_MIN = 0.5f;
+const float RENDER_SCALE_MAX = 1.0f;
+
+// The frame time the render scale is adjusted to meet, in milliseconds
+const double RENDER_SCALE_TARGET_MS = 1000.0 / 60.0;
+
+// RenderScaler renders the scene into an offscreen target at a fraction of the
+// frame buffer's resolution, then upscales it to the frame buffer. The scale is
+// adjusted from measured frame times, so weak GPUs on HiDPI screens keep their
+// frame rate at the cost of some sharpness.
+class RenderScaler {
+public:
+  // RenderScaler creates a scaler which renders at full resolution
+  RenderScaler();
+  ~RenderScaler();
+
+  RenderScaler(const RenderScaler &) = delete;
+  RenderScaler &operator=(const RenderScaler &) = delete;
+
+  // scale returns the fraction of the frame buffer's resolution rendered at
+  float scale() const;
+
+  // update adjusts the scale within the given bounds from the average frame
+  // time over the last interval. It returns whether the scale changed.
+  bool update(double milliSecondsPerFrame, double now, float minScale, float maxScale);
+
+  // bind binds the target the scene is rendered into for a frame buffer of the
+  // given size and returns the size it renders at. At full resolution the
+  // frame buffer is bound directly.
+  glm::ivec2 bind(int frameBufferWidth, int frameBufferHeight);
+
+  // present upscales what was rendered to the frame buffer and binds it
+  void present(int frameBufferWidth, int frameBufferHeight);
+
+private:
+  float currentScale;
+
+  // The time before which the scale isn't raised again, after it was lowered
+  double holdUntil;
+
+  // The offscreen target, created while rendering below full resolution
+  unsigned int FBO, renderbuffer;
+  int targetWidth, targetHeight;
+
+  // release deletes the offscreen target
+  void release();
+};
+
+#endif // RENDER_SCALE_H
@@ -0,0 +1,120 @@
+#include "selection.h"
+#include <stdexcept>
+
+// Selection creates an empty floating selection of a region of a canvas of
+// the given height, rendered with the canvas shader
+Selection::Selection(Shader &shader, int x, int y, int width, int height, int canvasHeight)
+    : x(x), y(y), width(width), height(height), offset(0, 0), canvasHeight(canvasHeight), shader(shader) {
+  glGenTextures(1, &(this->texture));
+  glBindTexture(GL_TEXTURE_2D, this->texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Keep whatever the pixels are being lifted from bound
+  GLint bound = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound);
+
+  glGenFramebuffers(1, &(this->FBO));
+  glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(bound));
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    glDeleteFramebuffers(1, &(this->FBO));
+    glDeleteTextures(1, &(this->texture));
+    throw std::runtime_error("selection frame buffer is incomplete");
+  }
+
+  // Setup a unit quad scaled over the selection, laid out like the canvas'
+  // tiles. Positions are in canvas space (top row first) and texture
+  // coordinates follow OpenGL (bottom row first).
+  float vertexData[] = {
+      0, 0, 0, 1, //
+      1, 0, 1, 1, //
+      0, 1, 0, 0, //
+      1, 1, 1, 0, //
+  };
+
+  glGenVertexArrays(1, &(this->VAO));
+  glGenBuffers(1, &(this->VBO));
+
+  glBindVertexArray(this->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+// Cleanup
+Selection::~Selection() {
+  glDeleteVertexArrays(1, &(this->VAO));
+  glDeleteBuffers(1, &(this->VBO));
+  glDeleteFramebuffers(1, &(this->FBO));
+  glDeleteTextures(1, &(this->texture));
+}
+
+// lift copies the selection's pixels from the bottom left of the bound read
+// frame buffer into its texture
+void Selection::lift() {
+  glBindTexture(GL_TEXTURE_2D, this->texture);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, this->width, this->height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// draws the floating pixels at their offset. The shader's viewProjection
+// uniform must already be set for the frame.
+void Selection::draw() {
+  Rect bounds = this->bounds();
+
+  this->shader.use();
+  this->shader.setInt("solid", 0);
+  this->shader.setVec4("tileRect", bounds.min.x, bounds.min.y, float(this->width), float(this->height));
+  this->shader.setVec2("uvScale", 1.0f, 1.0f);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, this->texture);
+  glBindVertexArray(this->VAO);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// blit copies the floating pixels into the bound draw frame buffer with their
+// bottom left pixel at the given position. Pixels falling outside the frame
+// buffer are dropped.
+void Selection::blit(int x, int y) {
+  GLint bound = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &bound);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, this->FBO);
+  glBlitFramebuffer(0, 0, this->width, this->height, x, y, x + this->width, y + this->height, GL_COLOR_BUFFER_BIT,
+                    GL_NEAREST);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(bound));
+}
+
+// region returns the region of canvas space the pixels were lifted from
+Rect Selection::region() const {
+  glm::vec2 min{float(this->x), float(this->canvasHeight - (this->y + this->height))};
+  return Rect{min, min + glm::vec2{float(this->width), float(this->height)}};
+}
+
+// bounds returns the region of canvas space the floating pixels cover at their offset
+Rect Selection::bounds() const {
+  glm::vec2 offset{float(this->offset.x), float(this->offset.y)};
+  Rect region = this->region();
+  return Rect{region.min + offset, region.max + offset};
+}
+
+// gpuBytes returns the number of bytes the floating texture occupies on the GPU
+size_t Selection::gpuBytes() const { return size_t(this->width) * this->height * 4; }
@@ -0,0 +1,64 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+#include "drawable.h"
+#include "rect.h"
+#include "shader.h"
+#include <cstddef>
+
+// Selection is a rectangle of the canvas' pixels lifted into a floating texture,
+// so it can be dragged elsewhere and put back down. The pixels are copied on
+// the GPU when they're lifted and when they're committed, and in between the
+// selection is drawn as a single textured quad. Moving it only changes the
+// offset it's drawn at, so it costs the same however much was drawn beneath it.
+//
+// The region is in canvas pixels, stored bottom row first like the canvas.
+// Offsets are in whole canvas space units, so committing never resamples.
+class Selection : public Drawable {
+public:
+  // Selection creates an empty floating selection of a region of a canvas of
+  // the given height, rendered with the canvas shader
+  Selection(Shader &shader, int x, int y, int width, int height, int canvasHeight);
+  ~Selection();
+
+  Selection(const Selection &) = delete;
+  Selection &operator=(const Selection &) = delete;
+
+  // lift copies the selection's pixels from the bottom left of the bound read
+  // frame buffer into its texture
+  void lift();
+
+  // draws the floating pixels at their offset. The shader's viewProjection
+  // uniform must already be set for the frame.
+  virtual void draw();
+
+  // blit copies the floating pixels into the bound draw frame buffer with their
+  // bottom left pixel at the given position. Pixels falling outside the frame
+  // buffer are dropped.
+  void blit(int x, int y);
+
+  // region returns the region of canvas space the pixels were lifted from
+  Rect region() const;
+
+  // bounds returns the region of canvas space the floating pixels cover at their offset
+  Rect bounds() const;
+
+  // gpuBytes returns the number of bytes the floating texture occupies on the GPU
+  size_t gpuBytes() const;
+
+  // The region of the canvas the pixels were lifted from
+  int x, y, width, height;
+
+  // How far the pixels have been moved in canvas space
+  glm::ivec2 offset;
+
+private:
+  int canvasHeight;
+
+  // Shader internals. The floating texture is attached to a frame buffer so
+  // it can be the source of a blit.
+  Shader &shader;
+  unsigned int VBO, VAO;
+  unsigned int FBO, texture;
+};
+
+#endif // SELECTION_H
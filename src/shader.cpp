@@ -1,5 +1,7 @@
 #include "shader.h"
+#include "../vendor/glm/glm/gtc/type_ptr.hpp"
 #include "utils.h"
+#include <cmath>
 #include <exception>
 #include <fstream>
 #include <iostream>
@@ -8,13 +10,13 @@
 #include <stdexcept>
 #include <stdio.h>
 
-Shader::Shader(const char *vertexShaderPath, const char *fragmentShaderPath) {
-  // Read the shader files
-  std::string vertexShaderRaw = utils::readFile(vertexShaderPath);
-  std::string fragmentShaderRaw = utils::readFile(fragmentShaderPath);
-
+// Shader compiles and links a new shader program from GLSL sources, such as
+// those embedded from src/shaders. beforeLink, if set, is called with the
+// program just before it's linked, e.g to set program parameters.
+Shader::Shader(const char *vertexShaderSource, const char *fragmentShaderSource,
+               const std::function<void(unsigned int)> &beforeLink) {
   // Compile the vertex shader
-  const char *vertexShaderCode = vertexShaderRaw.c_str();
+  const char *vertexShaderCode = vertexShaderSource;
 
   unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
   glShaderSource(vertexShader, 1, &vertexShaderCode, NULL);
@@ -23,11 +25,11 @@ Shader::Shader(const char *vertexShaderPath, const char *fragmentShaderPath) {
   std::string vertexShaderErr = utils::checkShaderErrors(vertexShader);
   if (vertexShaderErr != "") {
     throw std::runtime_error(std::string(
-        "failed to compile vertex shader file: " + vertexShaderErr));
+        "failed to compile vertex shader: " + vertexShaderErr));
   }
 
   // Compile the fragment shader
-  const char *fragmentShaderCode = fragmentShaderRaw.c_str();
+  const char *fragmentShaderCode = fragmentShaderSource;
 
   unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
   glShaderSource(fragmentShader, 1, &fragmentShaderCode, NULL);
@@ -36,13 +38,16 @@ Shader::Shader(const char *vertexShaderPath, const char *fragmentShaderPath) {
   std::string fragmentShaderErr = utils::checkShaderErrors(fragmentShader);
   if (fragmentShaderErr != "") {
     throw std::runtime_error(std::string(
-        "failed to compile fragment shader file: " + fragmentShaderErr));
+        "failed to compile fragment shader: " + fragmentShaderErr));
   }
 
   // Create the shader program and link the shaders
   this->ID = glCreateProgram();
   glAttachShader(this->ID, vertexShader);
   glAttachShader(this->ID, fragmentShader);
+  if (beforeLink) {
+    beforeLink(this->ID);
+  }
   glLinkProgram(this->ID);
 
   std::string shaderProgramErr = utils::checkShaderProgramErrors(this->ID);
@@ -56,6 +61,10 @@ Shader::Shader(const char *vertexShaderPath, const char *fragmentShaderPath) {
   glDeleteShader(fragmentShader);
 }
 
+// Shader wraps a program which has already been linked, e.g one loaded from a
+// program binary
+Shader::Shader(unsigned int programID) : ID(programID) {}
+
 // set_uniforms sets the values for render loop uniforms
 void Shader::set_uniforms() {
   float timeValue = glfwGetTime();
@@ -68,6 +77,34 @@ void Shader::set_uniforms() {
   glUniform4f(vertexColorLocation, 1.0f, normalisedGreen, 1.0f, 1.0f);
 }
 
+// setFloat sets the value of a float uniform
+void Shader::setFloat(const char *name, float value) {
+  glUniform1f(glGetUniformLocation(this->ID, name), value);
+}
+
+// setVec2 sets the value of a vec2 uniform
+void Shader::setVec2(const char *name, float x, float y) {
+  glUniform2f(glGetUniformLocation(this->ID, name), x, y);
+}
+
+// setInt sets the value of an int or bool uniform
+void Shader::setInt(const char *name, int value) { glUniform1i(glGetUniformLocation(this->ID, name), value); }
+
+// setVec4 sets the value of a vec4 uniform
+void Shader::setVec4(const char *name, float x, float y, float z, float w) {
+  glUniform4f(glGetUniformLocation(this->ID, name), x, y, z, w);
+}
+
+// setMat4 sets the value of a mat4 uniform
+void Shader::setMat4(const char *name, const glm::mat4 &value) {
+  glUniformMatrix4fv(glGetUniformLocation(this->ID, name), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+// setMat4Array sets the values of consecutive elements of a mat4 array uniform
+void Shader::setMat4Array(const char *name, const glm::mat4 *values, int count) {
+  glUniformMatrix4fv(glGetUniformLocation(this->ID, name), count, GL_FALSE, glm::value_ptr(values[0]));
+}
+
 void Shader::use() { glUseProgram(this->ID); }
 
 void Shader::print() { printf("Shader program ID %d\n", this->ID); };
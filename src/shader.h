@@ -2,6 +2,8 @@
 #define SHADER_H
 #include "../vendor/glad/gl.h"
 #include "../vendor/glfw/include/GLFW/glfw3.h"
+#include "../vendor/glm/glm/glm.hpp"
+#include <functional>
 
 // Shader is shader program containing a vertex shader and fragment shader
 class Shader {
@@ -9,8 +11,15 @@ public:
   // ID is the identifer of the shader program
   unsigned int ID;
 
-  // Shader initialises a new shader
-  Shader(const char *vertexShaderPath, const char *fragmentShaderPath);
+  // Shader compiles and links a new shader program from GLSL sources, such as
+  // those embedded from src/shaders. beforeLink, if set, is called with the
+  // program just before it's linked, e.g to set program parameters.
+  Shader(const char *vertexShaderSource, const char *fragmentShaderSource,
+         const std::function<void(unsigned int)> &beforeLink = nullptr);
+
+  // Shader wraps a program which has already been linked, e.g one loaded from a
+  // program binary
+  explicit Shader(unsigned int programID);
 
   // use activates the shader program
   void use();
@@ -18,6 +27,24 @@ public:
   // set_uniforms sets the values for render loop uniforms
   void set_uniforms();
 
+  // setFloat sets the value of a float uniform
+  void setFloat(const char *name, float value);
+
+  // setVec2 sets the value of a vec2 uniform
+  void setVec2(const char *name, float x, float y);
+
+  // setInt sets the value of an int or bool uniform
+  void setInt(const char *name, int value);
+
+  // setVec4 sets the value of a vec4 uniform
+  void setVec4(const char *name, float x, float y, float z, float w);
+
+  // setMat4 sets the value of a mat4 uniform
+  void setMat4(const char *name, const glm::mat4 &value);
+
+  // setMat4Array sets the values of consecutive elements of a mat4 array uniform
+  void setMat4Array(const char *name, const glm::mat4 *values, int count);
+
   // print displays the shader program ID
   void print();
 };
@@ -0,0 +1,136 @@
+#include "shader_cache.h"
+#include "embedded_shaders.h"
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+// The header prepended to every shader source, declaring the GLSL version and
+// the defaults of the platform being built for
+#ifdef __EMSCRIPTEN__
+const char *SHADER_PLATFORM_HEADER = "#version 300 es\n"
+                                     "precision highp float;\n"
+                                     "#define WEBGL2\n";
+#else
+const char *SHADER_PLATFORM_HEADER = "#version 330 core\n";
+#endif
+
+// The macro defined for each feature, in the order of their bits
+const char *SHADER_FEATURE_DEFINES[] = {
+    "#define ANTIALIASED\n",
+    "#define INSTANCED\n",
+    "#define TEXTURED\n",
+};
+
+// permutationKey returns the key a permutation is cached under
+static uint64_t permutationKey(ShaderProgram program, uint32_t features) {
+  return (uint64_t(program) << 32) | features;
+}
+
+// ShaderCache creates an empty cache
+ShaderCache::ShaderCache() : numCompiled(0), buildMs(0.0) {}
+
+// get returns a shader permutation, compiling it the first time it is
+// requested. The shader lives until the cache is cleared.
+Shader &ShaderCache::get(ShaderProgram program, uint32_t features) {
+  uint64_t key = permutationKey(program, features);
+
+  auto cached = this->shaders.find(key);
+  if (cached != this->shaders.end())
+    return *cached->second;
+
+  const char *vertexSource = nullptr;
+  const char *fragmentSource = nullptr;
+  switch (program) {
+  case ShaderProgram::Stroke:
+    vertexSource = SHADER_STROKE_VERT;
+    fragmentSource = SHADER_STROKE_FRAG;
+    break;
+  case ShaderProgram::Canvas:
+    vertexSource = SHADER_CANVAS_VERT;
+    fragmentSource = SHADER_CANVAS_FRAG;
+    break;
+  case ShaderProgram::Shape:
+    vertexSource = SHADER_SHAPE_VERT;
+    fragmentSource = SHADER_SHAPE_FRAG;
+    break;
+  case ShaderProgram::Spray:
+    vertexSource = SHADER_SPRAY_VERT;
+    fragmentSource = SHADER_SPRAY_FRAG;
+    break;
+  case ShaderProgram::Composite:
+    vertexSource = SHADER_COMPOSITE_VERT;
+    fragmentSource = SHADER_COMPOSITE_FRAG;
+    break;
+  }
+
+  if (vertexSource == nullptr)
+    throw std::runtime_error("unknown shader program");
+
+  auto buildStart = std::chrono::steady_clock::now();
+
+  std::string vertex = ShaderCache::expand(vertexSource, features);
+  std::string fragment = ShaderCache::expand(fragmentSource, features);
+
+  // Load the program's binary if it was cached by an earlier launch, and
+  // otherwise compile it and cache its binary for the next one
+  std::unique_ptr<Shader> shader;
+  unsigned int binaryProgram = this->binaries.load(vertex, fragment);
+  if (binaryProgram != 0) {
+    shader.reset(new Shader(binaryProgram));
+  } else {
+    ProgramBinaryCache &binaries = this->binaries;
+    shader.reset(new Shader(vertex.c_str(), fragment.c_str(),
+                            [&binaries](unsigned int program) { binaries.prepare(program); }));
+    this->binaries.store(shader->ID, vertex, fragment);
+    this->numCompiled++;
+  }
+
+  this->buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+  Shader &compiled = *shader;
+  this->shaders.emplace(key, std::move(shader));
+
+  return compiled;
+}
+
+// prewarm compiles the permutations in a manifest which haven't been compiled yet
+void ShaderCache::prewarm(const std::vector<ShaderPermutation> &manifest) {
+  for (const ShaderPermutation &permutation : manifest) {
+    this->get(permutation.program, permutation.features);
+  }
+}
+
+// openBinaryCache saves and loads programs as binaries in the given directory,
+// if the driver supports it. It returns whether the binary cache is enabled.
+bool ShaderCache::openBinaryCache(const std::string &directory) { return this->binaries.open(directory); }
+
+// binaryCache returns the program binary cache, e.g for its hit counts
+const ProgramBinaryCache &ShaderCache::binaryCache() const { return this->binaries; }
+
+// clear deletes every compiled shader program. The GL context must still be alive.
+void ShaderCache::clear() {
+  for (auto &shader : this->shaders) {
+    glDeleteProgram(shader.second->ID);
+  }
+  this->shaders.clear();
+}
+
+// size returns the number of compiled permutations
+size_t ShaderCache::size() const { return this->shaders.size(); }
+
+// expand returns a shader stage's source specialised with the given features
+// for the platform being built for
+std::string ShaderCache::expand(const char *source, uint32_t features) {
+  std::string expanded = SHADER_PLATFORM_HEADER;
+
+  size_t numFeatures = sizeof(SHADER_FEATURE_DEFINES) / sizeof(SHADER_FEATURE_DEFINES[0]);
+  for (size_t i = 0; i < numFeatures; i++) {
+    if (features & (1u << i)) {
+      expanded += SHADER_FEATURE_DEFINES[i];
+    }
+  }
+
+  expanded += "#line 1\n";
+  expanded += source;
+  return expanded;
+}
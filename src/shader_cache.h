@@ -0,0 +1,87 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+#include "program_cache.h"
+#include "shader.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Features a shader permutation is specialised with. Each is defined as a
+// preprocessor macro of the same name, without the SHADER_ prefix, in the
+// permutation's sources.
+// ANTIALIASED rounds stamps into discs with a soft edge
+const uint32_t SHADER_ANTIALIASED = 1 << 0;
+// INSTANCED draws stamps interpolated from segments, one instance per stamp
+const uint32_t SHADER_INSTANCED = 1 << 1;
+// TEXTURED shapes stamps with a brush tip texture
+const uint32_t SHADER_TEXTURED = 1 << 2;
+
+// ShaderProgram identifies the sources of a shader program
+enum class ShaderProgram {
+  Stroke,
+  Canvas,
+  Shape,
+  Spray,
+  Composite,
+};
+
+// ShaderPermutation is a shader program specialised with a set of features
+struct ShaderPermutation {
+  ShaderProgram program;
+  uint32_t features;
+};
+
+// ShaderCache compiles shader permutations from single GLSL sources, which
+// select their features with #ifdef. The platform header, i.e the #version line
+// and defaults for desktop GL or WebGL2, is picked at compile time.
+//
+// Permutations are compiled the first time they are requested and kept until
+// the cache is cleared. A manifest of permutations can be compiled ahead of
+// time, so the first frames don't stall on compiling. Once a program binary
+// cache is opened, linked programs are saved to disk and later loaded from it
+// instead of being compiled again.
+class ShaderCache {
+public:
+  ShaderCache();
+
+  ShaderCache(const ShaderCache &) = delete;
+  ShaderCache &operator=(const ShaderCache &) = delete;
+
+  // get returns a shader permutation, compiling it the first time it is
+  // requested. The shader lives until the cache is cleared.
+  Shader &get(ShaderProgram program, uint32_t features = 0);
+
+  // prewarm compiles the permutations in a manifest which haven't been compiled yet
+  void prewarm(const std::vector<ShaderPermutation> &manifest);
+
+  // openBinaryCache saves and loads programs as binaries in the given directory,
+  // if the driver supports it. It returns whether the binary cache is enabled.
+  bool openBinaryCache(const std::string &directory);
+
+  // binaryCache returns the program binary cache, e.g for its hit counts
+  const ProgramBinaryCache &binaryCache() const;
+
+  // clear deletes every compiled shader program. The GL context must still be alive.
+  void clear();
+
+  // size returns the number of compiled permutations
+  size_t size() const;
+
+  // expand returns a shader stage's source specialised with the given features
+  // for the platform being built for
+  static std::string expand(const char *source, uint32_t features);
+
+  // The number of programs compiled from source, and the milliseconds spent
+  // compiling or loading programs
+  size_t numCompiled;
+  double buildMs;
+
+private:
+  std::unordered_map<uint64_t, std::unique_ptr<Shader> > shaders;
+  ProgramBinaryCache binaries;
+};
+
+#endif // SHADER_CACHE_H
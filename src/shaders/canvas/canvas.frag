@@ -0,0 +1,10 @@
+in vec2 texCoord;
+out vec4 FragColor;
+
+uniform sampler2D canvasTexture;
+
+// Tiles of a single color are drawn without a texture
+uniform bool solid;
+uniform vec4 solidColor;
+
+void main() { FragColor = solid ? solidColor : texture(canvasTexture, texCoord); }
@@ -0,0 +1,15 @@
+layout (location = 0) in vec2 pos;
+layout (location = 1) in vec2 uv;
+
+uniform mat4 viewProjection;
+uniform vec4 tileRect;
+uniform vec2 uvScale;
+
+out vec2 texCoord;
+
+void main() {
+    // Scale the unit quad over the tile, then transform it from canvas space to clip space
+    gl_Position = viewProjection * vec4(tileRect.xy + (pos * tileRect.zw), 0.0, 1.0);
+    // Edge tiles only fill part of their texture
+    texCoord = uv * uvScale;
+}
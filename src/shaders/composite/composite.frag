@@ -0,0 +1,71 @@
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+// The canvas beneath the layers, which is opaque
+uniform sampler2D background;
+
+// The visible layers, bottom first, holding premultiplied colors. LAYER_MAX
+// matches LAYER_MAX in layer_stack.h.
+#define LAYER_MAX 8
+uniform sampler2D layers[LAYER_MAX];
+uniform float opacity[LAYER_MAX];
+uniform int blendMode[LAYER_MAX];
+uniform int numLayers;
+
+// The blend modes, matching BlendMode in layer_stack.h
+const int BLEND_NORMAL = 0;
+const int BLEND_MULTIPLY = 1;
+const int BLEND_SCREEN = 2;
+const int BLEND_OVERLAY = 3;
+
+// blendColors mixes a layer's color with the color beneath it
+vec3 blendColors(vec3 backdrop, vec3 source, int mode) {
+    if (mode == BLEND_MULTIPLY) {
+        return backdrop * source;
+    }
+    if (mode == BLEND_SCREEN) {
+        return backdrop + source - (backdrop * source);
+    }
+    if (mode == BLEND_OVERLAY) {
+        vec3 dark = 2.0 * backdrop * source;
+        vec3 light = 1.0 - (2.0 * (1.0 - backdrop) * (1.0 - source));
+        return mix(dark, light, step(0.5, backdrop));
+    }
+    return source;
+}
+
+// blendLayer blends a premultiplied layer over a premultiplied backdrop, as in
+// the W3C Compositing and Blending spec: the blended color is used as far as
+// the backdrop is opaque, then composited source over
+vec4 blendLayer(vec4 backdrop, vec4 layer, float layerOpacity, int mode) {
+    layer *= layerOpacity;
+    if (layer.a <= 0.0) {
+        return backdrop;
+    }
+
+    vec3 source = layer.rgb / layer.a;
+    vec3 beneath = backdrop.a > 0.0 ? backdrop.rgb / backdrop.a : vec3(0.0);
+    vec3 color = mix(source, blendColors(beneath, source, mode), backdrop.a);
+
+    return vec4((color * layer.a) + (backdrop.rgb * (1.0 - layer.a)), layer.a + (backdrop.a * (1.0 - layer.a)));
+}
+
+// Samplers in arrays may only be indexed with constants, so the layers are
+// blended by an unrolled loop
+#define BLEND_LAYER(i) if (i < numLayers) { color = blendLayer(color, texture(layers[i], texCoord), opacity[i], blendMode[i]); }
+
+void main() {
+    vec4 color = texture(background, texCoord);
+
+    BLEND_LAYER(0)
+    BLEND_LAYER(1)
+    BLEND_LAYER(2)
+    BLEND_LAYER(3)
+    BLEND_LAYER(4)
+    BLEND_LAYER(5)
+    BLEND_LAYER(6)
+    BLEND_LAYER(7)
+
+    FragColor = color;
+}
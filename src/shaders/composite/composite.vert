@@ -0,0 +1,9 @@
+// The compositor draws a single triangle covering the whole target. Its
+// corners are generated from the vertex ID, so no vertex buffer is needed.
+out vec2 texCoord;
+
+void main() {
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    texCoord = corner;
+    gl_Position = vec4((corner * 2.0) - 1.0, 0.0, 1.0);
+}
@@ -1,3 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-void main() { FragColor = vec4(0.0, 0.0, 1.0, 1.0); }
@@ -1,6 +0,0 @@
-#version 300 es
-precision highp float;
-out vec4 FragColor;
-void main() {
-  FragColor = vec4(0.0, 0.0, 1.0, 1.0);
-}
@@ -1,6 +0,0 @@
-#version 300 es
-layout (location = 0) in vec2 pos;
-void main() {
-    gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);
-    gl_PointSize = 20.0;
-}
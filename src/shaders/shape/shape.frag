@@ -0,0 +1,76 @@
+// Shapes are evaluated as signed distance fields: the distance to the shape's
+// edge, negative inside. Coverage falls off over a pixel around the edge, so
+// shapes are antialiased at any size and zoom.
+in vec2 canvasPos;
+out vec4 FragColor;
+
+const int SHAPE_LINE = 0;
+const int SHAPE_RECTANGLE = 1;
+const int SHAPE_ELLIPSE = 2;
+const int SHAPE_ROUNDED_RECTANGLE = 3;
+
+uniform int shapeKind;
+uniform vec2 shapeStart;
+uniform vec2 shapeEnd;
+uniform float strokeWidth;
+uniform float cornerRadius;
+uniform bool filled;
+uniform vec4 shapeColor;
+
+// The size of a frame buffer pixel in canvas space
+uniform float pixelSize;
+
+// segmentDistance returns the distance from p to the segment ab
+float segmentDistance(vec2 p, vec2 a, vec2 b) {
+    vec2 pa = p - a;
+    vec2 ba = b - a;
+    float t = clamp(dot(pa, ba) / max(dot(ba, ba), 1e-6), 0.0, 1.0);
+    return length(pa - (ba * t));
+}
+
+// boxDistance returns the signed distance from p to a box centered on the
+// origin, whose corners are rounded by radius
+float boxDistance(vec2 p, vec2 halfSize, float radius) {
+    vec2 q = abs(p) - halfSize + radius;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+// ellipseDistance approximates the signed distance from p to an ellipse
+// centered on the origin, by dividing its implicit function by its gradient
+float ellipseDistance(vec2 p, vec2 radii) {
+    radii = max(radii, vec2(1e-3));
+    float k0 = length(p / radii);
+    float k1 = length(p / (radii * radii));
+    return k1 > 0.0 ? k0 * (k0 - 1.0) / k1 : -min(radii.x, radii.y);
+}
+
+void main() {
+    float halfWidth = strokeWidth * 0.5;
+    float edgeDistance;
+
+    if (shapeKind == SHAPE_LINE) {
+        edgeDistance = segmentDistance(canvasPos, shapeStart, shapeEnd) - halfWidth;
+    } else {
+        vec2 center = (shapeStart + shapeEnd) * 0.5;
+        vec2 halfSize = abs(shapeEnd - shapeStart) * 0.5;
+        vec2 p = canvasPos - center;
+
+        if (shapeKind == SHAPE_ELLIPSE) {
+            edgeDistance = ellipseDistance(p, halfSize);
+        } else {
+            float radius = shapeKind == SHAPE_ROUNDED_RECTANGLE ? min(cornerRadius, min(halfSize.x, halfSize.y)) : 0.0;
+            edgeDistance = boxDistance(p, halfSize, radius);
+        }
+
+        // Outlines are centered on the edge, and filled shapes extend to the
+        // outside of the outline they would have
+        edgeDistance = filled ? edgeDistance - halfWidth : abs(edgeDistance) - halfWidth;
+    }
+
+    float coverage = clamp(0.5 - (edgeDistance / pixelSize), 0.0, 1.0);
+    if (coverage <= 0.0)
+        discard;
+
+    // Premultiplied, so the edge blends without darkening
+    FragColor = vec4(shapeColor.rgb, 1.0) * (shapeColor.a * coverage);
+}
@@ -0,0 +1,24 @@
+// Shapes are drawn as a single quad over their bounds. Its corners are
+// generated from the vertex ID, so no vertex buffer is needed.
+uniform mat4 viewProjection;
+
+uniform vec2 shapeStart;
+uniform vec2 shapeEnd;
+uniform float strokeWidth;
+
+// The size of a frame buffer pixel in canvas space
+uniform float pixelSize;
+
+out vec2 canvasPos;
+
+void main() {
+    // Grow the bounds by half the outline and a margin for the antialiased edge
+    float margin = (strokeWidth * 0.5) + (pixelSize * 2.0);
+    vec2 low = min(shapeStart, shapeEnd) - margin;
+    vec2 high = max(shapeStart, shapeEnd) + margin;
+
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    canvasPos = mix(low, high, corner);
+
+    gl_Position = viewProjection * vec4(canvasPos, 0.0, 1.0);
+}
@@ -0,0 +1,8 @@
+out vec4 FragColor;
+
+uniform vec4 sprayColor;
+
+void main() {
+    // Premultiplied alpha, blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(sprayColor.rgb * sprayColor.a, sprayColor.a);
+}
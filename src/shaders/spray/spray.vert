@@ -0,0 +1,46 @@
+// Sprays are drawn as particles generated on the GPU.
+//
+// Each vertex is a burst of the spray can, drawn once per instance: instance i
+// draws the i-th particle of the burst. Particles are scattered uniformly over
+// the burst's disc by hashing its seed with the particle's index, so a burst
+// always draws the same particles.
+layout (location = 0) in vec2 center;
+layout (location = 1) in float radius;
+layout (location = 2) in float numParticles;
+layout (location = 3) in uint seed;
+
+uniform mat4 viewProjection;
+uniform float pointSize;
+
+const float TWO_PI = 6.28318530718;
+
+// pcgHash is the PCG hash from Jarzynski and Olano's "Hash Functions for GPU
+// Rendering". It's integer arithmetic, so it's exact on every GPU.
+uint pcgHash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// unitFloat maps a hash to [0, 1) from its top 24 bits, which a float holds exactly
+float unitFloat(uint hash) {
+    return float(hash >> 8u) * (1.0 / 16777216.0);
+}
+
+void main() {
+    if (float(gl_InstanceID) >= numParticles) {
+        // The burst has fewer particles, so move this one outside the clip volume
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        return;
+    }
+
+    uint hash = pcgHash(seed ^ pcgHash(uint(gl_InstanceID)));
+    float angle = unitFloat(hash) * TWO_PI;
+    float offset = radius * sqrt(unitFloat(pcgHash(hash)));
+    vec2 pos = center + (vec2(cos(angle), sin(angle)) * offset);
+
+    // Transform the particle from canvas space to clip space
+    gl_Position = viewProjection * vec4(pos, 0.0, 1.0);
+    gl_PointSize = pointSize;  // size in pixels
+}
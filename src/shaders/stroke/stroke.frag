@@ -0,0 +1,41 @@
+out vec4 FragColor;
+
+uniform float pointSize;
+
+#ifdef ANTIALIASED
+// How much of the stamp's radius is solid before its edge starts to fade, from
+// 0 for a soft brush to 1 for a hard one
+uniform float hardness;
+
+// Matches the margin the sprites are widened by in the vertex shader
+const float ANTIALIAS_MARGIN = 1.0;
+#endif
+
+#ifdef TEXTURED
+// The brush tip, whose red channel is the coverage of the stamp
+uniform sampler2D stampTexture;
+#endif
+
+// The brush color, straight rather than premultiplied
+uniform vec4 strokeColor;
+
+void main() {
+    float coverage = 1.0;
+
+#ifdef ANTIALIASED
+    // Round the square point sprite into a disc from its distance field, in
+    // pixels. The edge fades over the soft part of the radius, and over at least
+    // a pixel so hard brushes are antialiased too.
+    float radius = pointSize * 0.5;
+    float edgeDistance = radius - length(gl_PointCoord - vec2(0.5)) * (pointSize + ANTIALIAS_MARGIN);
+    float softness = max((1.0 - hardness) * radius, 1.0);
+    coverage *= smoothstep(0.0, softness, edgeDistance + 0.5);
+#endif
+
+#ifdef TEXTURED
+    coverage *= texture(stampTexture, gl_PointCoord).r;
+#endif
+
+    // Premultiplied alpha, blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(strokeColor.rgb, 1.0) * (strokeColor.a * coverage);
+}
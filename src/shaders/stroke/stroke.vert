@@ -0,0 +1,60 @@
+// Strokes are drawn as point sprite stamps.
+//
+// Instanced strokes upload segments rather than stamps. Each vertex is a
+// segment, drawn once per instance: instance i draws the i-th stamp of the
+// segment, spaced evenly up to its end.
+//
+// Strokes drawn with a symmetry draw their copies as further ranges of
+// stampsPerCopy instances, each moved by its copy's transform.
+#ifdef INSTANCED
+layout (location = 0) in vec2 start;
+layout (location = 1) in vec2 end;
+layout (location = 2) in float numStamps;
+#else
+layout (location = 0) in vec2 pos;
+#endif
+
+uniform mat4 viewProjection;
+uniform float pointSize;
+
+// The transforms of the stroke's copies after the stroke itself, and the
+// instances drawn per copy. SYMMETRY_MAX_COPIES matches SYMMETRY_MAX_COPIES in symmetry.h.
+#define SYMMETRY_MAX_COPIES 16
+uniform mat4 copyTransforms[SYMMETRY_MAX_COPIES - 1];
+uniform int stampsPerCopy;
+
+#ifdef ANTIALIASED
+// Antialiased stamps fade out over the half pixel beyond their radius, so their
+// sprites are a pixel wider than the stamp
+const float ANTIALIAS_MARGIN = 1.0;
+#endif
+
+void main() {
+#ifdef INSTANCED
+    int copy = gl_InstanceID / stampsPerCopy;
+    float stamp = float(gl_InstanceID - (copy * stampsPerCopy) + 1);
+    if (stamp > numStamps) {
+        // The segment has fewer stamps, so move this one outside the clip volume
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        return;
+    }
+
+    vec2 position = mix(start, end, stamp / numStamps);
+#else
+    int copy = gl_InstanceID;
+    vec2 position = pos;
+#endif
+
+    if (copy > 0) {
+        position = (copyTransforms[copy - 1] * vec4(position, 0.0, 1.0)).xy;
+    }
+
+    // Transform the stamp from canvas space to clip space
+    gl_Position = viewProjection * vec4(position, 0.0, 1.0);
+#ifdef ANTIALIASED
+    gl_PointSize = pointSize + ANTIALIAS_MARGIN;  // size in pixels
+#else
+    gl_PointSize = pointSize;  // size in pixels
+#endif
+}
@@ -0,0 +1,45 @@
+#include "shape.h"
+
+// Shape creates a shape of zero size at start, rendered with the given shader
+Shape::Shape(uint32_t id, Shader &shader, ShapeKind kind, glm::vec2 start, float strokeWidth, bool filled,
+             uint32_t color)
+    : id(id), kind(kind), start(start), end(start), strokeWidth(strokeWidth), filled(filled), color(color),
+      layer(0), shader(shader) {
+  // The core profile needs a vertex array bound to draw, even one without attributes
+  glGenVertexArrays(1, &(this->VAO));
+}
+
+// Cleanup
+Shape::~Shape() { glDeleteVertexArrays(1, &(this->VAO)); }
+
+// draws the shape to the screen. The shader's viewProjection and pixelSize
+// uniforms must already be set for the frame.
+void Shape::draw() {
+  this->shader.use();
+  this->shader.setInt("shapeKind", int(this->kind));
+  this->shader.setVec2("shapeStart", this->start.x, this->start.y);
+  this->shader.setVec2("shapeEnd", this->end.x, this->end.y);
+  this->shader.setFloat("strokeWidth", this->strokeWidth);
+  this->shader.setFloat("cornerRadius", SHAPE_CORNER_RADIUS);
+  this->shader.setInt("filled", this->filled && this->kind != ShapeKind::Line);
+  this->shader.setVec4("shapeColor", float(this->color & 0xFF) / 255.0f, float((this->color >> 8) & 0xFF) / 255.0f,
+                       float((this->color >> 16) & 0xFF) / 255.0f, float(this->color >> 24) / 255.0f);
+
+  // The shader writes premultiplied coverage, blended over what's beneath
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  glBindVertexArray(this->VAO);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  glDisable(GL_BLEND);
+}
+
+// bounds returns the bounding box of the shape, including its outline
+Rect Shape::bounds() const {
+  Rect bounds = Rect::empty();
+  bounds.expand(this->start);
+  bounds.expand(this->end);
+
+  return bounds.inflated(this->strokeWidth / 2);
+}
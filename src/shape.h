@@ -0,0 +1,72 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+#include "drawable.h"
+#include "rect.h"
+#include "shader.h"
+#include <cstdint>
+
+// The radius in canvas space of a rounded rectangle's corners. Small rectangles
+// round their corners by at most half their shorter side.
+const float SHAPE_CORNER_RADIUS = 16.0f;
+
+// ShapeKind is the kind of a shape drawn with a shape tool. The values match
+// the SHAPE_ constants of the shape shader.
+enum class ShapeKind {
+  Line = 0,
+  Rectangle = 1,
+  Ellipse = 2,
+  RoundedRectangle = 3,
+};
+
+// Shape is a line, rectangle, ellipse or rounded rectangle, either filled or
+// outlined. Shapes are resolution independent: each is drawn as a single quad
+// over its bounds, whose fragment shader evaluates the shape's signed distance
+// field and antialiases its edge over a pixel. Drawing a shape costs the same
+// at any size, and changing one, e.g while it's dragged out, only changes the
+// uniforms it's drawn with.
+//
+// A line runs from start to end, and other shapes fill the box with start and
+// end at opposite corners. Positions are stored in canvas space.
+class Shape : public Drawable {
+public:
+  // Shape creates a shape of zero size at start, rendered with the given shader
+  Shape(uint32_t id, Shader &shader, ShapeKind kind, glm::vec2 start, float strokeWidth, bool filled,
+        uint32_t color);
+  ~Shape();
+
+  Shape(const Shape &) = delete;
+  Shape &operator=(const Shape &) = delete;
+
+  // draws the shape to the screen. The shader's viewProjection and pixelSize
+  // uniforms must already be set for the frame.
+  virtual void draw();
+
+  // bounds returns the bounding box of the shape, including its outline
+  Rect bounds() const;
+
+  // The identifier of the shape, ordered with the strokes it's drawn between
+  uint32_t id;
+
+  ShapeKind kind;
+  glm::vec2 start, end;
+
+  // The width of the outline, or of the line, in canvas space
+  float strokeWidth;
+
+  // Whether the inside of the shape is filled. Lines are never filled.
+  bool filled;
+
+  // The color of the shape, as packed RGBA8
+  uint32_t color;
+
+  // The ID of the layer the shape is drawn on
+  uint32_t layer;
+
+private:
+  // Shader internals. The quad's corners are generated from the vertex ID, so
+  // its vertex array has no buffers.
+  Shader &shader;
+  unsigned int VAO;
+};
+
+#endif // SHAPE_H
@@ -0,0 +1,73 @@
+#include "simplify.h"
+#include <cstddef>
+#include <utility>
+
+// distanceSquaredToSegment returns the squared distance from a point to the segment ab
+static float distanceSquaredToSegment(glm::vec2 point, glm::vec2 a, glm::vec2 b) {
+  glm::vec2 ab = b - a;
+  float lengthSquared = glm::dot(ab, ab);
+
+  float t = 0;
+  if (lengthSquared > 0) {
+    t = glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f);
+  }
+
+  glm::vec2 delta = point - (a + (ab * t));
+  return glm::dot(delta, delta);
+}
+
+// simplifyPolyline simplifies a polyline with the Ramer–Douglas–Peucker
+// algorithm. Points which lie within tolerance of the simplified line are
+// dropped; the first and last points are always kept. The simplified polyline
+// is written to out.
+//
+// Ranges still to be simplified are kept on an explicit stack rather than
+// recursing, so long strokes can't overflow the call stack of a worker thread.
+void simplifyPolyline(const std::vector<glm::vec2> &points, float tolerance, std::vector<glm::vec2> &out) {
+  out.clear();
+
+  if (points.size() <= 2) {
+    out = points;
+    return;
+  }
+
+  float toleranceSquared = tolerance * tolerance;
+
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+
+  std::vector<std::pair<size_t, size_t> > ranges;
+  ranges.push_back({0, points.size() - 1});
+
+  while (!ranges.empty()) {
+    size_t first = ranges.back().first;
+    size_t last = ranges.back().second;
+    ranges.pop_back();
+
+    // Find the point furthest from the line between the ends of the range
+    float furthestDistance = 0;
+    size_t furthest = first;
+    for (size_t i = first + 1; i < last; i++) {
+      float distance = distanceSquaredToSegment(points[i], points[first], points[last]);
+      if (distance > furthestDistance) {
+        furthestDistance = distance;
+        furthest = i;
+      }
+    }
+
+    // Keep the furthest point if the line strays too far from it, and
+    // simplify either side of it
+    if (furthestDistance > toleranceSquared) {
+      keep[furthest] = true;
+      ranges.push_back({first, furthest});
+      ranges.push_back({furthest, last});
+    }
+  }
+
+  for (size_t i = 0; i < points.size(); i++) {
+    if (keep[i]) {
+      out.push_back(points[i]);
+    }
+  }
+}
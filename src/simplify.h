@@ -0,0 +1,12 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+#include "../vendor/glm/glm/glm.hpp"
+#include <vector>
+
+// simplifyPolyline simplifies a polyline with the Ramer–Douglas–Peucker
+// algorithm. Points which lie within tolerance of the simplified line are
+// dropped; the first and last points are always kept. The simplified polyline
+// is written to out.
+void simplifyPolyline(const std::vector<glm::vec2> &points, float tolerance, std::vector<glm::vec2> &out);
+
+#endif // SIMPLIFY_H
@@ -0,0 +1,140 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+// SpatialIndex creates an empty index with square cells of the given size
+SpatialIndex::SpatialIndex(float cellSize) : cellSize(cellSize), numSegments(0) {}
+
+// cellCoord returns the cell coordinate containing a canvas coordinate
+int SpatialIndex::cellCoord(float value) const {
+  return int(std::floor(value / this->cellSize));
+}
+
+// cellKey packs a pair of cell coordinates into a hash key
+uint64_t SpatialIndex::cellKey(int x, int y) {
+  return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+}
+
+// insert adds a stroke segment with the given bounding box to the index
+void SpatialIndex::insert(uint32_t strokeId, uint32_t segment, const Rect &bounds) {
+  StrokeCells &stroke = this->strokes[strokeId];
+
+  int minX = this->cellCoord(bounds.min.x);
+  int minY = this->cellCoord(bounds.min.y);
+  int maxX = this->cellCoord(bounds.max.x);
+  int maxY = this->cellCoord(bounds.max.y);
+
+  for (int y = minY; y <= maxY; y++) {
+    for (int x = minX; x <= maxX; x++) {
+      uint64_t key = cellKey(x, y);
+      std::vector<Entry> &entries = this->cells[key];
+
+      // Consecutive segments of a stroke usually land in the same cell, so only
+      // record the cell for the stroke the first time we see it in a row
+      if (entries.empty() || entries.back().strokeId != strokeId) {
+        stroke.cells.push_back(key);
+      }
+
+      entries.push_back(Entry{bounds, strokeId, segment});
+    }
+  }
+
+  stroke.numSegments += 1;
+  this->numSegments += 1;
+}
+
+// remove drops every segment belonging to a stroke from the index
+void SpatialIndex::remove(uint32_t strokeId) {
+  auto stroke = this->strokes.find(strokeId);
+  if (stroke == this->strokes.end())
+    return;
+
+  std::vector<uint64_t> &strokeCells = stroke->second.cells;
+  std::sort(strokeCells.begin(), strokeCells.end());
+  strokeCells.erase(std::unique(strokeCells.begin(), strokeCells.end()), strokeCells.end());
+
+  for (uint64_t key : strokeCells) {
+    auto cell = this->cells.find(key);
+    if (cell == this->cells.end())
+      continue;
+
+    std::vector<Entry> &entries = cell->second;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [strokeId](const Entry &entry) { return entry.strokeId == strokeId; }),
+                  entries.end());
+
+    if (entries.empty()) {
+      this->cells.erase(cell);
+    }
+  }
+
+  this->numSegments -= stroke->second.numSegments;
+  this->strokes.erase(stroke);
+}
+
+// query appends every segment whose bounding box overlaps the given area
+// to results. Each segment is reported at most once.
+void SpatialIndex::query(const Rect &area, std::vector<SegmentRef> &results) const {
+  if (area.isEmpty() || this->cells.empty())
+    return;
+
+  int minX = this->cellCoord(area.min.x);
+  int minY = this->cellCoord(area.min.y);
+  int maxX = this->cellCoord(area.max.x);
+  int maxY = this->cellCoord(area.max.y);
+
+  // When the area spans more cells than are occupied (e.g a zoomed out view)
+  // it is cheaper to walk the occupied cells than the cells of the area
+  double areaCells = double(maxX - minX + 1) * double(maxY - minY + 1);
+  if (areaCells > double(this->cells.size())) {
+    for (const auto &cell : this->cells) {
+      int x = int(uint32_t(cell.first >> 32));
+      int y = int(uint32_t(cell.first));
+
+      if (x < minX || x > maxX || y < minY || y > maxY)
+        continue;
+
+      this->queryEntries(x, y, cell.second, area, results);
+    }
+    return;
+  }
+
+  for (int y = minY; y <= maxY; y++) {
+    for (int x = minX; x <= maxX; x++) {
+      auto cell = this->cells.find(cellKey(x, y));
+      if (cell == this->cells.end())
+        continue;
+
+      this->queryEntries(x, y, cell->second, area, results);
+    }
+  }
+}
+
+// queryEntries reports the entries of a single cell which overlap an area.
+// A segment spanning several cells is only reported by the cell containing the
+// minimum corner of its overlap with the area, which avoids duplicate results
+// without a separate de-duplication pass.
+void SpatialIndex::queryEntries(int x, int y, const std::vector<Entry> &entries, const Rect &area,
+                                std::vector<SegmentRef> &results) const {
+  for (const Entry &entry : entries) {
+    if (!entry.bounds.intersects(area))
+      continue;
+
+    int ownerX = this->cellCoord(std::max(entry.bounds.min.x, area.min.x));
+    int ownerY = this->cellCoord(std::max(entry.bounds.min.y, area.min.y));
+    if (ownerX != x || ownerY != y)
+      continue;
+
+    results.push_back(SegmentRef{entry.strokeId, entry.segment});
+  }
+}
+
+// size returns the number of segments in the index
+size_t SpatialIndex::size() const { return this->numSegments; }
+
+// clear removes every segment from the index
+void SpatialIndex::clear() {
+  this->cells.clear();
+  this->strokes.clear();
+  this->numSegments = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+#include "rect.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// SegmentRef identifies a single segment of a stroke
+struct SegmentRef {
+  uint32_t strokeId;
+  uint32_t segment;
+};
+
+// SpatialIndex is a uniform grid over the bounding boxes of stroke segments.
+// Each segment is bucketed into every cell its bounding box overlaps, so a
+// query only visits the cells under the queried area and its cost depends on
+// the local density of the drawing rather than on its total size.
+// Cells are hashed, so the grid is unbounded in every direction.
+class SpatialIndex {
+public:
+  // SpatialIndex creates an empty index with square cells of the given size
+  explicit SpatialIndex(float cellSize = 64.0f);
+
+  // insert adds a stroke segment with the given bounding box to the index
+  void insert(uint32_t strokeId, uint32_t segment, const Rect &bounds);
+
+  // remove drops every segment belonging to a stroke from the index
+  void remove(uint32_t strokeId);
+
+  // query appends every segment whose bounding box overlaps the given area
+  // to results. Each segment is reported at most once.
+  void query(const Rect &area, std::vector<SegmentRef> &results) const;
+
+  // size returns the number of segments in the index
+  size_t size() const;
+
+  // clear removes every segment from the index
+  void clear();
+
+private:
+  // Entry is a segment stored in a grid cell
+  struct Entry {
+    Rect bounds;
+    uint32_t strokeId;
+    uint32_t segment;
+  };
+
+  // StrokeCells tracks the cells a stroke's segments were bucketed into so the
+  // stroke can be removed without scanning the grid
+  struct StrokeCells {
+    std::vector<uint64_t> cells;
+    size_t numSegments = 0;
+  };
+
+  float cellSize;
+  size_t numSegments;
+
+  std::unordered_map<uint64_t, std::vector<Entry> > cells;
+  std::unordered_map<uint32_t, StrokeCells> strokes;
+
+  // cellCoord returns the cell coordinate containing a canvas coordinate
+  int cellCoord(float value) const;
+
+  // cellKey packs a pair of cell coordinates into a hash key
+  static uint64_t cellKey(int x, int y);
+
+  // queryEntries reports the entries of a single cell which overlap an area
+  void queryEntries(int x, int y, const std::vector<Entry> &entries, const Rect &area,
+                    std::vector<SegmentRef> &results) const;
+};
+
+#endif // SPATIAL_INDEX_H
@@ -0,0 +1,90 @@
+#include "spray.h"
+#include <algorithm>
+
+// Spray creates an empty spray which is rendered with the given shader
+Spray::Spray(uint32_t id, Shader &shader, uint32_t color)
+    : id(id), color(color), layer(0), bounds(Rect::empty()), shader(shader), numUploadedBursts(0), bufferCapacity(0),
+      maxParticles(0) {
+  // Setup the vertex buffers
+  glGenVertexArrays(1, &(this->VAO));
+  glGenBuffers(1, &(this->VBO));
+
+  glBindVertexArray(this->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+
+  // Set vertex attribute pointers. Each vertex is a burst, and the seed is read
+  // as an integer so the shader hashes it exactly.
+  GLsizei stride = sizeof(SprayBurst);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(SprayBurst, center));
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(SprayBurst, radius));
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(SprayBurst, numParticles));
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, stride, (void *)offsetof(SprayBurst, seed));
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  glEnableVertexAttribArray(3);
+
+  // Unbind
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+// Cleanup
+Spray::~Spray() {
+  glDeleteVertexArrays(1, &(this->VAO));
+  glDeleteBuffers(1, &(this->VBO));
+}
+
+// addBurst appends a burst to the spray. At most SPRAY_MAX_PARTICLES of its
+// particles are drawn.
+void Spray::addBurst(const SprayBurst &burst) {
+  this->bursts.push_back(burst);
+  this->maxParticles = std::max(this->maxParticles, std::min(int(burst.numParticles), SPRAY_MAX_PARTICLES));
+  this->bounds.expand(Rect::around(burst.center, burst.radius + SPRAY_PARTICLE_SIZE));
+}
+
+// upload uploads the bursts added since the spray was last drawn
+void Spray::upload() {
+  if (this->numUploadedBursts == this->bursts.size())
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+
+  if (this->bursts.size() > this->bufferCapacity) {
+    size_t capacity = std::max(this->bursts.size(), this->bufferCapacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(SprayBurst), nullptr, GL_DYNAMIC_DRAW);
+
+    this->bufferCapacity = capacity;
+    this->numUploadedBursts = 0;
+  }
+
+  size_t pending = this->bursts.size() - this->numUploadedBursts;
+  glBufferSubData(GL_ARRAY_BUFFER, this->numUploadedBursts * sizeof(SprayBurst), pending * sizeof(SprayBurst),
+                  this->bursts.data() + this->numUploadedBursts);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  this->numUploadedBursts = this->bursts.size();
+}
+
+// draws the spray's particles to the screen. The shader's viewProjection and
+// pointSize uniforms must already be set for the frame.
+void Spray::draw() {
+  if (this->bursts.empty() || this->maxParticles == 0)
+    return;
+
+  this->upload();
+
+  this->shader.use();
+  this->shader.setVec4("sprayColor", float(this->color & 0xFF) / 255.0f, float((this->color >> 8) & 0xFF) / 255.0f,
+                       float((this->color >> 16) & 0xFF) / 255.0f, float(this->color >> 24) / 255.0f);
+
+  // The shader writes premultiplied color, blended over what's beneath
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  glBindVertexArray(this->VAO);
+  glDrawArraysInstanced(GL_POINTS, 0, GLsizei(this->bursts.size()), this->maxParticles);
+
+  glDisable(GL_BLEND);
+}
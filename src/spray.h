@@ -0,0 +1,69 @@
+#ifndef SPRAY_H
+#define SPRAY_H
+#include "drawable.h"
+#include "rect.h"
+#include "shader.h"
+#include "spray_burst.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The most particles a single burst draws
+const int SPRAY_MAX_PARTICLES = 256;
+
+// The size of a spray particle in canvas space. Particles are drawn at least a
+// pixel wide however far the view is zoomed out.
+const float SPRAY_PARTICLE_SIZE = 1.0f;
+
+// Spray is the paint sprayed in a single draw session, drawn like an airbrush
+// as random particles around the cursor. It's a list of bursts, one per frame
+// the spray can was held down, all drawn with a single instanced draw call:
+// each burst is a vertex, and instance i draws its i-th particle.
+class Spray : public Drawable {
+public:
+  // Spray creates an empty spray which is rendered with the given shader
+  Spray(uint32_t id, Shader &shader, uint32_t color);
+  ~Spray();
+
+  Spray(const Spray &) = delete;
+  Spray &operator=(const Spray &) = delete;
+
+  // addBurst appends a burst to the spray. At most SPRAY_MAX_PARTICLES of its
+  // particles are drawn.
+  void addBurst(const SprayBurst &burst);
+
+  // draws the spray's particles to the screen. The shader's viewProjection and
+  // pointSize uniforms must already be set for the frame.
+  virtual void draw();
+
+  // The identifier of the spray, ordered with the strokes it's drawn between
+  uint32_t id;
+
+  // The color of the particles, as packed RGBA8
+  uint32_t color;
+
+  // The ID of the layer the spray is drawn on
+  uint32_t layer;
+
+  std::vector<SprayBurst> bursts;
+
+  // The bounding box of the spray's bursts
+  Rect bounds;
+
+private:
+  // upload uploads the bursts added since the spray was last drawn
+  void upload();
+
+  // Shader internals
+  Shader &shader;
+  unsigned int VBO, VAO;
+
+  // The number of bursts uploaded and the capacity of the vertex buffer
+  size_t numUploadedBursts;
+  size_t bufferCapacity;
+
+  // The most particles drawn by any burst, i.e the instances drawn
+  int maxParticles;
+};
+
+#endif // SPRAY_H
@@ -0,0 +1,16 @@
+#ifndef SPRAY_BURST_H
+#define SPRAY_BURST_H
+#include <cstdint>
+#include "../vendor/glm/glm/glm.hpp"
+
+// SprayBurst is what a spray can emits in one frame. Only the burst is
+// uploaded: the spray shader generates its particles from the seed, so a burst
+// always draws the same particles.
+struct SprayBurst {
+  glm::vec2 center;
+  float radius;
+  float numParticles;
+  uint32_t seed;
+};
+
+#endif // SPRAY_BURST_H
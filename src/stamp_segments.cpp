@@ -0,0 +1,29 @@
+#include "stamp_segments.h"
+#include <algorithm>
+#include <cmath>
+
+// appendStampSegments appends segments holding stamps spaced at most gap apart
+// along the line from a to b, excluding a. It returns the number of stamps added.
+// The stamps are the ones a linear interpolation from a to b would place; lines
+// with more than STAMP_SEGMENT_MAX_STAMPS stamps are cut into several segments
+// at stamp positions, keeping the spacing unchanged.
+int appendStampSegments(glm::vec2 a, glm::vec2 b, float gap, std::vector<StampSegment> &segments) {
+  glm::vec2 d = b - a;
+  float distance = std::sqrt(glm::dot(d, d));
+
+  if (distance <= 0) {
+    // Nothing to interpolate
+    return 0;
+  }
+
+  int numStamps = int(std::ceil(distance / gap));
+
+  for (int first = 0; first < numStamps; first += STAMP_SEGMENT_MAX_STAMPS) {
+    int last = std::min(first + STAMP_SEGMENT_MAX_STAMPS, numStamps);
+
+    glm::vec2 end = last == numStamps ? b : a + (d * (float(last) / float(numStamps)));
+    segments.push_back(StampSegment{end, float(last - first)});
+  }
+
+  return numStamps;
+}
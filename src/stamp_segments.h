@@ -0,0 +1,23 @@
+#ifndef STAMP_SEGMENTS_H
+#define STAMP_SEGMENTS_H
+#include "../vendor/glm/glm/glm.hpp"
+#include <vector>
+
+// The most stamps a single segment interpolates. Longer segments are split, so
+// every segment is drawn with at most this many instances.
+const int STAMP_SEGMENT_MAX_STAMPS = 8;
+
+// StampSegment is a run of evenly spaced stamps along a line, uploaded in place
+// of the stamps themselves. Its stamps lie between the end of the previous
+// segment, exclusive, and its own end, inclusive, and the stroke shader
+// interpolates their positions.
+struct StampSegment {
+  glm::vec2 end;
+  float numStamps;
+};
+
+// appendStampSegments appends segments holding stamps spaced at most gap apart
+// along the line from a to b, excluding a. It returns the number of stamps added.
+int appendStampSegments(glm::vec2 a, glm::vec2 b, float gap, std::vector<StampSegment> &segments);
+
+#endif // STAMP_SEGMENTS_H
@@ -0,0 +1,61 @@
+#include "startup_profile.h"
+
+// StartupProfile starts timing the first phase
+StartupProfile::StartupProfile()
+    : start(std::chrono::steady_clock::now()), lastMark(start), durations(), complete(false) {}
+
+// finish marks a phase as finished now. Phases may be skipped, e.g on
+// platforms without them, and are then counted as taking no time.
+void StartupProfile::finish(StartupPhase phase) {
+  auto now = std::chrono::steady_clock::now();
+
+  this->durations[int(phase)] = std::chrono::duration<double, std::milli>(now - this->lastMark).count();
+  this->lastMark = now;
+
+  if (phase == StartupPhase::FirstSwap) {
+    this->complete = true;
+  }
+}
+
+// isComplete indicates whether every phase up to the first swap has finished
+bool StartupProfile::isComplete() const { return this->complete; }
+
+// phaseMs returns how long a phase took in milliseconds, or 0 if it hasn't finished
+double StartupProfile::phaseMs(StartupPhase phase) const { return this->durations[int(phase)]; }
+
+// totalMs returns the milliseconds from the start until the last finished phase
+double StartupProfile::totalMs() const {
+  return std::chrono::duration<double, std::milli>(this->lastMark - this->start).count();
+}
+
+// name returns the name of a phase, e.g for logs
+const char *StartupProfile::name(StartupPhase phase) {
+  switch (phase) {
+  case StartupPhase::GlfwInit:
+    return "glfwInit";
+  case StartupPhase::CreateWindow:
+    return "createWindow";
+  case StartupPhase::LoadGL:
+    return "loadGL";
+  case StartupPhase::CompileShaders:
+    return "compileShaders";
+  case StartupPhase::Setup:
+    return "setup";
+  case StartupPhase::FirstTick:
+    return "firstTick";
+  case StartupPhase::FirstSwap:
+    return "firstSwap";
+  }
+
+  return "unknown";
+}
+
+// writeJson writes the phases as a JSON object of milliseconds
+void StartupProfile::writeJson(FILE *file) const {
+  fprintf(file, "{");
+  for (int i = 0; i < STARTUP_NUM_PHASES; i++) {
+    StartupPhase phase = StartupPhase(i);
+    fprintf(file, "%s\"%sMs\": %.3f", i == 0 ? "" : ", ", StartupProfile::name(phase), this->phaseMs(phase));
+  }
+  fprintf(file, "}");
+}
@@ -0,0 +1,58 @@
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+#include <chrono>
+#include <cstdio>
+
+// StartupPhase is a step of starting the engine, in the order they run
+enum class StartupPhase {
+  // Initialising GLFW
+  GlfwInit,
+  // Creating the window and its GL context
+  CreateWindow,
+  // Loading the GL functions and registering callbacks
+  LoadGL,
+  // Compiling the startup shaders, or loading their binaries
+  CompileShaders,
+  // Creating the canvas and recovering the last session's drawing
+  Setup,
+  // Running the first tick, up to submitting the frame
+  FirstTick,
+  // Swapping the first frame's buffers
+  FirstSwap,
+};
+
+const int STARTUP_NUM_PHASES = int(StartupPhase::FirstSwap) + 1;
+
+// StartupProfile times each phase of starting the engine up to its first
+// presented frame. Phases are marked as they finish; each lasts from the end
+// of the phase before it, or from when the profile was created.
+class StartupProfile {
+public:
+  // StartupProfile starts timing the first phase
+  StartupProfile();
+
+  // finish marks a phase as finished now
+  void finish(StartupPhase phase);
+
+  // isComplete indicates whether every phase up to the first swap has finished
+  bool isComplete() const;
+
+  // phaseMs returns how long a phase took in milliseconds, or 0 if it hasn't finished
+  double phaseMs(StartupPhase phase) const;
+
+  // totalMs returns the milliseconds from the start until the last finished phase
+  double totalMs() const;
+
+  // name returns the name of a phase, e.g for logs
+  static const char *name(StartupPhase phase);
+
+  // writeJson writes the phases as a JSON object of milliseconds
+  void writeJson(FILE *file) const;
+
+private:
+  std::chrono::steady_clock::time_point start, lastMark;
+  double durations[STARTUP_NUM_PHASES];
+  bool complete;
+};
+
+#endif // STARTUP_PROFILE_H
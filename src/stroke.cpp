@@ -0,0 +1,406 @@
+#include "stroke.h"
+#include "simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+// The distance in canvas space between stamps interpolated along a segment
+const float STAMP_GAP_SIZE = 10;
+
+// The largest error, in frame buffer pixels, a level of detail may introduce
+const float LOD_PIXEL_TOLERANCE = 1.0f;
+
+// lodTolerance returns the simplification tolerance and stamp spacing of a
+// level of detail in canvas space
+static float lodTolerance(int level) { return STAMP_GAP_SIZE * float(1 << level); }
+
+// Stroke creates an empty stroke which is rendered with the given shader
+Stroke::Stroke(uint32_t id, Shader &shader, float radius)
+    : id(id), radius(radius), layer(0), symmetry{SymmetryMode::None, 1, glm::vec2{0.0f, 0.0f}}, numStamps(0),
+      bounds(Rect::empty()), shader(shader), numUploadedSegments(0), bufferCapacity(0), maxSegmentStamps(1),
+      sealed(false), lodsBuilt(false), lodsUploaded(false) {
+  // Setup the vertex buffers
+  glGenVertexArrays(1, &(this->VAO));
+  glGenBuffers(1, &(this->VBO));
+
+  glBindVertexArray(this->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+
+  // Set vertex attribute pointers. Each vertex is a segment, which starts at the
+  // end of the segment before it, so the start and end attributes read the same
+  // buffer one segment apart.
+  GLsizei stride = sizeof(StampSegment);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(StampSegment, end));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void *)(stride + offsetof(StampSegment, end)));
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void *)(stride + offsetof(StampSegment, numStamps)));
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+
+  // Unbind
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+// Cleanup
+Stroke::~Stroke() {
+  glDeleteVertexArrays(1, &(this->VAO));
+  glDeleteBuffers(1, &(this->VBO));
+}
+
+// addSample appends a cursor sample to the stroke and interpolates stamps
+// between it and the previous sample. It returns the number of stamps added.
+// We linearly interpolate between samples to minimise the gaps in the stroke
+// line when the mouse moves quickly. Only the segment is stored; its stamps are
+// placed by the stroke shader.
+int Stroke::addSample(glm::vec2 position) {
+  if (this->samples.empty()) {
+    this->samples.push_back(position);
+    this->segments.push_back(StampSegment{position, 0});
+    this->segments.push_back(StampSegment{position, 1});
+    this->numStamps = 1;
+    this->bounds.expand(this->symmetry.bounds(Rect::around(position, this->radius)));
+
+    return 1;
+  }
+
+  size_t first = this->segments.size();
+  int numAdded = appendStampSegments(this->samples.back(), position, STAMP_GAP_SIZE, this->segments);
+  if (numAdded == 0)
+    return 0;
+
+  for (size_t i = first; i < this->segments.size(); i++) {
+    this->maxSegmentStamps = std::max(this->maxSegmentStamps, int(this->segments[i].numStamps));
+  }
+
+  this->samples.push_back(position);
+  this->numStamps += numAdded;
+  this->bounds.expand(this->symmetry.bounds(Rect::around(position, this->radius)));
+
+  return numAdded;
+}
+
+// rebuild recomputes the stroke's stamps and bounds from its samples, e.g
+// after the samples have been loaded from a document
+void Stroke::rebuild() {
+  std::vector<glm::vec2> samples = std::move(this->samples);
+
+  this->samples.clear();
+  this->samples.reserve(samples.size());
+  this->segments.clear();
+  this->numStamps = 0;
+  this->bounds = Rect::empty();
+  this->numUploadedSegments = 0;
+  this->maxSegmentStamps = 1;
+  this->lods = StrokeLods();
+  this->lodsBuilt = false;
+  this->lodsUploaded = false;
+
+  for (const glm::vec2 &sample : samples) {
+    this->addSample(sample);
+  }
+}
+
+// seal marks the stroke as finished. Sealed strokes receive no more samples.
+void Stroke::seal() { this->sealed = true; }
+
+// isSealed indicates whether the stroke has been finished
+bool Stroke::isSealed() const { return this->sealed; }
+
+// upload copies segments which have not been uploaded yet into the VBO.
+// The VBO grows geometrically, so a stroke being drawn only uploads the segments
+// added since the previous frame. Levels of detail are stored after the full
+// resolution segments once they have been built.
+void Stroke::upload() {
+  if (this->lodsBuilt && !this->lodsUploaded) {
+    size_t numSegments = this->segments.size() + this->lods.segments.size();
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBufferData(GL_ARRAY_BUFFER, numSegments * sizeof(StampSegment), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->segments.size() * sizeof(StampSegment), this->segments.data());
+    glBufferSubData(GL_ARRAY_BUFFER, this->segments.size() * sizeof(StampSegment),
+                    this->lods.segments.size() * sizeof(StampSegment), this->lods.segments.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->bufferCapacity = numSegments;
+    this->numUploadedSegments = this->segments.size();
+    this->lodsUploaded = true;
+    return;
+  }
+
+  if (this->numUploadedSegments == this->segments.size())
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+
+  if (this->segments.size() > this->bufferCapacity) {
+    // Sealed strokes never grow, so size their buffer exactly
+    size_t capacity = this->sealed ? this->segments.size()
+                                   : std::max(this->segments.size(), this->bufferCapacity * 2);
+
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(StampSegment), nullptr,
+                 this->sealed ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+
+    this->bufferCapacity = capacity;
+    this->numUploadedSegments = 0;
+  }
+
+  size_t pending = this->segments.size() - this->numUploadedSegments;
+  glBufferSubData(GL_ARRAY_BUFFER, this->numUploadedSegments * sizeof(StampSegment),
+                  pending * sizeof(StampSegment), this->segments.data() + this->numUploadedSegments);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  this->numUploadedSegments = this->segments.size();
+}
+
+// draws the stroke's stamps to the screen
+void Stroke::draw() { this->drawLevel(0); }
+
+// drawLevel draws the stamps of the given level of detail. Until the stroke's
+// levels of detail have been built it draws its full resolution stamps.
+// Each segment is a vertex, drawn once per instance: instance i draws the i-th
+// stamp of every segment, and segments with fewer stamps are clipped away.
+// Copies of the stroke follow, with as many instances each.
+void Stroke::drawLevel(int level) {
+  if (this->segments.empty())
+    return;
+
+  this->upload();
+
+  // Active the shader program
+  this->shader.use();
+
+  size_t first = 0;
+  size_t count = this->segments.size();
+  if (level > 0 && this->lodsBuilt) {
+    level = std::min(level, STROKE_LOD_LEVELS);
+    first = this->segments.size() + this->lods.first[level - 1];
+    count = this->lods.count[level - 1];
+  }
+
+  if (count < 2)
+    return;
+
+  // Draw every stamp in the level. A segment's start is read from the segment
+  // before it, so the first segment of the level is only a start.
+  // The shader writes premultiplied coverage, blended over what's beneath
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  // Each copy of the stroke is a further range of instances, which the shader
+  // moves by the copy's transform
+  int numCopies = this->symmetry.numCopies();
+  this->shader.setInt("stampsPerCopy", this->maxSegmentStamps);
+  if (numCopies > 1) {
+    glm::mat4 transforms[SYMMETRY_MAX_COPIES - 1];
+    for (int copy = 1; copy < numCopies; copy++) {
+      transforms[copy - 1] = this->symmetry.transform(copy);
+    }
+    this->shader.setMat4Array("copyTransforms", transforms, numCopies - 1);
+  }
+
+  glBindVertexArray(this->VAO);
+  glDrawArraysInstanced(GL_POINTS, GLint(first), GLsizei(count - 1), this->maxSegmentStamps * numCopies);
+
+  glDisable(GL_BLEND);
+}
+
+// buildLods builds the simplified levels of detail of a stroke with the given
+// samples. It only reads its arguments, so it can run on a worker thread.
+// Each level simplifies the samples with Douglas–Peucker, then stamps the
+// simplified line with a spacing matching the tolerance, so both the shape and
+// the stamp density lose only detail which is smaller than a pixel when drawn.
+void Stroke::buildLods(const std::vector<glm::vec2> &samples, StrokeLods &lods) {
+  lods.segments.clear();
+
+  std::vector<glm::vec2> simplified;
+  for (int level = 1; level <= STROKE_LOD_LEVELS; level++) {
+    float tolerance = lodTolerance(level);
+    simplifyPolyline(samples, tolerance, simplified);
+
+    lods.first[level - 1] = lods.segments.size();
+    lods.numStamps[level - 1] = 0;
+
+    if (!simplified.empty()) {
+      lods.segments.push_back(StampSegment{simplified.front(), 0});
+      lods.segments.push_back(StampSegment{simplified.front(), 1});
+      lods.numStamps[level - 1] = 1;
+    }
+    for (size_t i = 1; i < simplified.size(); i++) {
+      lods.numStamps[level - 1] += appendStampSegments(simplified[i - 1], simplified[i], tolerance, lods.segments);
+    }
+
+    lods.count[level - 1] = lods.segments.size() - lods.first[level - 1];
+  }
+}
+
+// lodLevel returns the level of detail strokes are drawn with at the given zoom.
+// This is the coarsest level whose error stays within a pixel on screen.
+int Stroke::lodLevel(float zoom) {
+  float tolerance = LOD_PIXEL_TOLERANCE / zoom;
+
+  int level = 0;
+  while (level < STROKE_LOD_LEVELS && lodTolerance(level + 1) <= tolerance) {
+    level++;
+  }
+
+  return level;
+}
+
+// setLods sets the stroke's levels of detail, which are uploaded when next drawn
+void Stroke::setLods(StrokeLods lods) {
+  this->lods = std::move(lods);
+  for (const StampSegment &segment : this->lods.segments) {
+    this->maxSegmentStamps = std::max(this->maxSegmentStamps, int(segment.numStamps));
+  }
+  this->lodsBuilt = true;
+  this->lodsUploaded = false;
+}
+
+// hasLods indicates whether the stroke's levels of detail have been built
+bool Stroke::hasLods() const { return this->lodsBuilt; }
+
+// geometryBytes returns the number of bytes of segments the stroke draws from,
+// including its levels of detail
+size_t Stroke::geometryBytes() const {
+  return (this->segments.size() + this->lods.segments.size()) * sizeof(StampSegment);
+}
+
+// gpuBytes returns the number of bytes the stroke's vertex buffer occupies
+size_t Stroke::gpuBytes() const { return this->bufferCapacity * sizeof(StampSegment); }
+
+// cpuBytes returns the number of bytes the stroke occupies on the heap
+size_t Stroke::cpuBytes() const {
+  size_t numSegments = this->segments.capacity() + this->lods.segments.capacity();
+  return sizeof(Stroke) + (this->samples.capacity() * sizeof(glm::vec2)) + (numSegments * sizeof(StampSegment));
+}
+
+// segmentCount returns the number of segments between consecutive samples.
+// A stroke made of a single sample has a single degenerate segment.
+size_t Stroke::segmentCount() const {
+  if (this->samples.size() <= 1)
+    return this->samples.size();
+
+  return this->samples.size() - 1;
+}
+
+// segmentBounds returns the bounding box of a segment, including the
+// stroke radius
+Rect Stroke::segmentBounds(size_t segment) const {
+  Rect segmentBounds = Rect::empty();
+  segmentBounds.expand(this->samples[segment]);
+  segmentBounds.expand(this->samples[std::min(segment + 1, this->samples.size() - 1)]);
+
+  return segmentBounds.inflated(this->radius);
+}
+
+// distanceToSegment returns the distance from a point to a segment's
+// center line
+float Stroke::distanceToSegment(size_t segment, glm::vec2 point) const {
+  glm::vec2 a = this->samples[segment];
+  glm::vec2 b = this->samples[std::min(segment + 1, this->samples.size() - 1)];
+
+  glm::vec2 ab = b - a;
+  float lengthSquared = glm::dot(ab, ab);
+  if (lengthSquared <= 0) {
+    return glm::distance(point, a);
+  }
+
+  float t = glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f);
+
+  return glm::distance(point, a + (ab * t));
+}
+
+// erase cuts the parts of the stroke's center line which lie within a circle.
+// The pieces of the stroke which survive are written to runs. It returns
+// false and leaves runs untouched if the circle does not touch the stroke.
+bool Stroke::erase(glm::vec2 center, float radius, std::vector<std::vector<glm::vec2> > &runs) const {
+  if (this->samples.empty())
+    return false;
+
+  float radiusSquared = radius * radius;
+
+  if (this->samples.size() == 1) {
+    glm::vec2 offset = this->samples[0] - center;
+    if (glm::dot(offset, offset) >= radiusSquared)
+      return false;
+
+    runs.clear();
+    return true;
+  }
+
+  bool changed = false;
+  std::vector<glm::vec2> run;
+  std::vector<std::vector<glm::vec2> > pieces;
+
+  // Closes the current run, dropping runs too short to form a line
+  auto closeRun = [&run, &pieces]() {
+    if (run.size() >= 2) {
+      pieces.push_back(run);
+    }
+    run.clear();
+  };
+
+  {
+    glm::vec2 offset = this->samples[0] - center;
+    if (glm::dot(offset, offset) >= radiusSquared) {
+      run.push_back(this->samples[0]);
+    }
+  }
+
+  for (size_t i = 0; i + 1 < this->samples.size(); i++) {
+    glm::vec2 a = this->samples[i];
+    glm::vec2 b = this->samples[i + 1];
+
+    // Solve |a + t(b - a) - center|^2 = radius^2 for the interval of the
+    // segment which lies within the circle
+    glm::vec2 d = b - a;
+    glm::vec2 f = a - center;
+
+    float qa = glm::dot(d, d);
+    float qb = 2.0f * glm::dot(f, d);
+    float qc = glm::dot(f, f) - radiusSquared;
+
+    float enter = 1.0f, exit = 0.0f;
+    if (qa <= 0) {
+      if (qc < 0) {
+        enter = 0.0f;
+        exit = 1.0f;
+      }
+    } else {
+      float discriminant = (qb * qb) - (4.0f * qa * qc);
+      if (discriminant > 0) {
+        float root = std::sqrt(discriminant);
+        enter = std::max((-qb - root) / (2.0f * qa), 0.0f);
+        exit = std::min((-qb + root) / (2.0f * qa), 1.0f);
+      }
+    }
+
+    if (enter >= exit) {
+      // The segment does not cross the circle
+      run.push_back(b);
+      continue;
+    }
+
+    changed = true;
+
+    if (enter > 0.0f) {
+      run.push_back(a + (d * enter));
+    }
+    closeRun();
+
+    if (exit < 1.0f) {
+      run.push_back(a + (d * exit));
+      run.push_back(b);
+    }
+  }
+  closeRun();
+
+  if (!changed)
+    return false;
+
+  runs = std::move(pieces);
+  return true;
+}
@@ -0,0 +1,155 @@
+#ifndef STROKE_H
+#define STROKE_H
+#include "drawable.h"
+#include "rect.h"
+#include "shader.h"
+#include "stamp_segments.h"
+#include "symmetry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The number of simplified levels of detail built for a stroke, in addition to
+// its full resolution stamps at level 0
+const int STROKE_LOD_LEVELS = 3;
+
+// StrokeLods holds the stamp segments of a stroke's simplified levels of detail.
+// Each level halves the detail of the one before it: its samples are
+// simplified with twice the tolerance and its stamps are twice as far apart.
+struct StrokeLods {
+  // The segments of every level, one after the other
+  std::vector<StampSegment> segments;
+
+  // The range of segments making up each level, from level 1, and the number
+  // of stamps they hold
+  size_t first[STROKE_LOD_LEVELS];
+  size_t count[STROKE_LOD_LEVELS];
+  size_t numStamps[STROKE_LOD_LEVELS];
+};
+
+// Stroke is a continuous line drawn in a single draw session (i.e from a mouse
+// press until its release). It keeps the raw cursor samples that make up the
+// line and renders every stamp between them with a single draw call.
+// Only the ends of the segments between samples and their stamp counts are
+// uploaded; the stroke shader draws each segment with one instance per stamp
+// and interpolates the stamp positions itself.
+// Strokes drawn with a symmetry draw every copy in the same draw call, as
+// further ranges of instances, so only the stroke itself is stored.
+// Positions are stored in canvas space.
+class Stroke : public Drawable {
+public:
+  // Stroke creates an empty stroke which is rendered with the given shader
+  Stroke(uint32_t id, Shader &shader, float radius);
+  ~Stroke();
+
+  // addSample appends a cursor sample to the stroke and interpolates stamps
+  // between it and the previous sample. It returns the number of stamps added.
+  int addSample(glm::vec2 position);
+
+  // rebuild recomputes the stroke's stamps and bounds from its samples, e.g
+  // after the samples have been loaded from a document
+  void rebuild();
+
+  // seal marks the stroke as finished. Sealed strokes receive no more samples.
+  void seal();
+
+  // isSealed indicates whether the stroke has been finished
+  bool isSealed() const;
+
+  // draws the stroke's stamps to the screen
+  virtual void draw();
+
+  // drawLevel draws the stamps of the given level of detail. Until the stroke's
+  // levels of detail have been built it draws its full resolution stamps.
+  void drawLevel(int level);
+
+  // buildLods builds the simplified levels of detail of a stroke with the given
+  // samples. It only reads its arguments, so it can run on a worker thread.
+  static void buildLods(const std::vector<glm::vec2> &samples, StrokeLods &lods);
+
+  // lodLevel returns the level of detail strokes are drawn with at the given zoom
+  static int lodLevel(float zoom);
+
+  // setLods sets the stroke's levels of detail, which are uploaded when next drawn
+  void setLods(StrokeLods lods);
+
+  // hasLods indicates whether the stroke's levels of detail have been built
+  bool hasLods() const;
+
+  // geometryBytes returns the number of bytes of segments the stroke draws from,
+  // including its levels of detail
+  size_t geometryBytes() const;
+
+  // gpuBytes returns the number of bytes the stroke's vertex buffer occupies
+  size_t gpuBytes() const;
+
+  // cpuBytes returns the number of bytes the stroke occupies on the heap
+  size_t cpuBytes() const;
+
+  // segmentCount returns the number of segments between consecutive samples.
+  // A stroke made of a single sample has a single degenerate segment.
+  size_t segmentCount() const;
+
+  // segmentBounds returns the bounding box of a segment, including the
+  // stroke radius
+  Rect segmentBounds(size_t segment) const;
+
+  // distanceToSegment returns the distance from a point to a segment's
+  // center line
+  float distanceToSegment(size_t segment, glm::vec2 point) const;
+
+  // erase cuts the parts of the stroke's center line which lie within a circle.
+  // The pieces of the stroke which survive are written to runs. It returns
+  // false and leaves runs untouched if the circle does not touch the stroke.
+  bool erase(glm::vec2 center, float radius, std::vector<std::vector<glm::vec2> > &runs) const;
+
+  // The identifier of the stroke within the engine
+  uint32_t id;
+
+  // The radius of the stamps in pixels
+  float radius;
+
+  // The ID of the layer the stroke is drawn on
+  uint32_t layer;
+
+  // The copies the stroke is drawn with. It's set before samples are added,
+  // as the stroke's bounds include its copies.
+  Symmetry symmetry;
+
+  // The raw cursor samples which make up the stroke
+  std::vector<glm::vec2> samples;
+
+  // The stamp segments between the samples. The first segment marks the start
+  // of the stroke and holds no stamps, and the second holds the first sample.
+  std::vector<StampSegment> segments;
+
+  // The number of stamps held by the segments
+  size_t numStamps;
+
+  // The bounding box of all the stroke's stamps, including those of its copies
+  Rect bounds;
+
+private:
+  // Shader internals
+  Shader &shader;
+  unsigned int VBO, VAO;
+
+  // The number of segments uploaded to the VBO and the VBO's capacity in segments
+  size_t numUploadedSegments;
+  size_t bufferCapacity;
+
+  // The most stamps held by any uploaded segment, i.e the instances drawn
+  int maxSegmentStamps;
+
+  bool sealed;
+
+  // The stroke's levels of detail, and whether they have been built and uploaded
+  StrokeLods lods;
+  bool lodsBuilt;
+  bool lodsUploaded;
+
+  // upload copies segments which have not been uploaded yet into the VBO
+  void upload();
+};
+
+#endif // STROKE_H
@@ -0,0 +1,101 @@
+#include "symmetry.h"
+#include <algorithm>
+#include <cmath>
+
+// A full turn in radians, which radial copies divide evenly
+const float FULL_TURN = 6.28318530717958647692f;
+
+// rotate rotates a position about a center by an angle in radians
+static glm::vec2 rotate(glm::vec2 position, glm::vec2 center, float angle) {
+  glm::vec2 offset = position - center;
+  float c = std::cos(angle);
+  float s = std::sin(angle);
+
+  return center + glm::vec2{(offset.x * c) - (offset.y * s), (offset.x * s) + (offset.y * c)};
+}
+
+// numCopies returns the number of copies drawn, including the stroke itself
+int Symmetry::numCopies() const {
+  switch (this->mode) {
+  case SymmetryMode::Horizontal:
+  case SymmetryMode::Vertical:
+    return 2;
+  case SymmetryMode::Radial:
+    return std::clamp(this->ways, 1, SYMMETRY_MAX_COPIES);
+  default:
+    return 1;
+  }
+}
+
+// apply maps a position on the stroke to where the given copy draws it
+glm::vec2 Symmetry::apply(int copy, glm::vec2 position) const {
+  if (copy == 0)
+    return position;
+
+  switch (this->mode) {
+  case SymmetryMode::Horizontal:
+    return glm::vec2{(2 * this->center.x) - position.x, position.y};
+  case SymmetryMode::Vertical:
+    return glm::vec2{position.x, (2 * this->center.y) - position.y};
+  case SymmetryMode::Radial:
+    return rotate(position, this->center, FULL_TURN * float(copy) / float(this->numCopies()));
+  default:
+    return position;
+  }
+}
+
+// unapply maps a position on the given copy back onto the stroke. Mirrors are
+// their own inverse, and rotations are undone by rotating back.
+glm::vec2 Symmetry::unapply(int copy, glm::vec2 position) const {
+  if (this->mode == SymmetryMode::Radial && copy != 0)
+    return rotate(position, this->center, -FULL_TURN * float(copy) / float(this->numCopies()));
+
+  return this->apply(copy, position);
+}
+
+// transform returns the canvas space transform of the given copy. Each copy
+// is affine, so its transform is found from where it maps the origin and axes.
+glm::mat4 Symmetry::transform(int copy) const {
+  glm::vec2 origin = this->apply(copy, glm::vec2{0.0f, 0.0f});
+  glm::vec2 axisX = this->apply(copy, glm::vec2{1.0f, 0.0f}) - origin;
+  glm::vec2 axisY = this->apply(copy, glm::vec2{0.0f, 1.0f}) - origin;
+
+  glm::mat4 transform(1.0f);
+  transform[0][0] = axisX.x;
+  transform[0][1] = axisX.y;
+  transform[1][0] = axisY.x;
+  transform[1][1] = axisY.y;
+  transform[3][0] = origin.x;
+  transform[3][1] = origin.y;
+
+  return transform;
+}
+
+// bounds returns the bounding box of every copy of a region, from the copies
+// of its corners
+Rect Symmetry::bounds(const Rect &region) const {
+  if (region.isEmpty())
+    return region;
+
+  glm::vec2 corners[4] = {region.min, glm::vec2{region.max.x, region.min.y}, glm::vec2{region.min.x, region.max.y},
+                          region.max};
+
+  Rect bounds = region;
+  for (int copy = 1; copy < this->numCopies(); copy++) {
+    for (const glm::vec2 &corner : corners) {
+      bounds.expand(this->apply(copy, corner));
+    }
+  }
+
+  return bounds;
+}
+
+// Symmetries are equal if they draw the same copies
+bool Symmetry::operator==(const Symmetry &other) const {
+  if (this->numCopies() == 1 && other.numCopies() == 1)
+    return true;
+
+  return this->mode == other.mode && this->numCopies() == other.numCopies() && this->center == other.center;
+}
+
+bool Symmetry::operator!=(const Symmetry &other) const { return !(*this == other); }
@@ -0,0 +1,56 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+#include "rect.h"
+#include "../vendor/glm/glm/glm.hpp"
+
+// The most copies a symmetry draws of a stroke, including the stroke itself.
+// It matches SYMMETRY_MAX_COPIES in the stroke shader.
+const int SYMMETRY_MAX_COPIES = 16;
+
+// SymmetryMode is how the strokes drawn with a symmetry are copied
+enum class SymmetryMode {
+  // None draws strokes once
+  None,
+  // Horizontal mirrors strokes left to right across the vertical axis through the center
+  Horizontal,
+  // Vertical mirrors strokes top to bottom across the horizontal axis through the center
+  Vertical,
+  // Radial rotates copies of strokes evenly about the center
+  Radial,
+};
+
+const int SYMMETRY_MODE_COUNT = 4;
+
+// Symmetry describes the copies a stroke is drawn with. Only the stroke itself
+// is stored: its copies are drawn by the stroke shader, which transforms each
+// range of instances by a copy's transform, and tools find them by mapping
+// positions on a copy back onto the stroke. Copy 0 is the stroke itself.
+struct Symmetry {
+  SymmetryMode mode;
+
+  // The number of copies a radial symmetry draws, including the stroke itself
+  int ways;
+
+  // The point in canvas space the axes pass through, or the copies are rotated about
+  glm::vec2 center;
+
+  // numCopies returns the number of copies drawn, including the stroke itself
+  int numCopies() const;
+
+  // apply maps a position on the stroke to where the given copy draws it
+  glm::vec2 apply(int copy, glm::vec2 position) const;
+
+  // unapply maps a position on the given copy back onto the stroke
+  glm::vec2 unapply(int copy, glm::vec2 position) const;
+
+  // transform returns the canvas space transform of the given copy
+  glm::mat4 transform(int copy) const;
+
+  // bounds returns the bounding box of every copy of a region
+  Rect bounds(const Rect &region) const;
+
+  bool operator==(const Symmetry &other) const;
+  bool operator!=(const Symmetry &other) const;
+};
+
+#endif // SYMMETRY_H
@@ -0,0 +1,283 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <utility>
+
+// TaskNode is a task submitted to a ThreadPool
+struct TaskNode {
+  std::function<void()> run;
+  std::function<void()> onComplete;
+
+  // The number of unfinished dependencies, plus one while the task is being submitted
+  std::atomic<size_t> numBlockers{1};
+
+  // The tasks waiting on this one, and whether it has finished
+  std::mutex mutex;
+  std::vector<Task> dependents;
+  bool finished = false;
+};
+
+// The pool and index of the worker running on this thread, if any
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+// ThreadPool starts the given number of workers. A count of 0 uses one
+// worker per hardware thread.
+ThreadPool::ThreadPool(size_t numWorkers) : numQueued(0), numUnfinished(0), nextWorker(0), stopping(false) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  // Threads are unavailable, so every task runs inline on the caller
+  numWorkers = 0;
+#else
+  if (numWorkers == 0) {
+    numWorkers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Every deque exists before any worker starts stealing from them
+  for (size_t i = 0; i < numWorkers; i++) {
+    this->workers.emplace_back(new Worker());
+  }
+
+  for (size_t i = 0; i < numWorkers; i++) {
+    this->workers[i]->thread = std::thread(&ThreadPool::runWorker, this, i);
+  }
+#endif
+}
+
+// Stops the workers once their queued work has finished
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->sleepMutex);
+    this->stopping = true;
+  }
+  this->wakeup.notify_all();
+
+  for (std::unique_ptr<Worker> &worker : this->workers) {
+    worker->thread.join();
+  }
+}
+
+// submit queues a task to run on a worker once every one of its dependencies
+// has finished. If onComplete is given, it is queued to run on the main
+// thread after the task has finished.
+Task ThreadPool::submit(std::function<void()> task, const std::vector<Task> &dependencies,
+                        std::function<void()> onComplete) {
+  Task node = std::make_shared<TaskNode>();
+  node->run = std::move(task);
+  node->onComplete = std::move(onComplete);
+  this->numUnfinished.fetch_add(1);
+
+  // Without workers, dependencies have always run already
+  if (this->workers.empty()) {
+    this->execute(node);
+    return node;
+  }
+
+  for (const Task &dependency : dependencies) {
+    if (!dependency)
+      continue;
+
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->finished) {
+      node->numBlockers.fetch_add(1);
+      dependency->dependents.push_back(node);
+    }
+  }
+
+  // Release the submission's own blocker. The task runs now unless a
+  // dependency is still unfinished, in which case the last to finish schedules it.
+  if (node->numBlockers.fetch_sub(1) == 1) {
+    this->schedule(node);
+  }
+
+  return node;
+}
+
+// schedule queues a task whose dependencies have finished. Workers push onto
+// their own deque, keeping nested work local, while other threads spread
+// tasks across the workers.
+void ThreadPool::schedule(Task task) {
+  size_t worker = currentPool == this ? currentWorker : this->nextWorker.fetch_add(1) % this->workers.size();
+
+  // Count the task first, so numQueued never drops below the tasks in the deques
+  this->numQueued.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(this->workers[worker]->mutex);
+    this->workers[worker]->tasks.push_back(std::move(task));
+  }
+
+  // Take the sleep lock so a worker about to sleep can't miss the task
+  { std::lock_guard<std::mutex> lock(this->sleepMutex); }
+  this->wakeup.notify_one();
+}
+
+// execute runs a task, then schedules the tasks which were waiting on it
+void ThreadPool::execute(const Task &task) {
+  task->run();
+  task->run = nullptr;
+
+  if (task->onComplete) {
+    this->complete(std::move(task->onComplete));
+  }
+
+  std::vector<Task> dependents;
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->finished = true;
+    dependents.swap(task->dependents);
+  }
+
+  for (Task &dependent : dependents) {
+    if (dependent->numBlockers.fetch_sub(1) == 1) {
+      this->schedule(std::move(dependent));
+    }
+  }
+
+  // Wake the workers to exit once the last task of a stopping pool finishes
+  if (this->numUnfinished.fetch_sub(1) == 1) {
+    std::lock_guard<std::mutex> lock(this->sleepMutex);
+    if (this->stopping) {
+      this->wakeup.notify_all();
+    }
+  }
+}
+
+// findTask takes the newest task from a worker's own deque, or else steals
+// the oldest task from another worker's
+Task ThreadPool::findTask(size_t worker) {
+  {
+    Worker &own = *this->workers[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      Task task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return task;
+    }
+  }
+
+  for (size_t i = 1; i < this->workers.size(); i++) {
+    Worker &victim = *this->workers[(worker + i) % this->workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      Task task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return task;
+    }
+  }
+
+  return nullptr;
+}
+
+// runWorker runs tasks until the pool is stopped and every task has finished
+void ThreadPool::runWorker(size_t worker) {
+  currentPool = this;
+  currentWorker = worker;
+
+  while (true) {
+    Task task = this->findTask(worker);
+    if (task) {
+      this->numQueued.fetch_sub(1);
+      this->execute(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(this->sleepMutex);
+    this->wakeup.wait(lock, [this]() {
+      return this->numQueued.load() > 0 || (this->stopping && this->numUnfinished.load() == 0);
+    });
+
+    if (this->stopping && this->numQueued.load() == 0 && this->numUnfinished.load() == 0)
+      return;
+  }
+}
+
+// complete queues a callback to run on the main thread. It may be called
+// from any thread.
+void ThreadPool::complete(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(this->completionMutex);
+  this->completions.push_back(std::move(callback));
+}
+
+// drainCompletions runs the queued main thread callbacks and returns how many
+// ran. It must only be called from the main thread.
+size_t ThreadPool::drainCompletions() {
+  std::vector<std::function<void()> > callbacks;
+  {
+    std::lock_guard<std::mutex> lock(this->completionMutex);
+    callbacks.swap(this->completions);
+  }
+
+  // Callbacks may queue more callbacks, which run on the next drain
+  for (std::function<void()> &callback : callbacks) {
+    callback();
+  }
+
+  return callbacks.size();
+}
+
+// parallelFor splits the range [0, count) into chunks of at least grainSize
+// and runs them across the workers, blocking until every chunk is done.
+// The calling thread works on chunks too, so parallelFor may be called from
+// within a task running on the pool.
+void ThreadPool::parallelFor(size_t count, size_t grainSize,
+                             const std::function<void(size_t begin, size_t end)> &body) {
+  if (count == 0)
+    return;
+
+  grainSize = std::max<size_t>(grainSize, 1);
+  size_t numChunks = std::min((count + grainSize - 1) / grainSize, (this->workers.size() + 1) * 4);
+
+  if (numChunks <= 1 || this->workers.empty()) {
+    body(0, count);
+    return;
+  }
+
+  // The chunk counters are shared with helpers which may only get to run
+  // after parallelFor has returned
+  struct State {
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<size_t> doneChunks{0};
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+  auto state = std::make_shared<State>();
+
+  size_t chunkSize = (count + numChunks - 1) / numChunks;
+
+  // runChunks claims chunks until none are left
+  auto runChunks = [state, numChunks, chunkSize, count, &body]() {
+    while (true) {
+      size_t chunk = state->nextChunk.fetch_add(1);
+      if (chunk >= numChunks)
+        return;
+
+      size_t begin = chunk * chunkSize;
+      size_t end = std::min(begin + chunkSize, count);
+      if (begin < end) {
+        body(begin, end);
+      }
+
+      if (state->doneChunks.fetch_add(1) + 1 == numChunks) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done.notify_all();
+      }
+    }
+  };
+
+  size_t numHelpers = std::min(this->workers.size(), numChunks - 1);
+  for (size_t i = 0; i < numHelpers; i++) {
+    // Helpers only touch body while unclaimed chunks remain, and every chunk
+    // has completed before parallelFor returns
+    this->submit([state, numChunks, runChunks]() {
+      if (state->nextChunk.load() >= numChunks)
+        return;
+      runChunks();
+    });
+  }
+
+  runChunks();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state, numChunks]() { return state->doneChunks.load() == numChunks; });
+}
+
+// size returns the number of worker threads
+size_t ThreadPool::size() const { return this->workers.size(); }
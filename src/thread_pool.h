@@ -0,0 +1,104 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// TaskNode is a task submitted to a ThreadPool
+struct TaskNode;
+
+// Task is a handle to a submitted task, which later tasks can depend on
+using Task = std::shared_ptr<TaskNode>;
+
+// ThreadPool runs CPU-side engine work on a fixed set of worker threads so it
+// doesn't block the render loop.
+//
+// Each worker has its own deque of tasks. Workers push the tasks they submit,
+// such as the chunks of a parallelFor, onto their own deque and run them
+// newest first, while idle workers steal the oldest tasks from the others.
+// Tasks may depend on other tasks, and may pass results back to the main
+// thread through a completion queue which the render loop drains each frame.
+// On web builds without pthreads the pool has no workers and runs work inline.
+class ThreadPool {
+public:
+  // ThreadPool starts the given number of workers. A count of 0 uses one
+  // worker per hardware thread.
+  explicit ThreadPool(size_t numWorkers = 0);
+
+  // Stops the workers once their queued work has finished
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // submit queues a task to run on a worker once every one of its dependencies
+  // has finished. If onComplete is given, it is queued to run on the main
+  // thread after the task has finished.
+  Task submit(std::function<void()> task, const std::vector<Task> &dependencies = {},
+              std::function<void()> onComplete = nullptr);
+
+  // complete queues a callback to run on the main thread. It may be called
+  // from any thread.
+  void complete(std::function<void()> callback);
+
+  // drainCompletions runs the queued main thread callbacks and returns how many
+  // ran. It must only be called from the main thread.
+  size_t drainCompletions();
+
+  // parallelFor splits the range [0, count) into chunks of at least grainSize
+  // and runs them across the workers, blocking until every chunk is done.
+  // The calling thread works on chunks too, so parallelFor may be called from
+  // within a task running on the pool.
+  void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)> &body);
+
+  // size returns the number of worker threads
+  size_t size() const;
+
+private:
+  // Worker is a worker thread and its deque of ready tasks
+  struct Worker {
+    std::thread thread;
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker> > workers;
+
+  // The number of tasks in the workers' deques, and of submitted tasks which
+  // haven't finished, including those waiting on dependencies
+  std::atomic<size_t> numQueued;
+  std::atomic<size_t> numUnfinished;
+
+  // The worker tasks submitted from outside the pool are spread to next
+  std::atomic<size_t> nextWorker;
+
+  // Idle workers sleep until tasks are queued
+  std::mutex sleepMutex;
+  std::condition_variable wakeup;
+  bool stopping;
+
+  // The callbacks waiting to run on the main thread
+  std::mutex completionMutex;
+  std::vector<std::function<void()> > completions;
+
+  // schedule queues a task whose dependencies have finished
+  void schedule(Task task);
+
+  // execute runs a task, then schedules the tasks which were waiting on it
+  void execute(const Task &task);
+
+  // findTask takes the newest task from a worker's own deque, or else steals
+  // the oldest task from another worker's
+  Task findTask(size_t worker);
+
+  // runWorker runs tasks until the pool is stopped and every task has finished
+  void runWorker(size_t worker);
+};
+
+#endif // THREAD_POOL_H